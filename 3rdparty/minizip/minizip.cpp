@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 
 #if Q_BYTE_ORDER == Q_BIG_ENDIAN
 #  error "The read() optimizations in unzip.c are incompatible with big endian machines"
@@ -47,11 +49,86 @@
 #endif
 // ^^^ copied from minizip's miniunz.c
 
+#include <QtEndian>
+
 #include "utility/exception.h"
 #include "utility/stopwatch.h"
 #include "minizip.h"
 
 
+// The TOC of a ZIP file is kept in a flat, position independent binary layout, so that it can
+// be written to a cache file as-is and later memory-mapped back in without any parsing:
+//
+//   TocHeader | tag (padded) | quint32 buckets[bucketCount] (padded) | TocEntry[entryCount] | names
+//
+// The buckets are an open addressing hash table (linear probing) of 1-based entry indexes.
+// All file names are stored lower-cased and are hashed with a stable FNV-1a, because qHash()
+// is seeded per process.
+
+struct MiniZip::TocHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 tagSize;
+    quint32 entryCount;
+    quint32 bucketCount;
+    quint32 storedCount;
+    quint32 reserved;
+    qint64 zipFileSize;
+    qint64 zipFileModified;
+    quint64 bucketsOffset;
+    quint64 entriesOffset;
+    quint64 namesOffset;
+    quint64 totalSize;
+};
+
+struct MiniZip::TocEntry
+{
+    quint64 hash;
+    quint64 posInZipDirectory;
+    quint64 numOfFile;
+    quint64 localHeaderOffset;
+    quint64 compressedSize;
+    quint32 compressionMethod;
+    quint32 flag;
+    quint32 nameOffset;
+    quint32 nameSize;
+};
+
+static constexpr char tocMagic[8] = { 'B', 'S', 'Z', 'I', 'P', 'T', 'O', 'C' };
+static constexpr quint32 tocVersion = 1;
+
+static quint64 tocHash(QByteArrayView name)
+{
+    quint64 h = 14695981039346656037ULL;
+    for (char c : name) {
+        h ^= quint8(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static QByteArray normalizedName(QByteArrayView name)
+{
+    // LDraw file names are plain ASCII: avoid the round-trip through QString for those
+    for (char c : name) {
+        if (quint8(c) >= 0x80)
+            return QString::fromUtf8(name).toLower().toUtf8();
+    }
+    QByteArray lower(name.data(), name.size());
+    for (char &c : lower) {
+        if ((c >= 'A') && (c <= 'Z'))
+            c = char(c + ('a' - 'A'));
+    }
+    return lower;
+}
+
+static quint64 tocAlign(quint64 offset)
+{
+    return (offset + 7) & ~quint64(7);
+}
+
+
 MiniZip::MiniZip(const QString &zipFilename)
     : m_zipFileName(zipFilename)
 { }
@@ -61,12 +138,13 @@ MiniZip::~MiniZip()
     close();
 }
 
-bool MiniZip::open()
+bool MiniZip::open(const QString &tocCacheFileName, const QByteArray &tocCacheTag)
 {
-    return openInternal(true);
+    return openInternal(true, tocCacheFileName, tocCacheTag);
 }
 
-bool MiniZip::openInternal(bool parseTOC)
+bool MiniZip::openInternal(bool parseTOC, const QString &tocCacheFileName,
+                           const QByteArray &tocCacheTag)
 {
     if (m_zip)
         return false;
@@ -118,40 +196,232 @@ bool MiniZip::openInternal(bool parseTOC)
         return false;
 
     if (parseTOC) {
-        stopwatch sw("Reading ZIP directory");
-        do {
-            unz64_file_pos fpos;
-            if (unzGetFilePos64(m_zip, &fpos) != UNZ_OK)
-                break;
+        QFileInfo fi(m_zipFileName);
+        m_zipFileSize = fi.size();
+        m_zipFileModified = fi.lastModified().toMSecsSinceEpoch();
+
+        if (tocCacheFileName.isEmpty() || !loadTOC(tocCacheFileName, tocCacheTag)) {
+            m_tocData = buildTOC(tocCacheTag);
+            m_toc = reinterpret_cast<const uchar *>(m_tocData.constData());
+
+            if (!tocCacheFileName.isEmpty()) {
+                QSaveFile f(tocCacheFileName);
+                if (f.open(QIODevice::WriteOnly)) {
+                    f.write(m_tocData);
+                    f.commit();
+                }
+            }
+        }
 
-            // extension for BrickStore for fast content scanning (50% faster)
-            char *filename;
-            int filenameSize;
-            if (unz__GetCurrentFilename(m_zip, &filename, &filenameSize) != UNZ_OK)
-                break;
-            auto buffer = QString::fromUtf8(QByteArray(filename, filenameSize)).toLower().toUtf8();
+        if (reinterpret_cast<const TocHeader *>(m_toc)->storedCount) {
+            m_zipFile = std::make_unique<QFile>(m_zipFileName);
+            if (m_zipFile->open(QIODevice::ReadOnly))
+                m_zipData = m_zipFile->map(0, m_zipFileSize);
+            if (!m_zipData)
+                m_zipFile.reset();
+        }
+    }
+
+    return true;
+}
+
+bool MiniZip::loadTOC(const QString &tocCacheFileName, const QByteArray &tocCacheTag)
+{
+    auto f = std::make_unique<QFile>(tocCacheFileName);
+    if (!f->open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = f->size();
+    if (size < qint64(sizeof(TocHeader)))
+        return false;
+    const uchar *data = f->map(0, size);
+    if (!data)
+        return false;
 
-            // this is slow, because unzGetCurrentFileInfo64() re-parses the file header
-            // which was already done in GoTo{First|Next}File()
-            //                QByteArray buffer;
-            //                buffer.resize(1024);
-            //                unz_file_info64 fileInfo;
-            //                if (unzGetCurrentFileInfo64(zip, &fileInfo, buffer.data(), buffer.size(), nullptr, 0, nullptr, 0) != UNZ_OK)
-            //                    break;
+    const auto *header = reinterpret_cast<const TocHeader *>(data);
+
+    if ((memcmp(header->magic, tocMagic, sizeof(tocMagic)) != 0)
+            || (header->version != tocVersion)
+            || (header->totalSize != quint64(size))
+            || (header->zipFileSize != m_zipFileSize)
+            || (header->zipFileModified != m_zipFileModified)
+            || (header->bucketsOffset != tocAlign(sizeof(TocHeader) + header->tagSize))
+            || (header->entriesOffset != tocAlign(header->bucketsOffset + header->bucketCount * sizeof(quint32)))
+            || (header->namesOffset != header->entriesOffset + header->entryCount * sizeof(TocEntry))
+            || (header->namesOffset > header->totalSize)
+            || (header->bucketCount <= header->entryCount)
+            || (header->bucketCount & (header->bucketCount - 1))
+            || (QByteArrayView(data + sizeof(TocHeader), header->tagSize) != tocCacheTag)) {
+        return false;
+    }
 
-            //                buffer.truncate(fileInfo.size_filename);
-            //                buffer.squeeze();
+    // a truncated or corrupt cache must not lead to out-of-bounds reads later on: every bucket
+    // has to reference a valid entry (leaving at least one bucket empty, so that the linear
+    // probing terminates) and every entry has to reference a valid name
+    const auto *buckets = reinterpret_cast<const quint32 *>(data + header->bucketsOffset);
+    const auto *entries = reinterpret_cast<const TocEntry *>(data + header->entriesOffset);
+    const quint64 namesSize = header->totalSize - header->namesOffset;
+    quint32 usedBuckets = 0;
+
+    for (quint32 b = 0; b < header->bucketCount; ++b) {
+        if (buckets[b] > header->entryCount)
+            return false;
+        if (buckets[b])
+            ++usedBuckets;
+    }
+    if (usedBuckets >= header->bucketCount)
+        return false;
 
-            m_contents.insert(buffer, qMakePair(fpos.pos_in_zip_directory, fpos.num_of_file));
-        } while (unzGoToNextFile(m_zip) == UNZ_OK);
+    for (quint32 i = 0; i < header->entryCount; ++i) {
+        const auto &e = entries[i];
+        if (((quint64(e.nameOffset) + e.nameSize) > namesSize)
+                || (e.localHeaderOffset > quint64(m_zipFileSize))
+                || (e.compressedSize > quint64(m_zipFileSize))) {
+            return false;
+        }
     }
 
+    m_tocFile = std::move(f);
+    m_toc = data;
     return true;
 }
 
+QByteArray MiniZip::buildTOC(const QByteArray &tocCacheTag)
+{
+    stopwatch sw("Reading ZIP directory");
+
+    QVector<TocEntry> entries;
+    QByteArray names;
+    quint32 storedCount = 0;
+
+    do {
+        unz64_file_pos fpos;
+        if (unzGetFilePos64(m_zip, &fpos) != UNZ_OK)
+            break;
+
+        // extension for BrickStore for fast content scanning (50% faster)
+        char *filename;
+        int filenameSize;
+        if (unz__GetCurrentFilename(m_zip, &filename, &filenameSize) != UNZ_OK)
+            break;
+        const QByteArray name = normalizedName(QByteArrayView(filename, filenameSize));
+
+        // another extension: unzGetCurrentFileInfo64() would re-parse the file header, which
+        // was already done in GoTo{First|Next}File()
+        ZPOS64_T localHeaderOffset, compressedSize;
+        uLong compressionMethod, flag;
+        if (unz__GetCurrentFileLocation(m_zip, &localHeaderOffset, &compressionMethod, &flag,
+                                        &compressedSize) != UNZ_OK) {
+            break;
+        }
+        if ((compressionMethod == 0) && !(flag & 1))
+            ++storedCount;
+
+        entries.append({ tocHash(name), fpos.pos_in_zip_directory, fpos.num_of_file,
+                         localHeaderOffset, compressedSize, quint32(compressionMethod),
+                         quint32(flag), quint32(names.size()), quint32(name.size()) });
+        names.append(name);
+    } while (unzGoToNextFile(m_zip) == UNZ_OK);
+
+    quint32 bucketCount = 16;
+    while (bucketCount < (quint32(entries.size()) * 2))
+        bucketCount *= 2;
+
+    TocHeader header;
+    memcpy(header.magic, tocMagic, sizeof(tocMagic));
+    header.version = tocVersion;
+    header.tagSize = quint32(tocCacheTag.size());
+    header.entryCount = quint32(entries.size());
+    header.bucketCount = bucketCount;
+    header.storedCount = storedCount;
+    header.reserved = 0;
+    header.zipFileSize = m_zipFileSize;
+    header.zipFileModified = m_zipFileModified;
+    header.bucketsOffset = tocAlign(sizeof(TocHeader) + header.tagSize);
+    header.entriesOffset = tocAlign(header.bucketsOffset + bucketCount * sizeof(quint32));
+    header.namesOffset = header.entriesOffset + entries.size() * sizeof(TocEntry);
+    header.totalSize = header.namesOffset + quint64(names.size());
+
+    QByteArray toc(qsizetype(header.totalSize), '\0');
+    uchar *data = reinterpret_cast<uchar *>(toc.data());
+    memcpy(data, &header, sizeof(TocHeader));
+    memcpy(data + sizeof(TocHeader), tocCacheTag.constData(), size_t(tocCacheTag.size()));
+    memcpy(data + header.namesOffset, names.constData(), size_t(names.size()));
+
+    auto *buckets = reinterpret_cast<quint32 *>(data + header.bucketsOffset);
+    auto *tocEntries = reinterpret_cast<TocEntry *>(data + header.entriesOffset);
+    const quint32 mask = bucketCount - 1;
+
+    for (quint32 i = 0; i < quint32(entries.size()); ++i) {
+        const auto &e = entries.at(i);
+        tocEntries[i] = e;
+
+        for (quint32 b = quint32(e.hash) & mask; ; b = (b + 1) & mask) {
+            if (!buckets[b]) {
+                buckets[b] = i + 1;
+                break;
+            }
+            // duplicate names: the last one wins
+            const auto &other = entries.at(buckets[b] - 1);
+            if ((other.hash == e.hash)
+                    && (QByteArrayView(names.constData() + other.nameOffset, other.nameSize)
+                        == QByteArrayView(names.constData() + e.nameOffset, e.nameSize))) {
+                buckets[b] = i + 1;
+                break;
+            }
+        }
+    }
+    return toc;
+}
+
+const MiniZip::TocEntry *MiniZip::findEntry(const QByteArray &normalizedFileName) const
+{
+    if (!m_toc)
+        return nullptr;
+
+    const auto *header = reinterpret_cast<const TocHeader *>(m_toc);
+    const auto *buckets = reinterpret_cast<const quint32 *>(m_toc + header->bucketsOffset);
+    const auto *entries = reinterpret_cast<const TocEntry *>(m_toc + header->entriesOffset);
+    const auto *names = reinterpret_cast<const char *>(m_toc + header->namesOffset);
+    const quint64 hash = tocHash(normalizedFileName);
+    const quint32 mask = header->bucketCount - 1;
+
+    for (quint32 b = quint32(hash) & mask; buckets[b]; b = (b + 1) & mask) {
+        const quint32 index = buckets[b] - 1;
+        if (index >= header->entryCount)
+            break;
+        const auto *e = entries + index;
+        if ((e->hash == hash)
+                && (QByteArrayView(names + e->nameOffset, e->nameSize) == normalizedFileName)) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+QByteArray MiniZip::readStoredFile(const TocEntry *entry) const
+{
+    // local file header: 30 bytes, followed by the file name and the extra field
+    const quint64 headerOffset = entry->localHeaderOffset;
+    if ((headerOffset + 30) > quint64(m_zipFileSize))
+        return { };
+
+    const uchar *lfh = m_zipData + headerOffset;
+    if (qFromLittleEndian<quint32>(lfh) != 0x04034b50)
+        return { };
+
+    const quint64 dataOffset = headerOffset + 30 + qFromLittleEndian<quint16>(lfh + 26)
+            + qFromLittleEndian<quint16>(lfh + 28);
+    if ((dataOffset + entry->compressedSize) > quint64(m_zipFileSize))
+        return { };
+
+    return QByteArray(reinterpret_cast<const char *>(m_zipData + dataOffset),
+                      qsizetype(entry->compressedSize));
+}
+
 bool MiniZip::contains(const QString &fileName) const
 {
-    return m_contents.contains(fileName.toLower().toUtf8());
+    return findEntry(normalizedName(fileName.toUtf8()));
 }
 
 void MiniZip::close()
@@ -160,15 +430,26 @@ void MiniZip::close()
         unzClose(m_zip);
         m_zip = nullptr;
     }
-    m_contents.clear();
+    m_toc = nullptr;
+    m_tocData.clear();
+    m_tocFile.reset();
+    m_zipData = nullptr;
+    m_zipFile.reset();
 }
 
 QStringList MiniZip::fileList() const
 {
     QStringList l;
-    l.reserve(m_contents.size());
-    for (auto it = m_contents.keyBegin(); it != m_contents.keyEnd(); ++it)
-        l << QString::fromUtf8(*it);
+    if (!m_toc)
+        return l;
+
+    const auto *header = reinterpret_cast<const TocHeader *>(m_toc);
+    const auto *entries = reinterpret_cast<const TocEntry *>(m_toc + header->entriesOffset);
+    const auto *names = reinterpret_cast<const char *>(m_toc + header->namesOffset);
+
+    l.reserve(header->entryCount);
+    for (quint32 i = 0; i < header->entryCount; ++i)
+        l << QString::fromUtf8(names + entries[i].nameOffset, entries[i].nameSize);
     return l;
 }
 
@@ -178,12 +459,18 @@ QByteArray MiniZip::readFile(const QString &fileName)
     if (!m_zip)
         throw Exception(tr("ZIP file %1 has not been opened for reading")).arg(m_zipFileName);
 
-    QByteArray fn = fileName.toLower().toUtf8();
-    auto it = m_contents.constFind(fn);
-    if (it == m_contents.cend())
+    const auto *entry = findEntry(normalizedName(fileName.toUtf8()));
+    if (!entry)
         throw Exception(tr("Could not locate the file %1 within the ZIP file %2.")).arg(fileName).arg(m_zipFileName);
 
-    unz64_file_pos fpos { it.value().first, it.value().second };
+    if (m_zipData && (entry->compressionMethod == 0) && !(entry->flag & 1)) {
+        QByteArray data = readStoredFile(entry);
+        if (data.size() == qsizetype(entry->compressedSize))
+            return data;
+        // fall back to minizip on corrupt headers
+    }
+
+    unz64_file_pos fpos { entry->posInZipDirectory, entry->numOfFile };
     if (unzGoToFilePos64(m_zip, &fpos) != UNZ_OK)
         throw Exception(tr("Could not seek to the file %1 within the ZIP file %2.")).arg(fileName).arg(m_zipFileName);
 
@@ -208,39 +495,138 @@ QByteArray MiniZip::readFile(const QString &fileName)
     return data;
 }
 
+// A sequential, read-only device that decompresses (and decrypts) a single ZIP entry on the fly.
+// It owns its MiniZip instance, so the ZIP file stays open for as long as the device exists.
+
+class MiniZip::ReadDevice : public QIODevice
+{
+public:
+    ReadDevice(std::unique_ptr<MiniZip> zip, quint64 uncompressedSize)
+        : m_zip(std::move(zip))
+        , m_remaining(uncompressedSize)
+    { }
+
+    ~ReadDevice() override
+    {
+        close();
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return qint64(m_remaining) + QIODevice::bytesAvailable();
+    }
+
+    void close() override
+    {
+        if (isOpen()) {
+            if (!m_entryClosed)
+                unzCloseCurrentFile(m_zip->m_zip);
+            m_zip->close();
+        }
+        QIODevice::close();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        if (m_failed)
+            return -1;
+        if (!m_remaining)
+            return 0;
+
+        int bytesRead = unzReadCurrentFile(m_zip->m_zip, data, unsigned(qMin(maxSize, qint64(WRITEBUFFERSIZE * 128))));
+        if (bytesRead < 0)
+            return fail(MiniZip::tr("Could not read from the ZIP file %1."));
+        if (!bytesRead)
+            return fail(MiniZip::tr("The entry in the ZIP file %1 is truncated."));
+
+        m_remaining -= qMin(m_remaining, quint64(bytesRead));
+
+        // the CRC is only verified when closing the entry: do that as soon as all data has been
+        // read, so that a corrupt entry is reported as a read error instead of a short file
+        if (!m_remaining) {
+            m_entryClosed = true;
+            int err = unzCloseCurrentFile(m_zip->m_zip);
+            if (err == UNZ_CRCERROR)
+                return fail(MiniZip::tr("The entry in the ZIP file %1 failed the CRC check."));
+            else if (err != UNZ_OK)
+                return fail(MiniZip::tr("Could not read from the ZIP file %1."));
+        }
+        return bytesRead;
+    }
+
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    qint64 fail(const QString &error)
+    {
+        // bytesAvailable() stays non-zero, so atEnd() doesn't report a clean end of file
+        setErrorString(error.arg(m_zip->m_zipFileName));
+        m_failed = true;
+        m_remaining = qMax(m_remaining, quint64(1));
+        return -1;
+    }
+
+    std::unique_ptr<MiniZip> m_zip;
+    quint64 m_remaining;
+    bool m_entryClosed = false;
+    bool m_failed = false;
+};
+
+std::unique_ptr<QIODevice> MiniZip::openForReading(const QString &zipFileName,
+                                                   const char *extractFileName,
+                                                   const char *extractPassword)
+{
+    auto zip = std::make_unique<MiniZip>(zipFileName);
+
+    if (!zip->openInternal(false))
+        throw Exception(tr("Could not open the ZIP file %1").arg(zipFileName));
+
+    if (unzLocateFile(zip->m_zip, extractFileName, 2 /*case insensitive*/) != UNZ_OK) {
+        throw Exception(tr("Could not locate the file %1 within the ZIP file %2.")
+                        .arg(QLatin1String(extractFileName)).arg(zipFileName));
+    }
+
+    unz_file_info64 fileInfo;
+    if (unzGetCurrentFileInfo64(zip->m_zip, &fileInfo, nullptr, 0, nullptr, 0, nullptr, 0) != UNZ_OK) {
+        throw Exception(tr("Could not get info for the file %1 within the ZIP file %2.")
+                        .arg(QLatin1String(extractFileName)).arg(zipFileName));
+    }
+
+    if (unzOpenCurrentFilePassword(zip->m_zip, extractPassword) != UNZ_OK) {
+        throw Exception(tr("Could not decrypt the file %1 within the ZIP file %2.")
+                        .arg(QLatin1String(extractFileName)).arg(zipFileName));
+    }
+
+    auto device = std::make_unique<ReadDevice>(std::move(zip), fileInfo.uncompressed_size);
+    device->open(QIODevice::ReadOnly);
+    return device;
+}
+
 void MiniZip::unzip(const QString &zipFileName, QIODevice *destination,
                     const char *extractFileName, const char *extractPassword)
 {
-    QString errorMsg;
-    MiniZip zip(zipFileName);
-
-    if (zip.openInternal(false)) {
-        if (unzLocateFile(zip.m_zip, extractFileName, 2 /*case insensitive*/) == UNZ_OK) {
-            if (unzOpenCurrentFilePassword(zip.m_zip, extractPassword) == UNZ_OK) {
-                QByteArray block;
-                block.resize(1024*1024);
-                int bytesRead;
-                do {
-                    bytesRead = unzReadCurrentFile(zip.m_zip, block.data(), unsigned(block.size()));
-                    if (bytesRead > 0)
-                        destination->write(block.constData(), bytesRead);
-                } while (bytesRead > 0);
-                if (bytesRead < 0)
-                    errorMsg = tr("Could not read the file %1 within the ZIP file %2.")
-                            .arg(QLatin1String(extractFileName)).arg(zipFileName);
-                unzCloseCurrentFile(zip.m_zip);
-            } else {
-                errorMsg = tr("Could not decrypt the file %1 within the ZIP file %2.")
-                        .arg(QLatin1String(extractFileName)).arg(zipFileName);
-            }
-        } else {
-            errorMsg = tr("Could not locate the file %1 within the ZIP file %2.")
-                    .arg(QLatin1String(extractFileName)).arg(zipFileName);
-        }
-        zip.close();
-    } else {
-        errorMsg = tr("Could not open the ZIP file %1").arg(zipFileName);
+    auto source = openForReading(zipFileName, extractFileName, extractPassword);
+
+    QByteArray block;
+    block.resize(1024*1024);
+    qint64 bytesRead;
+    do {
+        bytesRead = source->read(block.data(), block.size());
+        if (bytesRead > 0)
+            destination->write(block.constData(), bytesRead);
+    } while (bytesRead > 0);
+
+    if (bytesRead < 0) {
+        throw Exception(tr("Could not read the file %1 within the ZIP file %2.")
+                        .arg(QLatin1String(extractFileName)).arg(zipFileName));
     }
-    if (!errorMsg.isEmpty())
-        throw Exception(errorMsg);
 }
@@ -3,10 +3,13 @@
 
 #pragma once
 
+#include <memory>
+
 #include <QCoreApplication>
 #include <QHash>
 
 QT_FORWARD_DECLARE_CLASS(QIODevice)
+QT_FORWARD_DECLARE_CLASS(QFile)
 
 
 class MiniZip
@@ -17,7 +20,7 @@ public:
     MiniZip(const QString &zipFileName);
     ~MiniZip();
 
-    bool open();
+    bool open(const QString &tocCacheFileName = { }, const QByteArray &tocCacheTag = { });
     void close();
     QStringList fileList() const;
     bool contains(const QString &fileName) const;
@@ -25,12 +28,34 @@ public:
 
     static void unzip(const QString &zipFileName, QIODevice *destination,
                       const char *extractFileName, const char *extractPassword = nullptr);
+    static std::unique_ptr<QIODevice> openForReading(const QString &zipFileName,
+                                                     const char *extractFileName,
+                                                     const char *extractPassword = nullptr);
 
 private:
-    bool openInternal(bool parseTOC);
+    class ReadDevice;
+    struct TocHeader;
+    struct TocEntry;
+
+    bool openInternal(bool parseTOC, const QString &tocCacheFileName = { },
+                      const QByteArray &tocCacheTag = { });
+    bool loadTOC(const QString &tocCacheFileName, const QByteArray &tocCacheTag);
+    QByteArray buildTOC(const QByteArray &tocCacheTag);
+    const TocEntry *findEntry(const QByteArray &normalizedFileName) const;
+    QByteArray readStoredFile(const TocEntry *entry) const;
 
     QString m_zipFileName;
-    QHash<QByteArray, QPair<quint64, quint64>> m_contents;
+    qint64 m_zipFileSize = 0;
+    qint64 m_zipFileModified = 0;
     void *m_zip = nullptr;
 
+    // the TOC is either freshly built in m_tocData or memory-mapped from a cache file
+    QByteArray m_tocData;
+    std::unique_ptr<QFile> m_tocFile;
+    const uchar *m_toc = nullptr;
+
+    // stored (uncompressed) files are read directly from a memory-mapped ZIP
+    std::unique_ptr<QFile> m_zipFile;
+    const uchar *m_zipData = nullptr;
+
 };
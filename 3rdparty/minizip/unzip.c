@@ -2079,3 +2079,19 @@ extern int ZEXPORT unz__GetCurrentFilename(unzFile file, char **filename, int *f
         return UNZ_INTERNALERROR;
     }
 }
+
+extern int ZEXPORT unz__GetCurrentFileLocation(unzFile file, ZPOS64_T *localHeaderOffset,
+                                               uLong *compressionMethod, uLong *flag,
+                                               ZPOS64_T *compressedSize)
+{
+    unz64_s *s = (unz64_s *) file;
+    if (s && s->current_file_ok && localHeaderOffset && compressionMethod && flag && compressedSize) {
+        *localHeaderOffset = s->cur_file_info_internal.offset_curfile + s->byte_before_the_zipfile;
+        *compressionMethod = s->cur_file_info.compression_method;
+        *flag = s->cur_file_info.flag;
+        *compressedSize = s->cur_file_info.compressed_size;
+        return UNZ_OK;
+    } else {
+        return UNZ_INTERNALERROR;
+    }
+}
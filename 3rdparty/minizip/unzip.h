@@ -431,6 +431,10 @@ extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
 // extension for BrickStore for fast content scanning
 extern int ZEXPORT unz__GetCurrentFilename(unzFile file, char **filename, int *filenameSize);
+// extension for BrickStore for direct access to stored files
+extern int ZEXPORT unz__GetCurrentFileLocation(unzFile file, ZPOS64_T *localHeaderOffset,
+                                               uLong *compressionMethod, uLong *flag,
+                                               ZPOS64_T *compressedSize);
 
 
 #ifdef __cplusplus
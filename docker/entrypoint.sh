@@ -17,19 +17,19 @@ stdbuf -oL -eL /usr/bin/brickstore "$@" 2>&1 \
   | tee >(gzip -c > $LOG_PATH/log-`date -Iseconds`.log.gz)
 
 echo
-echo "Compressing databases..."
+echo "Publishing databases..."
 
 for i in $(seq 4 20); do
   dbname=database-v$i
 
   rm -f "$DB_PATH/$dbname"
 
-  [ -e "$BRICKSTORE_CACHE_PATH/$dbname" ] || continue
+  # the backend writes the LZMA compressed (and SHA-512 prefixed) databases itself
+  [ -e "$BRICKSTORE_CACHE_PATH/$dbname.lzma" ] || continue
 
   echo -n "  > $dbname... "
 
-  sha512sum < "$BRICKSTORE_CACHE_PATH/$dbname" | xxd -r -p > "$DB_PATH/$dbname.lzma"
-  lzma_alone e "$BRICKSTORE_CACHE_PATH/$dbname" -so >>"$DB_PATH/$dbname.lzma" 2>/dev/null
+  mv "$BRICKSTORE_CACHE_PATH/$dbname.lzma" "$DB_PATH/$dbname.lzma"
 
   echo "done"
 done
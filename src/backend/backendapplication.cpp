@@ -2,14 +2,22 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cstdio>
+#include <algorithm>
 #include <QtCore/QStandardPaths>
+#include <QCoro/QCoroTask>
 #include "backendapplication.h"
 #include "bricklink/core.h"
 #include "utility/exception.h"
 #include "rebuilddatabase.h"
+#include "renderthumbnails.h"
 #include "version.h"
 
 
+static QCoro::Task<> exitWhenFinished(QCoro::Task<int> task)
+{
+    QCoreApplication::exit(co_await std::move(task));
+}
+
 BackendApplication::BackendApplication(int &argc, char **argv)
 {
     QCoreApplication::setApplicationName(QLatin1String(BRICKSTORE_NAME));
@@ -21,6 +29,10 @@ BackendApplication::BackendApplication(int &argc, char **argv)
     m_clp.addOption({ { u"v"_qs, u"version"_qs }, u"Display version information."_qs });
     m_clp.addOption({ u"rebuild-database"_qs, u"Rebuild the BrickLink database (required)."_qs });
     m_clp.addOption({ u"skip-download"_qs, u"Do not download the BrickLink XML database export (optional)."_qs });
+    m_clp.addOption({ u"render-thumbnails"_qs, u"Render LDraw thumbnails for all <item>@<color> entries in a list file."_qs, u"list"_qs });
+    m_clp.addOption({ u"ldraw"_qs, u"The LDraw library (folder or complete.zip) used for rendering thumbnails."_qs, u"path"_qs });
+    m_clp.addOption({ u"output"_qs, u"The picture database the thumbnails are written to (optional)."_qs, u"file"_qs });
+    m_clp.addOption({ u"size"_qs, u"The width of the rendered thumbnails in pixels, the aspect ratio is 4:3 (optional, default: 160)."_qs, u"size"_qs, u"160"_qs });
     m_clp.process(QCoreApplication::arguments());
 
     if (m_clp.isSet(u"version"_qs)) {
@@ -28,8 +40,12 @@ BackendApplication::BackendApplication(int &argc, char **argv)
         exit(0);
     }
 
-    if (!m_clp.isSet(u"rebuild-database"_qs))
+    if (m_clp.isSet(u"render-thumbnails"_qs)) {
+        if (!m_clp.isSet(u"ldraw"_qs))
+            m_clp.showHelp(1);
+    } else if (!m_clp.isSet(u"rebuild-database"_qs)) {
         m_clp.showHelp(1);
+    }
 }
 
 BackendApplication::~BackendApplication()
@@ -48,10 +64,25 @@ void BackendApplication::init()
         exit(2);
     }
 
+    if (m_clp.isSet(u"render-thumbnails"_qs)) {
+        QString output = m_clp.value(u"output"_qs);
+        if (output.isEmpty())
+            output = BrickLink::core()->dataPath() + u"picture_cache.sqlite"_qs;
+        int size = std::max(16, m_clp.value(u"size"_qs).toInt());
+
+        auto *rt = new RenderThumbnails(m_clp.value(u"render-thumbnails"_qs), m_clp.value(u"ldraw"_qs),
+                                        output, { size, size * 3 / 4 }, this);
+
+        QMetaObject::invokeMethod(rt, [rt]() {
+            exitWhenFinished(rt->exec());
+        }, Qt::QueuedConnection);
+        return;
+    }
+
     auto *rdb = new RebuildDatabase(m_clp.isSet(u"skip-download"_qs), this);
 
     QMetaObject::invokeMethod(rdb, [rdb]() {
-        QCoreApplication::exit(rdb->exec());
+        exitWhenFinished(rdb->exec());
     }, Qt::QueuedConnection);
 }
 
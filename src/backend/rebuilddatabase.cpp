@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cstdlib>
+#include <algorithm>
 
 #include <QFile>
 #include <QSaveFile>
@@ -14,6 +15,16 @@
 #include <QJsonValue>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QScopeGuard>
+#include <QtConcurrent>
+#include <QTimer>
+
+#include <QCoro/QCoroSignal>
+
+#include <lzma.h>
 
 #if defined(Q_OS_WINDOWS)
 #  include <windows.h>
@@ -64,7 +75,46 @@ int RebuildDatabase::error(const QString &error)
 }
 
 
-int RebuildDatabase::exec()
+static void writeFile(const QString &fileName, const QByteArray &data)
+{
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly) || (f.write(data) != data.size()) || !f.commit())
+        throw Exception(&f, "could not write file");
+}
+
+static QByteArray compressLZMA(const QByteArray &data)
+{
+    // the .lzma "alone" format is what the clients' decoder understands
+    lzma_options_lzma options;
+    if (lzma_lzma_preset(&options, LZMA_PRESET_DEFAULT))
+        throw Exception("could not initialize the LZMA options");
+
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_alone_encoder(&strm, &options) != LZMA_OK)
+        throw Exception("could not initialize the LZMA encoder");
+    auto cleanup = qScopeGuard([&strm]() { lzma_end(&strm); });
+
+    QByteArray compressed(std::max(data.size() / 4, qsizetype(64 * 1024)), Qt::Uninitialized);
+    strm.next_in = reinterpret_cast<const uint8_t *>(data.constData());
+    strm.avail_in = size_t(data.size());
+
+    lzma_ret ret;
+    do {
+        if (qsizetype(strm.total_out) == compressed.size())
+            compressed.resize(compressed.size() * 2);
+        strm.next_out = reinterpret_cast<uint8_t *>(compressed.data()) + strm.total_out;
+        strm.avail_out = size_t(compressed.size()) - size_t(strm.total_out);
+        ret = lzma_code(&strm, LZMA_FINISH);
+    } while (ret == LZMA_OK);
+
+    if (ret != LZMA_STREAM_END)
+        throw Exception("LZMA compression failed with error code %1").arg(int(ret));
+
+    compressed.resize(qsizetype(strm.total_out));
+    return compressed;
+}
+
+QCoro::Task<int> RebuildDatabase::exec()
 {
     m_trans = new Transfer;
 
@@ -97,42 +147,34 @@ int RebuildDatabase::exec()
                       { u"keepme_loggedin"_qs, u"1"_qs }});
 
         auto job = TransferJob::post(url);
-        bool loggedIn = false;
-        QByteArray httpReply;
-        auto loginConn = connect(m_trans, &Transfer::finished, this, [job, &loggedIn, &httpReply](TransferJob *j) {
-            if (job == j) {
-                loggedIn = true;
-                if (j->isFailed() || (j->responseCode() != 200))
-                    httpReply = *j->data();
-            }
-        });
-
         m_trans->retrieve(job, true);
 
-        while (!loggedIn)
-            QCoreApplication::processEvents();
+        QByteArray httpReply;
+        for (TransferJob *j = nullptr; j != job; )
+            j = co_await qCoro(m_trans, &Transfer::finished);
+        if (job->isFailed() || (job->responseCode() != 200))
+            httpReply = *job->data();
 
-        disconnect(loginConn);
         connect(m_trans, &Transfer::finished,
                 this, &RebuildDatabase::downloadJobFinished);
 
         if (!httpReply.isEmpty())
-            return error(u"Failed to log into BrickLink:\n"_qs + QString::fromLatin1(httpReply));
+            co_return error(u"Failed to log into BrickLink:\n"_qs + QString::fromLatin1(httpReply));
     }
 
     /////////////////////////////////////////////////////////////////////////////////
     if (!m_skip_download) {
         printf("\nSTEP 2: Downloading (text) database files...\n");
 
-        if (!download())
-            return error(m_error);
+        if (!co_await download())
+            co_return error(m_error);
     }
 
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 3: Parsing downloaded files...\n");
 
     if (!blti.import(bl->dataPath()))
-        return error(u"failed to parse database files."_qs);
+        co_return error(u"failed to parse database files."_qs);
 
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 4: Parsing inventories (part I)...\n");
@@ -143,8 +185,8 @@ int RebuildDatabase::exec()
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 5: Downloading missing/updated inventories...\n");
 
-    if (!downloadInventories(blti.items(), processedInvs))
-        return error(m_error);
+    if (!co_await downloadInventories(blti, processedInvs))
+        co_return error(m_error);
 
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 6: Parsing inventories (part II)...\n");
@@ -153,22 +195,29 @@ int RebuildDatabase::exec()
 
     if (std::count(processedInvs.cbegin(), processedInvs.cend(), false)
             > (int(processedInvs.size()) / 50)) {            // more than 2% have failed
-        return error(u"more than 2% of all inventories had errors."_qs);
+        co_return error(u"more than 2% of all inventories had errors."_qs);
     }
 
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 7: Calculating additional data...\n");
 
+    QElapsedTimer derivedTimer;
+    derivedTimer.start();
+
     blti.calculateKnownAssemblyColors();
     blti.calculateItemTypeCategories();
     blti.calculatePartsYearUsed();
     blti.calculateCategoryRecency();
 
+    printf("  > done in %lld ms\n", derivedTimer.restart());
+
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 8: Computing the database...\n");
 
     blti.finalizeDatabase();
 
+    printf("  > done in %lld ms\n", derivedTimer.elapsed());
+
     /////////////////////////////////////////////////////////////////////////////////
     printf("\nSTEP 9: Writing the database to disk...\n");
 
@@ -177,14 +226,55 @@ int RebuildDatabase::exec()
 
     Q_ASSERT(dbVersionHighest >= dbVersionLowest);
 
-    for (int v = dbVersionHighest; v >= dbVersionLowest; --v) {
-        printf("  > version %d... ", v);
-        auto dbVersion = static_cast<BrickLink::Database::Version>(v);
+    struct DatabaseOutput
+    {
+        BrickLink::Database::Version version;
+        QString error;
+        qint64 size = 0;
+        qint64 compressedSize = 0;
+        qint64 serializeTime = 0;
+        qint64 compressTime = 0;
+    };
+    QVector<DatabaseOutput> outputs;
+    for (int v = dbVersionHighest; v >= dbVersionLowest; --v)
+        outputs.append({ static_cast<BrickLink::Database::Version>(v) });
+
+    // every version is serialized into memory once and then saved both as-is and LZMA
+    // compressed for publishing: all versions are processed concurrently
+    QtConcurrent::blockingMap(outputs, [bl](DatabaseOutput &out) {
         try {
-            bl->database()->write(bl->dataPath() + BrickLink::Database::defaultDatabaseName(dbVersion), dbVersion);
-            printf("done\n");
+            QElapsedTimer timer;
+            timer.start();
+
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            bl->database()->write(&buffer, out.version);
+            buffer.close();
+            out.serializeTime = timer.restart();
+
+            const QString fileName = bl->dataPath() + BrickLink::Database::defaultDatabaseName(out.version);
+            writeFile(fileName, data);
+
+            // the clients expect a SHA-512 header in front of the LZMA stream
+            const QByteArray compressed = QCryptographicHash::hash(data, QCryptographicHash::Sha512)
+                    + compressLZMA(data);
+            writeFile(fileName + u".lzma", compressed);
+            out.compressTime = timer.elapsed();
+            out.size = data.size();
+            out.compressedSize = compressed.size();
         } catch (const Exception &e) {
-            printf("failed: %s\n", e.what());
+            out.error = e.errorString();
+        }
+    });
+
+    for (const auto &out : std::as_const(outputs)) {
+        printf("  > version %d... ", int(out.version));
+        if (out.error.isEmpty()) {
+            printf("done (%lld KB -> %lld KB, serialized in %lld ms, compressed in %lld ms)\n",
+                   out.size / 1024, out.compressedSize / 1024, out.serializeTime, out.compressTime);
+        } else {
+            printf("failed: %s\n", qPrintable(out.error));
         }
     }
 
@@ -192,7 +282,7 @@ int RebuildDatabase::exec()
 
 
     qInstallMessageHandler(nullptr);
-    return 0;
+    co_return 0;
 }
 
 static QUrlQuery partCategoriesQuery(char item_type)
@@ -227,7 +317,7 @@ static QUrlQuery dbQuery(int which)
     };
 }
 
-bool RebuildDatabase::download()
+QCoro::Task<bool> RebuildDatabase::download()
 {
     QString path = BrickLink::core()->dataPath();
 
@@ -345,133 +435,167 @@ bool RebuildDatabase::download()
         { nullptr, { }, nullptr }
     };
 
-    bool failed = false;
-    m_downloads_in_progress = 0;
-    m_downloads_failed = 0;
-
     { // workaround for U type
         QFile uif(path + u"items_U.txt"_qs);
         uif.open(QIODevice::WriteOnly);
     }
 
+    std::deque<Download> downloads;
+
     for (tptr = table; tptr->m_url; tptr++) {
-        auto *f = new QSaveFile(path + QString::fromLatin1(tptr->m_file));
-
-        if (!f->open(QIODevice::WriteOnly)) {
-            m_error = QString::fromLatin1("failed to write %1: %2")
-                          .arg(QString::fromLatin1(tptr->m_file), f->errorString());
-            delete f;
-            failed = true;
-            break;
-        }
         QUrl url(QString::fromLatin1(tptr->m_url));
         url.setQuery(tptr->m_query);
-
-        TransferJob *job = TransferJob::get(url, f, 2);
-        m_trans->retrieve(job);
-        m_downloads_in_progress++;
+        QString fileName = QString::fromLatin1(tptr->m_file);
+
+        downloads.push_back({ url, fileName, true, [path, fileName](const QByteArray &data) {
+                              QSaveFile f(path + fileName);
+                              if (!f.open(QIODevice::WriteOnly) || (f.write(data) != data.size())
+                                      || !f.commit()) {
+                                  throw Exception(&f, "failed to write %1").arg(fileName);
+                              }
+                          } });
     }
 
-    if (failed) {
-        m_trans->abortAllJobs();
-        return false;
+    co_return co_await runDownloads(std::move(downloads));
+}
+
+QCoro::Task<bool> RebuildDatabase::runDownloads(std::deque<Download> downloads)
+{
+    m_pendingDownloads = std::move(downloads);
+    m_activeDownloads.clear();
+    m_downloadsWaitingForRetry = 0;
+    m_downloadStats = { };
+    m_downloadStats.total = int(m_pendingDownloads.size());
+    m_downloadTimer.start();
+
+    // only print a summary every few seconds for large batches
+    QTimer progressTimer;
+    if (m_downloadStats.total > 100) {
+        connect(&progressTimer, &QTimer::timeout, this, &RebuildDatabase::printDownloadProgress);
+        progressTimer.start(5000);
     }
 
-    while (m_downloads_in_progress)
-        QCoreApplication::processEvents();
+    startDownloads();
+
+    if (!m_activeDownloads.isEmpty())
+        co_await qCoro(this, &RebuildDatabase::downloadsFinished);
 
-    if (m_downloads_failed)
-        return false;
+    progressTimer.stop();
+    printDownloadProgress();
 
-    return true;
+    co_return (m_downloadStats.failed == 0);
+}
+
+void RebuildDatabase::startDownloads()
+{
+    // keep a bounded window of jobs in flight: enough to saturate the Transfer's connections,
+    // but without queueing up 100k jobs at once
+    while ((m_activeDownloads.size() < MaxActiveDownloads) && !m_pendingDownloads.empty()) {
+        Download d = std::move(m_pendingDownloads.front());
+        m_pendingDownloads.pop_front();
+        // retries are handled by downloadJobFinished(), not by the Transfer
+        auto job = TransferJob::get(d.url);
+        m_activeDownloads.insert(job, d);
+        m_trans->retrieve(job);
+    }
 }
 
 void RebuildDatabase::downloadJobFinished(TransferJob *job)
 {
-    if (job) {
-        auto *f = qobject_cast<QSaveFile *>(job->file());
+    auto it = m_activeDownloads.find(job);
+    if (it == m_activeDownloads.end())
+        return;
+
+    Download d = it.value();
+    m_activeDownloads.erase(it);
 
-        m_downloads_in_progress--;
-        bool ok = false;
+    bool ok = false;
+    QString error;
 
-        if (job->isCompleted() && f) {
-            if (f->commit())
-                ok = true;
+    if (job->isCompleted()) {
+        m_downloadStats.bytes += job->data()->size();
+        try {
+            d.store(*job->data());
+            ok = true;
+        } catch (const Exception &e) {
+            error = e.errorString();
+        }
+    } else {
+        error = u"Failed to download file: "_qs + job->errorString();
+    }
+
+    if (!ok && !job->isCompleted() && (d.attempt < MaxDownloadRetries)) {
+        // transfer errors are retried with an exponential backoff, parse errors are final
+        const int delay = 1000 << d.attempt;
+        ++d.attempt;
+        ++m_downloadStats.retried;
+        ++m_downloadsWaitingForRetry;
+
+        QTimer::singleShot(delay, this, [this, d]() {
+            --m_downloadsWaitingForRetry;
+            m_pendingDownloads.push_front(d);
+            startDownloads();
+        });
+    } else {
+        if (ok) {
+            ++m_downloadStats.done;
+        } else {
+            ++m_downloadStats.failed;
+            m_error = error;
+        }
+        if (d.verbose || !ok) {
+            printf("%c > %s", ok ? ' ' : '*', qPrintable(d.name));
+            if (ok)
+                printf("\n");
             else
-                m_error = f->errorString();
+                printf(" (%s)\n", qPrintable(error));
         }
-        else
-            m_error = u"Failed to download file: "_qs + job->errorString();
-
-        if (!ok)
-            m_downloads_failed++;
-
-        QString fname = f ? f->fileName() : job->effectiveUrl().toString();
-        fname.remove(0, BrickLink::core()->dataPath().length());
-        printf("%c > %s", ok ? ' ' : '*', qPrintable(fname));
-        if (ok)
-            printf("\n");
-        else
-            printf(" (%s)\n", qPrintable(m_error));
     }
-}
 
+    startDownloads();
 
-bool RebuildDatabase::downloadInventories(const std::vector<BrickLink::Item> &invs,
-                                          const std::vector<bool> &processedInvs)
+    if (m_activeDownloads.isEmpty() && m_pendingDownloads.empty() && !m_downloadsWaitingForRetry)
+        emit downloadsFinished();
+}
+
+void RebuildDatabase::printDownloadProgress()
 {
-    bool failed = false;
-    m_downloads_in_progress = 0;
-    m_downloads_failed = 0;
+    const double secs = std::max(0.001, double(m_downloadTimer.elapsed()) / 1000.);
+    const auto &st = m_downloadStats;
+
+    printf("  > %d/%d done, %d failed, %d retries, %.1f files/s, %.1f KB/s\n",
+           st.done, st.total, st.failed, st.retried, double(st.done) / secs,
+           double(st.bytes) / 1024. / secs);
+}
 
+QCoro::Task<bool> RebuildDatabase::downloadInventories(BrickLink::TextImport &blti,
+                                                       const std::vector<bool> &processedInvs)
+{
+    const auto &invs = blti.items();
     QUrl url(u"https://www.bricklink.com/catalogDownload.asp"_qs);
+    std::deque<Download> downloads;
 
     for (uint i = 0; i < invs.size(); ++i) {
         const BrickLink::Item *item = &invs[i];
         if (!processedInvs[i]) {
-            QSaveFile *f = BrickLink::core()->dataSaveFile(u"inventory.xml", item);
-
-            if (!f || !f->isOpen()) {
-                if (f)
-                    m_error = u"failed to write "_qs + f->fileName() + u": " + f->errorString();
-                else
-                    m_error = u"could not get a file handle to write inventory for "_qs + QString::fromLatin1(item->id());
-                delete f;
-                failed = true;
-                break;
-            }
-
             url.setQuery({{ u"a"_qs,            u"a"_qs },
                           { u"viewType"_qs,     u"4"_qs },
                           { u"itemTypeInv"_qs,  QString(QChar::fromLatin1(item->itemTypeId())) },
                           { u"itemNo"_qs,       QString::fromLatin1(item->id()) },
                           { u"downloadType"_qs, u"X"_qs }});
 
-            TransferJob *job = TransferJob::get(url, f, 2);
-            m_trans->retrieve(job);
-            m_downloads_in_progress++;
-        }
-
-        // avoid "too many open files" errors
-        if (m_downloads_in_progress > 100) {
-            while (m_downloads_in_progress > 50)
-                QCoreApplication::processEvents();
+            // parse as we download: the XML goes straight into the inventory store
+            downloads.push_back({ url, u"inventory "_qs + QLatin1Char(item->itemTypeId()) + u' '
+                                   + QString::fromLatin1(item->id()), false,
+                               [&blti, item](const QByteArray &data) {
+                                   blti.addDownloadedInventory(item, data);
+                               } });
         }
     }
 
-    if (failed) {
-        QString err = m_error;
-
-        m_trans->abortAllJobs();
-
-        m_error = err;
-        return false;
-    }
-
-    while (m_downloads_in_progress)
-        QCoreApplication::processEvents();
-
-    return true;
+    // failed inventories are dealt with in the next step
+    co_await runDownloads(std::move(downloads));
+    co_return true;
 }
 
 #include "moc_rebuilddatabase.cpp"
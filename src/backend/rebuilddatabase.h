@@ -3,12 +3,24 @@
 
 #pragma once
 
+#include <deque>
+#include <functional>
+
 #include <QObject>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QUrl>
+
+#include <QCoro/QCoroTask>
 
 #include "bricklink/global.h"
 #include "utility/transfer.h"
 
+namespace BrickLink {
+class TextImport;
+}
+
 
 class RebuildDatabase : public QObject
 {
@@ -17,23 +29,51 @@ public:
     RebuildDatabase(bool skipDownload = false, QObject *parent = nullptr);
     ~RebuildDatabase() override;
 
-    int exec();
+    QCoro::Task<int> exec();
+
+signals:
+    void downloadsFinished();
 
 private slots:
     void downloadJobFinished(TransferJob *job);
 
 private:
+    struct Download
+    {
+        QUrl url;
+        QString name;
+        bool verbose = false;
+        std::function<void(const QByteArray &)> store; // throws on errors
+        int attempt = 0;
+    };
+
     int error(const QString &);
 
-    bool download();
-    bool downloadInventories(const std::vector<BrickLink::Item> &invs, const std::vector<bool> &processedInvs);
+    QCoro::Task<bool> download();
+    QCoro::Task<bool> downloadInventories(BrickLink::TextImport &blti, const std::vector<bool> &processedInvs);
+    QCoro::Task<bool> runDownloads(std::deque<Download> downloads);
+    void startDownloads();
+    void printDownloadProgress();
 
 private:
+    static constexpr int MaxActiveDownloads = 24;
+    static constexpr int MaxDownloadRetries = 4;
+
     Transfer *m_trans;
     QString m_error;
     bool m_skip_download;
-    int m_downloads_in_progress = 0;
-    int m_downloads_failed = 0;
     QDateTime m_date;
     QString m_rebrickableApiKey;
+
+    std::deque<Download> m_pendingDownloads;
+    QHash<TransferJob *, Download> m_activeDownloads;
+    int m_downloadsWaitingForRetry = 0;
+    struct {
+        int total = 0;
+        int done = 0;
+        int failed = 0;
+        int retried = 0;
+        qint64 bytes = 0;
+    } m_downloadStats;
+    QElapsedTimer m_downloadTimer;
 };
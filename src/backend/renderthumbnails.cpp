@@ -0,0 +1,231 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+
+#include <QFile>
+#include <QBuffer>
+#include <QDateTime>
+#include <QMap>
+#include <QCoreApplication>
+#include <QtConcurrent>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include <QCoro/QCoroFuture>
+
+#include "bricklink/core.h"
+#include "bricklink/color.h"
+#include "bricklink/item.h"
+#include "ldraw/library.h"
+#include "ldraw/part.h"
+#include "ldraw/thumbnailrenderer.h"
+#include "utility/exception.h"
+#include "renderthumbnails.h"
+
+
+RenderThumbnails::RenderThumbnails(const QString &listFile, const QString &ldrawPath,
+                                   const QString &outputFile, const QSize &size, QObject *parent)
+    : QObject(parent)
+    , m_listFile(listFile)
+    , m_ldrawPath(ldrawPath)
+    , m_outputFile(outputFile)
+    , m_size(size)
+{
+    // disable buffering on stdout
+    setvbuf(stdout, nullptr, _IONBF, 0);
+}
+
+RenderThumbnails::~RenderThumbnails()
+{ }
+
+int RenderThumbnails::error(const QString &error)
+{
+    if (error.isEmpty())
+        printf(" FAILED.\n");
+    else
+        printf(" FAILED: %s\n", qPrintable(error));
+
+    return 2;
+}
+
+QCoro::Task<int> RenderThumbnails::exec()
+{
+    auto *bl = BrickLink::core();
+
+    /////////////////////////////////////////////////////////////////////////////////
+    printf("\n STEP 1: Loading the BrickLink database...\n");
+
+    try {
+        bl->database()->read();
+    } catch (const Exception &e) {
+        co_return error(e.errorString());
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////
+    printf("\n STEP 2: Loading the LDraw library...\n");
+
+    LDraw::create({ });
+    if (!co_await LDraw::library()->setPath(m_ldrawPath) || !LDraw::library()->isValid())
+        co_return error(u"no valid LDraw library found at "_qs + m_ldrawPath);
+
+    /////////////////////////////////////////////////////////////////////////////////
+    printf("\n STEP 3: Parsing the list of thumbnails...\n");
+
+    // group all requested colors by item, so that every part is only loaded once
+    QMap<const BrickLink::Item *, QVector<const BrickLink::Color *>> jobs;
+    int jobCount = 0;
+
+    {
+        QFile f(m_listFile);
+        if (!f.open(QIODevice::ReadOnly))
+            co_return error(u"could not open "_qs + m_listFile + u": " + f.errorString());
+
+        int lineNumber = 0;
+        while (!f.atEnd()) {
+            const QByteArray line = f.readLine().trimmed();
+            ++lineNumber;
+            if (line.isEmpty() || line.startsWith('#'))
+                continue;
+
+            // <item-type-id><item-id>@<color-id>, e.g. P3001@5
+            const auto at = line.lastIndexOf('@');
+            bool colorOk = false;
+            const uint colorId = (at > 1) ? line.mid(at + 1).toUInt(&colorOk) : 0;
+            const auto *item = (at > 1) ? bl->item(line.at(0), line.mid(1, at - 1)) : nullptr;
+            const auto *color = colorOk ? bl->color(colorId) : nullptr;
+
+            if (!item || !color) {
+                printf("  > line %d: skipping invalid entry %s\n", lineNumber, line.constData());
+                continue;
+            }
+            auto &colors = jobs[item];
+            if (!colors.contains(color)) {
+                colors.append(color);
+                ++jobCount;
+            }
+        }
+    }
+    printf("  > %d thumbnails for %d items\n", jobCount, int(jobs.size()));
+
+    /////////////////////////////////////////////////////////////////////////////////
+    printf("\n STEP 4: Opening the picture database...\n");
+
+    auto db = QSqlDatabase::addDatabase(u"QSQLITE"_qs, u"RenderThumbnails"_qs);
+    db.setDatabaseName(m_outputFile);
+
+    if (!db.open())
+        co_return error(db.lastError().text());
+
+    // the same schema as the PictureCache, so the output can be used as a drop-in replacement
+    QSqlQuery createQuery(db);
+    if (!createQuery.exec(u"CREATE TABLE IF NOT EXISTS pic ("
+                          "id TEXT NOT NULL PRIMARY KEY, "
+                          "updated INTEGER, "             // msecsSinceEpoch
+                          "accessed INTEGER NOT NULL, "   // msecsSinceEpoch
+                          "data BLOB, "
+                          "etag TEXT, "                   // HTTP ETag
+                          "modified INTEGER) "            // HTTP Last-Modified, msecsSinceEpoch
+                          "WITHOUT ROWID;"_qs)) {
+        co_return error(createQuery.lastError().text());
+    }
+    {
+        QSqlQuery uvQuery(u"PRAGMA user_version;"_qs, db);
+        uvQuery.next();
+        const int userVersion = uvQuery.value(0).toInt();
+        if (userVersion == 1) {
+            QSqlQuery alterQuery(db);
+            if (!alterQuery.exec(u"ALTER TABLE pic ADD COLUMN etag TEXT;"_qs)
+                    || !alterQuery.exec(u"ALTER TABLE pic ADD COLUMN modified INTEGER;"_qs)) {
+                co_return error(alterQuery.lastError().text());
+            }
+        }
+        if (userVersion < 2)
+            QSqlQuery(u"PRAGMA user_version=2;"_qs, db);
+    }
+
+    // rendered thumbnails have no HTTP validators, so any stale ones have to go
+    QSqlQuery saveQuery(db);
+    saveQuery.prepare(u"INSERT INTO pic(id,updated,accessed,data) VALUES(:id,:updated,:accessed,:data) "
+                      "ON CONFLICT(id) DO UPDATE "
+                      "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data,"
+                      "etag=NULL,modified=NULL;"_qs);
+
+    /////////////////////////////////////////////////////////////////////////////////
+    printf("\n STEP 5: Rendering...\n");
+
+    struct Thumbnail
+    {
+        const BrickLink::Item *item;
+        const BrickLink::Color *color;
+        LDraw::Part *part;
+        QByteArray data;
+    };
+
+    const LDraw::ThumbnailRenderer renderer(m_size);
+    int rendered = 0;
+    int missingParts = 0;
+    int failed = 0;
+
+    // load the parts for a batch of items, then render all their colors in parallel: only the
+    // parts of the current batch stay ref'ed, which keeps the memory usage in check
+    static constexpr int BatchSize = 64;
+
+    for (auto it = jobs.cbegin(); it != jobs.cend(); ) {
+        QVector<Thumbnail> batch;
+        QVector<LDraw::Part *> parts;
+
+        for (int i = 0; (i < BatchSize) && (it != jobs.cend()); ++i, ++it) {
+            LDraw::Part *part = co_await LDraw::library()->partFromBrickLinkId(it.key()->id());
+            if (!part) {
+                missingParts += int(it.value().size());
+                continue;
+            }
+            parts.append(part);
+            for (const auto *color : it.value())
+                batch.append({ it.key(), color, part, { } });
+        }
+
+        QtConcurrent::blockingMap(batch, [&renderer](Thumbnail &t) {
+            QImage img = renderer.render(t.part, t.color);
+            if (!img.isNull()) {
+                QBuffer buffer(&t.data);
+                img.save(&buffer, "WEBP", 80);
+            }
+        });
+
+        for (auto *part : std::as_const(parts))
+            part->release();
+
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        db.transaction();
+        for (const auto &t : std::as_const(batch)) {
+            if (t.data.isEmpty()) {
+                ++failed;
+                continue;
+            }
+            saveQuery.bindValue(u":id"_qs, QLatin1Char(t.item->itemTypeId()) + QLatin1String(t.item->id())
+                                + u'@' + QString::number(t.color->id()));
+            saveQuery.bindValue(u":updated"_qs, now);
+            saveQuery.bindValue(u":accessed"_qs, now);
+            saveQuery.bindValue(u":data"_qs, t.data);
+            if (saveQuery.exec())
+                ++rendered;
+            else
+                ++failed;
+        }
+        db.commit();
+
+        printf("  > %d / %d\r", rendered + failed + missingParts, jobCount);
+    }
+
+    printf("\n  > rendered: %d, no LDraw part: %d, failed: %d\n", rendered, missingParts, failed);
+
+    db.close();
+
+    printf("\nFINISHED.\n\n");
+    co_return (failed || !rendered) ? 1 : 0;
+}
+
+#include "moc_renderthumbnails.cpp"
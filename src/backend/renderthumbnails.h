@@ -0,0 +1,30 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+#include <QCoro/QCoroTask>
+
+
+class RenderThumbnails : public QObject
+{
+    Q_OBJECT
+public:
+    RenderThumbnails(const QString &listFile, const QString &ldrawPath, const QString &outputFile,
+                     const QSize &size, QObject *parent = nullptr);
+    ~RenderThumbnails() override;
+
+    QCoro::Task<int> exec();
+
+private:
+    int error(const QString &);
+
+    QString m_listFile;
+    QString m_ldrawPath;
+    QString m_outputFile;
+    QSize m_size;
+};
@@ -0,0 +1,186 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+
+#include <QtCore/QVarLengthArray>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "bricklink/core.h"
+#include "bricklink/item.h"
+#include "bricklink/canbuild.h"
+
+
+namespace BrickLink {
+
+std::shared_ptr<const CanBuild> CanBuild::instance()
+{
+    static std::shared_ptr<const CanBuild> s_instance;
+
+    if (!s_instance) {
+        static bool connected = false;
+        if (!connected) {
+            // running queries keep their own reference, but new ones need a fresh index
+            QObject::connect(core()->database(), &Database::databaseAboutToBeReset,
+                             core(), []() { s_instance.reset(); });
+            connected = true;
+        }
+        s_instance.reset(new CanBuild);
+    }
+    return s_instance;
+}
+
+void CanBuild::build() const
+{
+    static const QByteArray canBuildIds = "SM";
+
+    std::vector<std::pair<quint32, quint32>> pairs; // key, set index | PrimaryFlag
+
+    for (const Item &item : core()->items()) {
+        if (!item.hasInventory() || !canBuildIds.contains(item.itemTypeId()))
+            continue;
+
+        const auto setIndex = quint32(m_sets.size());
+        const auto first = std::ptrdiff_t(pairs.size());
+
+        for (const auto &co : item.consistsOf()) {
+            if (co.isExtra() || co.isCounterPart())
+                continue;
+            pairs.emplace_back(key(co.colorIndex(), co.itemIndex()),
+                               setIndex | (co.alternateId() ? 0 : PrimaryFlag));
+        }
+
+        // one posting per key and set: a primary part wins over an alternate one
+        auto begin = pairs.begin() + first;
+        std::sort(begin, pairs.end(), [](const auto &p1, const auto &p2) {
+            return (p1.first < p2.first) || ((p1.first == p2.first) && (p1.second > p2.second));
+        });
+        pairs.erase(std::unique(begin, pairs.end(), [](const auto &p1, const auto &p2) {
+                        return p1.first == p2.first; }), pairs.end());
+
+        const auto primaryKeys = std::count_if(pairs.begin() + first, pairs.end(), [](const auto &p) {
+            return p.second & PrimaryFlag; });
+        m_sets.push_back({ &item, quint32(primaryKeys) });
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](const auto &p1, const auto &p2) {
+        return p1.first < p2.first;
+    });
+
+    m_postings.reserve(pairs.size());
+    for (const auto &[k, posting] : pairs) {
+        if (m_keys.empty() || (m_keys.back() != k)) {
+            m_keys.push_back(k);
+            m_offsets.push_back(quint32(m_postings.size()));
+        }
+        m_postings.push_back(posting);
+    }
+    m_offsets.push_back(quint32(m_postings.size()));
+}
+
+float CanBuild::buildable(const Item *set, const Have &have) const
+{
+    int required = 0;
+    int owned = 0;
+
+    // only the parts of this inventory are counted down, the available lots are never copied
+    QHash<quint32, int> used;
+    auto available = [&](quint32 k) {
+        return have.value(k) - used.value(k);
+    };
+
+    struct Alternate
+    {
+        int required = 0;
+        int owned = 0;
+        bool matched = false;
+    };
+    QVarLengthArray<Alternate, 16> alternates;
+
+    for (const auto &co : set->consistsOf()) {
+        if (co.isExtra() || co.isCounterPart())
+            continue;
+
+        const quint32 k = key(co.colorIndex(), co.itemIndex());
+        const int quantity = co.quantity();
+        const int got = std::clamp(available(k), 0, quantity);
+
+        if (const auto alternate = qsizetype(co.alternateId())) {
+            if (alternates.size() < alternate)
+                alternates.resize(alternate);
+            auto &alt = alternates[alternate - 1];
+            if (alt.matched)
+                continue;
+
+            // an alternate group is satisfied by any one of its parts: only a complete match
+            // uses up parts, otherwise the best partial match is remembered for the score
+            if (got == quantity) {
+                used[k] += got;
+                alt = { quantity, got, true };
+            } else if (!alt.required || ((qint64(got) * alt.required) > (qint64(alt.owned) * quantity))) {
+                alt = { quantity, got, false };
+            }
+        } else {
+            if (got)
+                used[k] += got;
+            required += quantity;
+            owned += got;
+        }
+    }
+    for (const auto &alt : std::as_const(alternates)) {
+        required += alt.required;
+        owned += alt.owned;
+    }
+    return (required && owned) ? (float(owned) / float(required)) : 0.f;
+}
+
+QVector<CanBuild::Result> CanBuild::query(const Have &have, float minBuildable) const
+{
+    std::call_once(m_built, [this]() { build(); });
+
+    // 0: not touched, otherwise 1 + the number of shared primary keys
+    std::vector<quint32> hits(m_sets.size(), 0);
+    std::vector<quint32> touched;
+
+    for (auto it = have.cbegin(); it != have.cend(); ++it) {
+        if (it.value() <= 0)
+            continue;
+        auto kit = std::lower_bound(m_keys.cbegin(), m_keys.cend(), it.key());
+        if ((kit == m_keys.cend()) || (*kit != it.key()))
+            continue;
+
+        const auto ki = size_t(kit - m_keys.cbegin());
+        for (auto p = m_offsets[ki]; p < m_offsets[ki + 1]; ++p) {
+            const quint32 posting = m_postings[p];
+            auto &h = hits[posting & ~PrimaryFlag];
+            if (!h) {
+                h = 1;
+                touched.push_back(posting & ~PrimaryFlag);
+            }
+            if (posting & PrimaryFlag)
+                ++h;
+        }
+    }
+
+    // a complete build needs every primary part, so only those inventories need to be counted
+    const bool complete = (minBuildable >= 1.f);
+    std::vector<Result> candidates;
+    candidates.reserve(touched.size());
+    for (const quint32 setIndex : touched) {
+        if (!complete || ((hits[setIndex] - 1) == m_sets[setIndex].m_primaryKeys))
+            candidates.push_back({ m_sets[setIndex].m_item, 0.f });
+    }
+
+    QtConcurrent::blockingMap(candidates, [this, &have](Result &r) {
+        r.m_buildable = buildable(r.m_item, have);
+    });
+
+    QVector<Result> results;
+    for (const auto &r : candidates) {
+        if (r.m_buildable >= minBuildable)
+            results.append(r);
+    }
+    return results;
+}
+
+} // namespace BrickLink
@@ -0,0 +1,61 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include "bricklink/global.h"
+
+
+namespace BrickLink {
+
+// An inverted index from every (color, item) to the set and minifig inventories it appears in.
+// A query only touches the inventories that share at least one part with the available lots
+// and counts them down sparsely, instead of checking every inventory against all lots.
+
+class CanBuild
+{
+public:
+    using Have = QHash<quint32, int>; // key() -> available quantity
+
+    struct Result
+    {
+        const Item *m_item;
+        float m_buildable;  // 0 .. 1, weighted by part quantities
+    };
+
+    static std::shared_ptr<const CanBuild> instance();
+
+    static quint32 key(uint colorIndex, uint itemIndex) { return (colorIndex << 20) | itemIndex; }
+
+    // thread-safe: the index is built on first use
+    QVector<Result> query(const Have &have, float minBuildable = 1.f) const;
+
+private:
+    CanBuild() = default;
+    void build() const;
+    float buildable(const Item *set, const Have &have) const;
+
+    struct Set
+    {
+        const Item *m_item;
+        quint32 m_primaryKeys;  // distinct (color, item) keys that are not part of an alternate group
+    };
+
+    // CSR layout: the postings for m_keys[i] are m_postings[m_offsets[i] .. m_offsets[i + 1]]
+    mutable std::once_flag m_built;
+    mutable std::vector<Set> m_sets;
+    mutable std::vector<quint32> m_keys;
+    mutable std::vector<quint32> m_offsets;
+    mutable std::vector<quint32> m_postings;  // set index | PrimaryFlag
+
+    static constexpr quint32 PrimaryFlag = 0x80000000;
+};
+
+} // namespace BrickLink
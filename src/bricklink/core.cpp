@@ -19,6 +19,7 @@
 #include <QRunnable>
 #include <QMetaObject>
 #include <QMetaEnum>
+#include <QTimer>
 
 #include "utility/appstatistics.h"
 #include "utility/q5hashfunctions.h"
@@ -374,6 +375,19 @@ Core::Core(const QString &datadir, const QString &updateUrl, quint64 physicalMem
         qInfo().noquote() << "Currently active BrickLink API quirks:\n " << quirks.join(u"\n  "_qs);
 
     m_transferStatId = AppStatistics::inst()->addSource(u"HTTP requests"_qs);
+    m_transferThroughputStatId = AppStatistics::inst()->addSource(u"HTTP throughput"_qs, u"KB/s"_qs);
+    m_transferCoalescedStatId = AppStatistics::inst()->addSource(u"HTTP requests coalesced"_qs);
+
+    auto *transferStatTimer = new QTimer(this);
+    connect(transferStatTimer, &QTimer::timeout, this, [this, lastBytes = qint64(0)]() mutable {
+        const auto bytes = m_transfer->bytesReceived() + m_authenticatedTransfer->bytesReceived();
+        const auto interval = std::max(1, AppStatistics::inst()->updateInterval());
+        AppStatistics::inst()->update(m_transferThroughputStatId, (bytes - lastBytes) * 1000 / 1024 / interval);
+        AppStatistics::inst()->update(m_transferCoalescedStatId, m_transfer->coalescedJobCount()
+                                      + m_authenticatedTransfer->coalescedJobCount());
+        lastBytes = bytes;
+    });
+    transferStatTimer->start(AppStatistics::inst()->updateInterval());
 
     //TODO: See if we cannot make this cancellation a bit more robust.
     //      Right now, cancelTransfers() is fully async. We could potentially detect when all
@@ -169,6 +169,8 @@ private:
     TransferJob *              m_loginJob = nullptr;
     QVector<TransferJob *>     m_jobsWaitingForAuthentication;
     int                        m_transferStatId = -1;
+    int                        m_transferThroughputStatId = -1;
+    int                        m_transferCoalescedStatId = -1;
 
     std::unique_ptr<Database> m_database;
 #if !defined(BS_BACKEND)
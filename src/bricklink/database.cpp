@@ -494,13 +494,26 @@ void Database::write(const QString &filename, Version version) const
     if (!f.open(QIODevice::WriteOnly))
         throw Exception(&f, "could not open database for writing");
 
-    ChunkWriter cw(&f, QDataStream::LittleEndian);
+    write(&f, version);
+
+    if (!f.commit())
+        throw Exception(f.errorString());
+}
+
+void Database::write(QIODevice *out, Version version) const
+{
+    if (version <= Version::Invalid)
+        throw Exception("version %1 is too old").arg(int(version));
+
+    ChunkWriter cw(out, QDataStream::LittleEndian);
     QDataStream &ds = cw.dataStream();
 
-    auto check = [&ds, &f](bool ok) {
-        if (!ok || (ds.status() != QDataStream::Ok))
+    auto check = [&ds, out](bool ok) {
+        if (!ok || (ds.status() != QDataStream::Ok)) {
+            auto *fd = qobject_cast<QFileDevice *>(out);
             throw Exception("failed to write to database (%1) at position %2")
-                .arg(f.fileName()).arg(f.pos());
+                .arg(fd ? fd->fileName() : u"memory"_qs).arg(out->pos());
+        }
     };
 
     check(cw.startChunk(ChunkId('B','S','D','B'), uint(version)));
@@ -586,9 +599,6 @@ void Database::write(const QString &filename, Version version) const
     }
 
     check(cw.endChunk()); // BSDB root chunk
-
-    if (!f.commit())
-        throw Exception(f.errorString());
 }
 
 void Database::remove()
@@ -18,6 +18,7 @@
 #include "utility/memoryresource.h"
 
 
+QT_FORWARD_DECLARE_CLASS(QIODevice)
 class Transfer;
 class TransferJob;
 
@@ -69,6 +70,7 @@ public:
 
     void read(const QString &fileName = { });
     void write(const QString &fileName, Version version) const;
+    void write(QIODevice *out, Version version) const;
 
     static void remove();
 
@@ -0,0 +1,268 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstring>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDataStream>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtEndian>
+#include <QtCore/QtDebug>
+
+#include "utility/exception.h"
+#include "utility/xmlhelpers.h"
+#include "bricklink/item.h"
+#include "bricklink/itemtype.h"
+#include "bricklink/inventorystore.h"
+
+/* File layout:
+ *   header: "BSINVST1"
+ *   records: quint32 (LE) payload size, quint16 (LE) payload CRC, payload
+ *
+ * The payload is a QDataStream: key (item-type + item-id), download date, record count and
+ * the records themselves. A record with a bad size or CRC at the end of the file is the
+ * result of an interrupted write: it is cut off when the store is opened.
+ */
+
+static constexpr char Magic[] = "BSINVST1";
+static constexpr qint64 HeaderSize = 8;
+static constexpr qint64 RecordHeaderSize = 6;
+static constexpr auto StreamVersion = QDataStream::Qt_6_0;
+
+
+namespace BrickLink {
+
+InventoryStore::InventoryStore(const QString &fileName)
+    : m_fileName(fileName)
+{ }
+
+InventoryStore::~InventoryStore()
+{ }
+
+QByteArray InventoryStore::key(const Item *item)
+{
+    return item->itemTypeId() + item->id();
+}
+
+void InventoryStore::open()
+{
+    m_file.close();
+    m_file.setFileName(m_fileName);
+    m_index.clear();
+    m_liveBytes = 0;
+
+    if (!m_file.open(QIODevice::ReadWrite))
+        throw Exception(&m_file, "could not open the inventory store");
+
+    const qint64 fileSize = m_file.size();
+    qint64 validSize = HeaderSize;
+
+    if (fileSize < HeaderSize) {
+        if (!m_file.resize(0) || (m_file.write(Magic, HeaderSize) != HeaderSize) || !m_file.flush())
+            throw Exception(&m_file, "could not initialize the inventory store");
+        return;
+    }
+
+    const uchar *data = m_file.map(0, fileSize);
+    if (!data)
+        throw Exception(&m_file, "could not memory-map the inventory store");
+
+    if (memcmp(data, Magic, HeaderSize) != 0) {
+        m_file.unmap(const_cast<uchar *>(data));
+        throw Exception(&m_file, "not a valid inventory store");
+    }
+
+    // a single sequential pass: later records for the same key shadow older ones
+    while ((validSize + RecordHeaderSize) <= fileSize) {
+        const auto size = qFromLittleEndian<quint32>(data + validSize);
+        const auto crc = qFromLittleEndian<quint16>(data + validSize + 4);
+        const qint64 payloadOffset = validSize + RecordHeaderSize;
+
+        if ((payloadOffset + size) > fileSize)
+            break;
+        auto payload = QByteArray::fromRawData(reinterpret_cast<const char *>(data) + payloadOffset,
+                                               qsizetype(size));
+        if (qChecksum(payload) != crc)
+            break;
+
+        QDataStream ds(payload);
+        ds.setVersion(StreamVersion);
+        QByteArray key;
+        qint64 downloaded;
+        ds >> key >> downloaded;
+        if (ds.status() != QDataStream::Ok)
+            break;
+
+        auto it = m_index.find(key);
+        if (it != m_index.end())
+            m_liveBytes -= (RecordHeaderSize + it->size);
+        m_index.insert(key, { payloadOffset, qint32(size), downloaded });
+        m_liveBytes += (RecordHeaderSize + size);
+
+        validSize = payloadOffset + size;
+    }
+    m_file.unmap(const_cast<uchar *>(data));
+
+    if (validSize < fileSize) {
+        qWarning() << "Inventory store" << m_fileName << "is truncated at offset" << validSize;
+        if (!m_file.resize(validSize))
+            throw Exception(&m_file, "could not truncate the inventory store");
+    }
+}
+
+void InventoryStore::compact()
+{
+    if (!m_file.isOpen())
+        return;
+    if (!m_file.flush())
+        throw Exception(&m_file, "could not write to the inventory store");
+
+    // only rewrite the file if at least a third of it is dead weight
+    const qint64 totalBytes = m_file.size() - HeaderSize;
+    if (m_liveBytes >= (totalBytes * 2 / 3))
+        return;
+
+    QVector<std::pair<QByteArray, Entry>> entries;
+    entries.reserve(m_index.size());
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it)
+        entries.append({ it.key(), it.value() });
+
+    // keep the file order, so reading the old file is sequential
+    std::sort(entries.begin(), entries.end(), [](const auto &e1, const auto &e2) {
+        return e1.second.offset < e2.second.offset;
+    });
+
+    QSaveFile out(m_fileName);
+    if (!out.open(QIODevice::WriteOnly))
+        throw Exception(&out, "could not compact the inventory store");
+    out.write(Magic, HeaderSize);
+
+    for (const auto &[key, entry] : std::as_const(entries)) {
+        if (!m_file.seek(entry.offset - RecordHeaderSize))
+            throw Exception(&m_file, "could not read from the inventory store");
+        const QByteArray record = m_file.read(RecordHeaderSize + entry.size);
+        if (record.size() != (RecordHeaderSize + entry.size))
+            throw Exception(&m_file, "could not read from the inventory store");
+        out.write(record);
+    }
+    m_file.close();
+
+    // the old file is left untouched if the commit fails, so just continue to use it
+    const bool committed = out.commit();
+    open();
+    if (!committed)
+        throw Exception(&out, "could not compact the inventory store");
+}
+
+QDateTime InventoryStore::lastDownload(const Item *item) const
+{
+    auto it = m_index.constFind(key(item));
+    if (it == m_index.cend())
+        return { };
+    return QDateTime::fromMSecsSinceEpoch(it->downloaded, Qt::UTC);
+}
+
+QVector<InventoryStore::Record> InventoryStore::inventory(const Item *item)
+{
+    auto it = m_index.constFind(key(item));
+    if (it == m_index.cend())
+        return { };
+
+    if (!m_file.seek(it->offset))
+        throw Exception(&m_file, "could not read from the inventory store");
+    const QByteArray payload = m_file.read(it->size);
+
+    QDataStream ds(payload);
+    ds.setVersion(StreamVersion);
+    QByteArray key;
+    qint64 downloaded;
+    quint32 count = 0;
+    ds >> key >> downloaded >> count;
+
+    QVector<Record> records;
+    records.reserve(qsizetype(std::min(count, 100000U)));
+
+    for (quint32 i = 0; (i < count) && (ds.status() == QDataStream::Ok); ++i) {
+        qint8 itemTypeId;
+        quint32 colorId, matchId;
+        qint32 quantity;
+        quint8 flags;
+        Record r;
+        ds >> itemTypeId >> r.itemId >> colorId >> quantity >> flags >> matchId;
+        r.itemTypeId = char(itemTypeId);
+        r.colorId = colorId;
+        r.quantity = quantity;
+        r.extra = (flags & 1);
+        r.counterPart = (flags & 2);
+        r.alternate = (flags & 4);
+        r.matchId = matchId;
+        records.append(r);
+    }
+    if ((payload.size() != it->size) || (ds.status() != QDataStream::Ok))
+        throw Exception("corrupt inventory record for %1").arg(QString::fromLatin1(it.key()));
+
+    return records;
+}
+
+void InventoryStore::insert(const Item *item, const QDateTime &downloaded,
+                            const QVector<Record> &records)
+{
+    const QByteArray k = key(item);
+    const qint64 downloadedMSecs = downloaded.toMSecsSinceEpoch();
+
+    QByteArray payload;
+    {
+        QDataStream ds(&payload, QIODevice::WriteOnly);
+        ds.setVersion(StreamVersion);
+        ds << k << downloadedMSecs << quint32(records.size());
+        for (const Record &r : records) {
+            quint8 flags = (r.extra ? 1 : 0) | (r.counterPart ? 2 : 0) | (r.alternate ? 4 : 0);
+            ds << qint8(r.itemTypeId) << r.itemId << quint32(r.colorId) << qint32(r.quantity)
+               << flags << quint32(r.matchId);
+        }
+    }
+
+    uchar header[RecordHeaderSize];
+    qToLittleEndian<quint32>(quint32(payload.size()), header);
+    qToLittleEndian<quint16>(qChecksum(payload), header + 4);
+
+    const qint64 offset = m_file.size();
+    if (!m_file.seek(offset)
+            || (m_file.write(reinterpret_cast<const char *>(header), RecordHeaderSize) != RecordHeaderSize)
+            || (m_file.write(payload) != payload.size())) {
+        throw Exception(&m_file, "could not write to the inventory store");
+    }
+
+    auto it = m_index.find(k);
+    if (it != m_index.end())
+        m_liveBytes -= (RecordHeaderSize + it->size);
+    m_index.insert(k, { offset + RecordHeaderSize, qint32(payload.size()), downloadedMSecs });
+    m_liveBytes += (RecordHeaderSize + payload.size());
+}
+
+QVector<InventoryStore::Record> InventoryStore::parseXml(const QByteArray &xml)
+{
+    QVector<Record> records;
+
+    auto *buffer = new QBuffer;
+    buffer->setData(xml);
+    buffer->open(QIODevice::ReadOnly);
+
+    XmlHelpers::ParseXML p(buffer, "INVENTORY", "ITEM");
+    p.parse([&p, &records](const XmlHelpers::ParseXML::Element &e) {
+        Record r;
+        r.itemTypeId = ItemType::idFromFirstCharInString(p.elementText(e, "ITEMTYPE"));
+        r.itemId = p.elementText(e, "ITEMID").toLatin1();
+        r.colorId = p.elementText(e, "COLOR").toUInt();
+        r.quantity = p.elementText(e, "QTY").toInt();
+        r.extra = (p.elementText(e, "EXTRA") == u"Y");
+        r.counterPart = (p.elementText(e, "COUNTERPART") == u"Y");
+        r.alternate = (p.elementText(e, "ALTERNATE") == u"Y");
+        r.matchId = p.elementText(e, "MATCHID").toUInt();
+        records.append(r);
+    });
+    return records;
+}
+
+} // namespace BrickLink
@@ -0,0 +1,67 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include "global.h"
+
+
+namespace BrickLink {
+
+// An append-only, indexed store for the pre-parsed inventories downloaded during a database
+// rebuild: a single file instead of one inventory.xml per item. Re-inserting an item appends a
+// new record that shadows the old one; the dead records are dropped by compact().
+
+class InventoryStore
+{
+public:
+    struct Record
+    {
+        char itemTypeId = 0;
+        QByteArray itemId;
+        uint colorId = 0;
+        int quantity = 0;
+        bool extra = false;
+        bool counterPart = false;
+        bool alternate = false;
+        uint matchId = 0;
+    };
+
+    explicit InventoryStore(const QString &fileName);
+    ~InventoryStore();
+
+    void open();
+    void compact(); // also flushes the store
+
+    QDateTime lastDownload(const Item *item) const;
+    QVector<Record> inventory(const Item *item);
+    void insert(const Item *item, const QDateTime &downloaded, const QVector<Record> &records);
+
+    static QVector<Record> parseXml(const QByteArray &xml);
+
+private:
+    struct Entry
+    {
+        qint64 offset;   // of the record payload
+        qint32 size;
+        qint64 downloaded; // msecs since epoch
+    };
+
+    static QByteArray key(const Item *item);
+
+    QString m_fileName;
+    QFile m_file;
+    QHash<QByteArray, Entry> m_index;
+    qint64 m_liveBytes = 0;
+
+    Q_DISABLE_COPY(InventoryStore)
+};
+
+} // namespace BrickLink
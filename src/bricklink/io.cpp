@@ -1,13 +1,19 @@
 // Copyright (C) 2004-2023 Robert Griebl
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include <QtCore/QBuffer>
 #include <QtCore/QXmlStreamReader>
-#include <QtCore/QXmlStreamWriter>
 #include <QtCore/QTimeZone>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include "utility/utility.h"
 #include "utility/exception.h"
+#include "utility/xmlhelpers.h"
 #include "bricklink/core.h"
 #include "bricklink/io.h"
 
@@ -54,76 +60,176 @@ static QString unescapeLtGt(const QString &str, bool enabled = true)
 }
 
 
+namespace {
+
+// Streams <INVENTORY> documents as UTF-8. Every ITEM is collected in a small buffer first, so
+// that a new chunk can be started before an ITEM would push the current one over the size limit.
+class InventoryXmlStream
+{
+public:
+    InventoryXmlStream(QIODevice *out, qint64 maxChunkSize, const BrickLink::IO::NextChunk &nextChunk)
+        : m_maxChunkSize(nextChunk ? maxChunkSize : 0)
+        , m_nextChunk(nextChunk)
+    {
+        m_writer.emplace(out);
+    }
+
+    void beginItem()                                     { m_item = "<ITEM>"; }
+    void text(const char *tag, const char *value)        { textUtf8(tag, value); }
+    void text(const char *tag, const QByteArray &value)  { textUtf8(tag, value); }
+    void text(const char *tag, const QString &value)     { textUtf8(tag, value.toUtf8()); }
+    void number(const char *tag, qint64 n)               { textUtf8(tag, QByteArray::number(n)); }
+    void price(const char *tag, double d, int precision = 3)
+    {
+        textUtf8(tag, QByteArray::number(Utility::fixFinite(d), 'f', precision));
+    }
+    void empty(const char *tag)
+    {
+        m_item.append('<').append(tag).append("/>");
+    }
+
+    void endItem()
+    {
+        static constexpr qint64 EndTagSize = 12; // </INVENTORY>
+
+        m_item.append("</ITEM>");
+        if (m_maxChunkSize && m_itemCount
+                && ((m_chunkSize + m_item.size() + EndTagSize) > m_maxChunkSize)) {
+            m_writer->raw("</INVENTORY>");
+            m_failed = !m_writer->finish() || m_failed;
+
+            QIODevice *next = m_nextChunk(++m_chunkIndex);
+            if (!next) {
+                m_failed = true;
+                m_maxChunkSize = 0; // just continue with the current device
+            } else {
+                m_writer.emplace(next);
+                m_itemCount = 0;
+            }
+        }
+        if (!m_itemCount) {
+            m_writer->raw("<INVENTORY>");
+            m_chunkSize = 11;
+        }
+        m_writer->raw(m_item);
+        m_chunkSize += m_item.size();
+        ++m_itemCount;
+    }
+
+    bool finish()
+    {
+        // the same as QXmlStreamWriter's output for an empty document
+        if (m_itemCount)
+            m_writer->raw("</INVENTORY>");
+        else
+            m_writer->raw("<INVENTORY/>");
+        return m_writer->finish() && !m_failed;
+    }
+
+private:
+    void textUtf8(const char *tag, QByteArrayView utf8)
+    {
+        m_item.append('<').append(tag).append('>');
+        XmlHelpers::Utf8Writer::escape(m_item, utf8, false);
+        m_item.append("</").append(tag).append('>');
+    }
+
+    qint64 m_maxChunkSize;
+    BrickLink::IO::NextChunk m_nextChunk;
+    std::optional<XmlHelpers::Utf8Writer> m_writer;
+    QByteArray m_item;
+    qint64 m_chunkSize = 0;
+    int m_chunkIndex = 0;
+    int m_itemCount = 0;
+    bool m_failed = false;
+};
+
+QString toString(const std::function<void(QIODevice *)> &write)
+{
+    QByteArray utf8;
+    QBuffer buffer(&utf8);
+    buffer.open(QIODevice::WriteOnly);
+    write(&buffer);
+    buffer.close();
+    return QString::fromUtf8(utf8);
+}
+
+} // namespace
+
+
 namespace BrickLink {
 
 QString IO::toBrickLinkXML(const LotList &lots)
+{
+    return toString([&](QIODevice *out) { writeBrickLinkXML(out, lots); });
+}
+
+bool IO::writeBrickLinkXML(QIODevice *out, const LotList &lots, qint64 maxChunkSize,
+                           const NextChunk &nextChunk)
 {
     bool doubleEscapedComments = core()->isApiQuirkEnabled(ApiQuirk::InventoryCommentsAreDoubleEscaped);
     bool doubleEscapedRemarks = core()->isApiQuirkEnabled(ApiQuirk::InventoryRemarksAreDoubleEscaped);
 
-    QString out;
-    QXmlStreamWriter xml(&out);
-    xml.writeStartElement(u"INVENTORY"_qs);
+    InventoryXmlStream xml(out, maxChunkSize, nextChunk);
 
     for (const Lot *lot : lots) {
         if (lot->isIncomplete() || (lot->status() == Status::Exclude))
             continue;
 
-        xml.writeStartElement(u"ITEM"_qs);
-        xml.writeTextElement(u"ITEMID"_qs, QString::fromLatin1(lot->itemId()));
-        xml.writeTextElement(u"ITEMTYPE"_qs, QString(QChar::fromLatin1(lot->itemTypeId())));
-        xml.writeTextElement(u"COLOR"_qs, QString::number(lot->colorId()));
-        xml.writeTextElement(u"CATEGORY"_qs, QString::number(lot->categoryId()));
-        xml.writeTextElement(u"QTY"_qs, QString::number(lot->quantity()));
-        xml.writeTextElement(u"PRICE"_qs, QString::number(Utility::fixFinite(lot->price()), 'f', 3));
-        xml.writeTextElement(u"CONDITION"_qs, (lot->condition() == Condition::New) ? u"N"_qs : u"U"_qs);
-
-        if (lot->bulkQuantity() != 1)   xml.writeTextElement(u"BULK"_qs, QString::number(lot->bulkQuantity()));
-        if (lot->sale())                xml.writeTextElement(u"SALE"_qs, QString::number(lot->sale()));
-        if (!lot->comments().isEmpty()) xml.writeTextElement(u"DESCRIPTION"_qs, doubleEscapedComments ? escapeLtGt(lot->comments()) : lot->comments());
-        if (!lot->remarks().isEmpty())  xml.writeTextElement(u"REMARKS"_qs, doubleEscapedRemarks ? escapeLtGt(lot->remarks()) : lot->remarks());
-        if (lot->retain())              xml.writeTextElement(u"RETAIN"_qs, u"Y"_qs);
-        if (!lot->reserved().isEmpty()) xml.writeTextElement(u"BUYERUSERNAME"_qs, lot->reserved());
-        if (!qFuzzyIsNull(lot->cost())) xml.writeTextElement(u"MYCOST"_qs, QString::number(Utility::fixFinite(lot->cost()), 'f', 3));
-        if (lot->hasCustomWeight())     xml.writeTextElement(u"MYWEIGHT"_qs, QString::number(Utility::fixFinite(lot->weight()), 'f', 4));
+        xml.beginItem();
+        xml.text("ITEMID", lot->itemId());
+        xml.text("ITEMTYPE", QByteArray(1, lot->itemTypeId()));
+        xml.number("COLOR", lot->colorId());
+        xml.number("CATEGORY", lot->categoryId());
+        xml.number("QTY", lot->quantity());
+        xml.price("PRICE", lot->price());
+        xml.text("CONDITION", (lot->condition() == Condition::New) ? "N" : "U");
+
+        if (lot->bulkQuantity() != 1)   xml.number("BULK", lot->bulkQuantity());
+        if (lot->sale())                xml.number("SALE", lot->sale());
+        if (!lot->comments().isEmpty()) xml.text("DESCRIPTION", escapeLtGt(lot->comments(), doubleEscapedComments));
+        if (!lot->remarks().isEmpty())  xml.text("REMARKS", escapeLtGt(lot->remarks(), doubleEscapedRemarks));
+        if (lot->retain())              xml.text("RETAIN", "Y");
+        if (!lot->reserved().isEmpty()) xml.text("BUYERUSERNAME", lot->reserved());
+        if (!qFuzzyIsNull(lot->cost())) xml.price("MYCOST", lot->cost());
+        if (lot->hasCustomWeight())     xml.price("MYWEIGHT", lot->weight(), 4);
 
         if (lot->tierQuantity(0)) {
-            xml.writeTextElement(u"TQ1"_qs, QString::number(lot->tierQuantity(0)));
-            xml.writeTextElement(u"TP1"_qs, QString::number(Utility::fixFinite(lot->tierPrice(0)), 'f', 3));
-            xml.writeTextElement(u"TQ2"_qs, QString::number(lot->tierQuantity(1)));
-            xml.writeTextElement(u"TP2"_qs, QString::number(Utility::fixFinite(lot->tierPrice(1)), 'f', 3));
-            xml.writeTextElement(u"TQ3"_qs, QString::number(lot->tierQuantity(2)));
-            xml.writeTextElement(u"TP3"_qs, QString::number(Utility::fixFinite(lot->tierPrice(2)), 'f', 3));
+            xml.number("TQ1", lot->tierQuantity(0));
+            xml.price("TP1", lot->tierPrice(0));
+            xml.number("TQ2", lot->tierQuantity(1));
+            xml.price("TP2", lot->tierPrice(1));
+            xml.number("TQ3", lot->tierQuantity(2));
+            xml.price("TP3", lot->tierPrice(2));
         }
 
         if (lot->subCondition() != SubCondition::None) {
-            QChar sc;
+            const char *sc = nullptr;
             switch (lot->subCondition()) {
-            case SubCondition::Incomplete: sc = u'I'; break;
-            case SubCondition::Complete  : sc = u'C'; break;
-            case SubCondition::Sealed    : sc = u'S'; break;
+            case SubCondition::Incomplete: sc = "I"; break;
+            case SubCondition::Complete  : sc = "C"; break;
+            case SubCondition::Sealed    : sc = "S"; break;
             default                      : break;
             }
-            if (!sc.isNull())
-                xml.writeTextElement(u"SUBCONDITION"_qs, QString(sc));
+            if (sc)
+                xml.text("SUBCONDITION", sc);
         }
         if (lot->stockroom() != Stockroom::None) {
-            QChar sr;
+            const char *sr = nullptr;
             switch (lot->stockroom()) {
-            case Stockroom::A: sr = u'A'; break;
-            case Stockroom::B: sr = u'B'; break;
-            case Stockroom::C: sr = u'C'; break;
+            case Stockroom::A: sr = "A"; break;
+            case Stockroom::B: sr = "B"; break;
+            case Stockroom::C: sr = "C"; break;
             default          : break;
             }
-            if (!sr.isNull()) {
-                xml.writeTextElement(u"STOCKROOM"_qs, u"Y"_qs);
-                xml.writeTextElement(u"STOCKROOMID"_qs, QString(sr));
+            if (sr) {
+                xml.text("STOCKROOM", "Y");
+                xml.text("STOCKROOMID", sr);
             }
         }
-        xml.writeEndElement();
+        xml.endItem();
     }
-    xml.writeEndElement();
-    return out;
+    return xml.finish();
 }
 
 
@@ -138,7 +244,6 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
     const bool qtyHasComma = (hint == Hint::Order) && core()->isApiQuirkEnabled(ApiQuirk::OrderQtyHasComma);
 
     ParseResult pr;
-    QXmlStreamReader xml(data);
     QString rootName = u"INVENTORY"_qs;
     if (hint == Hint::Order)
         rootName = u"ORDER"_qs;
@@ -187,13 +292,6 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
                           v == u"B" ? Stockroom::B :
                           v == u"C" ? Stockroom::C
                                     : Stockroom::None); } },
-    { u"BASECURRENCYCODE", [&pr](auto *, auto &v) {
-        if (!v.isEmpty()) {
-            if (pr.currencyCode().isEmpty())
-                pr.setCurrencyCode(v);
-            else if (pr.currencyCode() != v)
-                throw Exception("Multiple currencies in one XML file are not supported.");
-        } } },
     };
     if (hint == Hint::Order) {
         itemTagHash.insert(u"ORDERBATCH", [](auto *lot, auto &v) { lot->setMarkerText(v); });
@@ -213,6 +311,73 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
         });
     }
 
+    struct ParsedItem
+    {
+        std::unique_ptr<Lot> lot;
+        QString currencyCode;
+        Core::ResolveResult result = Core::ResolveResult::Direct;
+    };
+    struct Batch
+    {
+        QByteArray xml; // only set, if the batch was split off by XmlHelpers::splitRecords()
+        std::vector<ParsedItem> items;
+    };
+
+    // expects the reader to be positioned on an ITEM start element
+    auto parseItem = [&itemTagHash](QXmlStreamReader &xml) {
+        ParsedItem item;
+        item.lot.reset(new Lot());
+        auto inc = new Incomplete;
+        inc->m_color_id = 0;
+        inc->m_category_id = 0;
+        item.lot->setIncomplete(inc);
+
+        while (xml.readNextStartElement()) {
+            if (xml.name() == u"BASECURRENCYCODE") {
+                item.currencyCode = xml.readElementText();
+            } else if (auto it = itemTagHash.constFind(xml.name()); it != itemTagHash.cend()) {
+                (*it)(item.lot.get(), xml.readElementText());
+            } else {
+                xml.skipCurrentElement();
+            }
+        }
+        return item;
+    };
+
+    // The ITEM records are cut out of the document and parsed in parallel batches, while the
+    // remaining skeleton is parsed sequentially. Documents that do not follow the standard layout
+    // (or have XML errors in their ITEMs) are parsed sequentially as a whole.
+    static constexpr qsizetype BatchSize = 500;
+    std::vector<Batch> batches;
+
+    auto split = XmlHelpers::splitRecords(data, rootName.toLatin1().constData(), "ITEM", BatchSize);
+    if (split) {
+        batches.resize(size_t(split->batches.size()));
+        for (size_t i = 0; i < batches.size(); ++i)
+            batches[i].xml = split->batches.at(qsizetype(i));
+
+        std::atomic<bool> failed = false;
+        QtConcurrent::blockingMap(batches, [&failed, &parseItem](Batch &batch) {
+            QXmlStreamReader xml(batch.xml);
+            if (xml.readNextStartElement()) {
+                batch.items.reserve(BatchSize);
+                while (xml.readNextStartElement())
+                    batch.items.push_back(parseItem(xml));
+            }
+            if (xml.hasError())
+                failed = true;
+            batch.xml.clear();
+        });
+
+        if (failed) {
+            batches.clear();
+            split.reset();
+        }
+    }
+
+    const QByteArray &parsedData = split ? split->skeleton : data;
+    QXmlStreamReader xml(parsedData);
+
     try {
         bool foundRoot = false;
 
@@ -225,27 +390,9 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
                         throw Exception("Expected %1 as root element, but got: %2").arg(rootName).arg(tagName);
                     foundRoot = true;
                 } else if (tagName == u"ITEM") {
-                    auto *lot = new Lot();
-                    auto inc = new Incomplete;
-                    inc->m_color_id = 0;
-                    inc->m_category_id = 0;
-                    lot->setIncomplete(inc);
-
-                    while (xml.readNextStartElement()) {
-                        auto it = itemTagHash.find(xml.name());
-                        if (it != itemTagHash.end())
-                            (*it)(lot, xml.readElementText());
-                        else
-                            xml.skipCurrentElement();
-                    }
-
-                    switch (core()->resolveIncomplete(lot, 0, creationTime)) {
-                    case Core::ResolveResult::Fail: pr.incInvalidLotCount(); break;
-                    case Core::ResolveResult::ChangeLog: pr.incFixedLotCount(); break;
-                    default: break;
-                    }
-
-                    pr.addLot(std::move(lot));
+                    if (batches.empty() || (qsizetype(batches.back().items.size()) == BatchSize))
+                        batches.emplace_back();
+                    batches.back().items.push_back(parseItem(xml));
                 } else {
                     auto it = rootTagHash.find(xml.name());
                     if (it != rootTagHash.end())
@@ -262,6 +409,28 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
                 if (!foundRoot)
                     throw Exception("Not a valid BrickLink XML file");
 
+                QtConcurrent::blockingMap(batches, [&creationTime](Batch &batch) {
+                    for (auto &item : batch.items)
+                        item.result = core()->resolveIncomplete(item.lot.get(), 0, creationTime);
+                });
+
+                for (auto &batch : batches) {
+                    for (auto &item : batch.items) {
+                        if (!item.currencyCode.isEmpty()) {
+                            if (pr.currencyCode().isEmpty())
+                                pr.setCurrencyCode(item.currencyCode);
+                            else if (pr.currencyCode() != item.currencyCode)
+                                throw Exception("Multiple currencies in one XML file are not supported.");
+                        }
+                        switch (item.result) {
+                        case Core::ResolveResult::Fail: pr.incInvalidLotCount(); break;
+                        case Core::ResolveResult::ChangeLog: pr.incFixedLotCount(); break;
+                        default: break;
+                        }
+                        pr.addLot(item.lot.release());
+                    }
+                }
+
                 if (pr.currencyCode().isEmpty())
                     pr.setCurrencyCode(u"USD"_qs);
 
@@ -273,7 +442,7 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
         }
     } catch (const Exception &e) {
         qsizetype pos = xml.characterOffset();
-        QString context = QString::fromUtf8(data);
+        QString context = QString::fromUtf8(parsedData);
         auto lpos = context.lastIndexOf(u'\n', pos ? pos - 1 : 0) + 1;
         auto rpos = context.indexOf(u'\n', pos);
         context = context.mid(lpos, rpos == -1 ? context.size() : rpos - lpos);
@@ -297,69 +466,80 @@ IO::ParseResult IO::fromBrickLinkXML(const QByteArray &data, Hint hint, const QD
 
 QString IO::toWantedListXML(const LotList &lots, const QString &wantedList)
 {
-    QString out;
-    QXmlStreamWriter xml(&out);
-    xml.writeStartElement(u"INVENTORY"_qs);
+    return toString([&](QIODevice *out) { writeWantedListXML(out, lots, wantedList); });
+}
+
+bool IO::writeWantedListXML(QIODevice *out, const LotList &lots, const QString &wantedList,
+                            qint64 maxChunkSize, const NextChunk &nextChunk)
+{
+    InventoryXmlStream xml(out, maxChunkSize, nextChunk);
 
     for (const Lot *lot : lots) {
         if (lot->isIncomplete() || (lot->status() == Status::Exclude))
             continue;
 
-        xml.writeStartElement(u"ITEM"_qs);
-        xml.writeTextElement(u"ITEMID"_qs, QString::fromLatin1(lot->itemId()));
-        xml.writeTextElement(u"ITEMTYPE"_qs, QString(QChar::fromLatin1(lot->itemTypeId())));
-        xml.writeTextElement(u"COLOR"_qs, QString::number(lot->colorId()));
+        xml.beginItem();
+        xml.text("ITEMID", lot->itemId());
+        xml.text("ITEMTYPE", QByteArray(1, lot->itemTypeId()));
+        xml.number("COLOR", lot->colorId());
 
         if (lot->quantity())
-            xml.writeTextElement(u"MINQTY"_qs, QString::number(lot->quantity()));
+            xml.number("MINQTY", lot->quantity());
         if (!qFuzzyIsNull(lot->price()))
-            xml.writeTextElement(u"MAXPRICE"_qs, QString::number(Utility::fixFinite(lot->price()), 'f', 3));
+            xml.price("MAXPRICE", lot->price());
         if (!lot->remarks().isEmpty())
-            xml.writeTextElement(u"REMARKS"_qs, escapeLtGt(lot->remarks()));
+            xml.text("REMARKS", escapeLtGt(lot->remarks()));
         if (lot->condition() == Condition::New)
-            xml.writeTextElement(u"CONDITION"_qs, u"N"_qs);
+            xml.text("CONDITION", "N");
         if (!wantedList.isEmpty())
-            xml.writeTextElement(u"WANTEDLISTID"_qs, wantedList);
+            xml.text("WANTEDLISTID", wantedList);
 
-        xml.writeEndElement();
+        xml.endItem();
     }
-    xml.writeEndElement();
-    return out;
+    return xml.finish();
 }
 
 QString IO::toInventoryRequest(const LotList &lots)
 {
-    QString out;
-    QXmlStreamWriter xml(&out);
-    xml.writeStartElement(u"INVENTORY"_qs);
+    return toString([&](QIODevice *out) { writeInventoryRequest(out, lots); });
+}
+
+bool IO::writeInventoryRequest(QIODevice *out, const LotList &lots, qint64 maxChunkSize,
+                               const NextChunk &nextChunk)
+{
+    InventoryXmlStream xml(out, maxChunkSize, nextChunk);
 
     for (const Lot *lot : lots) {
         if (lot->isIncomplete() || (lot->status() == Status::Exclude))
             continue;
 
-        xml.writeStartElement(u"ITEM"_qs);
-        xml.writeTextElement(u"ITEMID"_qs, QString::fromLatin1(lot->itemId()));
-        xml.writeTextElement(u"ITEMTYPE"_qs, QString(QChar::fromLatin1(lot->itemTypeId())));
-        xml.writeTextElement(u"COLOR"_qs, QString::number(lot->colorId()));
-        xml.writeTextElement(u"QTY"_qs, QString::number(lot->quantity()));
+        xml.beginItem();
+        xml.text("ITEMID", lot->itemId());
+        xml.text("ITEMTYPE", QByteArray(1, lot->itemTypeId()));
+        xml.number("COLOR", lot->colorId());
+        xml.number("QTY", lot->quantity());
         if (lot->status() == Status::Extra)
-            xml.writeTextElement(u"EXTRA"_qs, u"Y"_qs);
+            xml.text("EXTRA", "Y");
 
-        xml.writeEndElement();
+        xml.endItem();
     }
-    xml.writeEndElement();
-    return out;
+    return xml.finish();
 }
 
 QString IO::toBrickLinkUpdateXML(const LotList &lots,
                                  const std::function<const Lot *(const Lot *)> &differenceBaseLot)
+{
+    return toString([&](QIODevice *out) { writeBrickLinkUpdateXML(out, lots, differenceBaseLot); });
+}
+
+bool IO::writeBrickLinkUpdateXML(QIODevice *out, const LotList &lots,
+                                 const std::function<const Lot *(const Lot *)> &differenceBaseLot,
+                                 qint64 maxChunkSize, const NextChunk &nextChunk)
 {
     bool doubleEscapedComments = core()->isApiQuirkEnabled(ApiQuirk::InventoryCommentsAreDoubleEscaped);
     bool doubleEscapedRemarks = core()->isApiQuirkEnabled(ApiQuirk::InventoryRemarksAreDoubleEscaped);
 
-    QString out;
-    QXmlStreamWriter xml(&out);
-    xml.writeStartElement(u"INVENTORY"_qs);
+    InventoryXmlStream xml(out, maxChunkSize, nextChunk);
 
     for (const Lot *lot : lots) {
         if (lot->isIncomplete() || (lot->status() == Status::Exclude))
@@ -379,30 +559,30 @@ QString IO::toBrickLinkUpdateXML(const LotList &lots,
         if (baseLot == *lot)
             continue;
 
-        xml.writeStartElement(u"ITEM"_qs);
-        xml.writeTextElement(u"LOTID"_qs, QString::number(lot->lotId()));
+        xml.beginItem();
+        xml.number("LOTID", lot->lotId());
         int qdiff = lot->quantity() - base->quantity();
         if (qdiff && (lot->quantity() > 0))
-            xml.writeTextElement(u"QTY"_qs, QString::number(qdiff).prepend(qdiff > 0 ? u"+"_qs : u""_qs));
+            xml.text("QTY", QByteArray::number(qdiff).prepend(qdiff > 0 ? "+" : ""));
         else if (qdiff && (lot->quantity() <= 0))
-            xml.writeEmptyElement(u"DELETE"_qs);
+            xml.empty("DELETE");
 
         if (!qFuzzyCompare(base->price(), lot->price()))
-            xml.writeTextElement(u"PRICE"_qs, QString::number(Utility::fixFinite(lot->price()), 'f', 3));
+            xml.price("PRICE", lot->price());
         if (!qFuzzyCompare(base->cost(), lot->cost()))
-            xml.writeTextElement(u"MYCOST"_qs, QString::number(Utility::fixFinite(lot->cost()), 'f', 3));
+            xml.price("MYCOST", lot->cost());
         if (base->condition() != lot->condition())
-            xml.writeTextElement(u"CONDITION"_qs, (lot->condition() == Condition::New) ? u"N"_qs : u"U"_qs);
+            xml.text("CONDITION", (lot->condition() == Condition::New) ? "N" : "U");
         if (base->bulkQuantity() != lot->bulkQuantity())
-            xml.writeTextElement(u"BULK"_qs, QString::number(lot->bulkQuantity()));
+            xml.number("BULK", lot->bulkQuantity());
         if (base->sale() != lot->sale())
-            xml.writeTextElement(u"SALE"_qs, QString::number(lot->sale()));
+            xml.number("SALE", lot->sale());
         if (base->comments() != lot->comments())
-            xml.writeTextElement(u"DESCRIPTION"_qs, doubleEscapedComments ? escapeLtGt(lot->comments()) : lot->comments());
+            xml.text("DESCRIPTION", escapeLtGt(lot->comments(), doubleEscapedComments));
         if (base->remarks() != lot->remarks())
-            xml.writeTextElement(u"REMARKS"_qs, doubleEscapedRemarks ? escapeLtGt(lot->remarks()) : lot->remarks());
+            xml.text("REMARKS", escapeLtGt(lot->remarks(), doubleEscapedRemarks));
         if (base->retain() != lot->retain())
-            xml.writeTextElement(u"RETAIN"_qs, lot->retain() ? u"Y"_qs : u"N"_qs);
+            xml.text("RETAIN", lot->retain() ? "Y" : "N");
 
         if ((base->tierQuantity(0) != lot->tierQuantity(0))
             || !qFuzzyCompare(base->tierPrice(0), lot->tierPrice(0))
@@ -410,45 +590,44 @@ QString IO::toBrickLinkUpdateXML(const LotList &lots,
             || !qFuzzyCompare(base->tierPrice(1), lot->tierPrice(1))
             || (base->tierQuantity(2) != lot->tierQuantity(2))
             || !qFuzzyCompare(base->tierPrice(2), lot->tierPrice(2))) {
-            xml.writeTextElement(u"TQ1"_qs, QString::number(lot->tierQuantity(0)));
-            xml.writeTextElement(u"TP1"_qs, QString::number(Utility::fixFinite(lot->tierPrice(0)), 'f', 3));
-            xml.writeTextElement(u"TQ2"_qs, QString::number(lot->tierQuantity(1)));
-            xml.writeTextElement(u"TP2"_qs, QString::number(Utility::fixFinite(lot->tierPrice(1)), 'f', 3));
-            xml.writeTextElement(u"TQ3"_qs, QString::number(lot->tierQuantity(2)));
-            xml.writeTextElement(u"TP3"_qs, QString::number(Utility::fixFinite(lot->tierPrice(2)), 'f', 3));
+            xml.number("TQ1", lot->tierQuantity(0));
+            xml.price("TP1", lot->tierPrice(0));
+            xml.number("TQ2", lot->tierQuantity(1));
+            xml.price("TP2", lot->tierPrice(1));
+            xml.number("TQ3", lot->tierQuantity(2));
+            xml.price("TP3", lot->tierPrice(2));
         }
 
         if (base->subCondition() != lot->subCondition()) {
-            QChar sc;
+            const char *sc = nullptr;
             switch (lot->subCondition()) {
-            case SubCondition::Incomplete: sc = u'I'; break;
-            case SubCondition::Complete  : sc = u'C'; break;
-            case SubCondition::Sealed    : sc = u'S'; break;
+            case SubCondition::Incomplete: sc = "I"; break;
+            case SubCondition::Complete  : sc = "C"; break;
+            case SubCondition::Sealed    : sc = "S"; break;
             default                      : break;
             }
-            if (!sc.isNull())
-                xml.writeTextElement(u"SUBCONDITION"_qs, QString(sc));
+            if (sc)
+                xml.text("SUBCONDITION", sc);
         }
         if (base->stockroom() != lot->stockroom()) {
-            QChar sr;
+            const char *sr = nullptr;
             switch (lot->stockroom()) {
-            case Stockroom::A: sr = u'A'; break;
-            case Stockroom::B: sr = u'B'; break;
-            case Stockroom::C: sr = u'C'; break;
+            case Stockroom::A: sr = "A"; break;
+            case Stockroom::B: sr = "B"; break;
+            case Stockroom::C: sr = "C"; break;
             default          : break;
             }
-            xml.writeTextElement(u"STOCKROOM"_qs, !sr.isNull() ? u"Y"_qs : u"N"_qs);
-            if (!sr.isNull())
-                xml.writeTextElement(u"STOCKROOMID"_qs, QString(sr));
+            xml.text("STOCKROOM", sr ? "Y" : "N");
+            if (sr)
+                xml.text("STOCKROOMID", sr);
         }
 
         // Ignore the weight - it's just too confusing:
         // BrickStore displays the total weight, but that is dependent on the quantity.
         // On the other hand, the update would be done on the item weight.
-        xml.writeEndElement();
+        xml.endItem();
     }
-    xml.writeEndElement();
-    return out;
+    return xml.finish();
 }
 
 IO::ParseResult::ParseResult(const LotList &lots)
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <QtCore/QString>
 #include <QtCore/QHash>
 #include <QtXml/QDomElement>
@@ -10,6 +12,8 @@
 #include "bricklink/global.h"
 #include "bricklink/lot.h"
 
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+
 namespace BrickLink::IO {
 
 class ParseResult
@@ -48,10 +52,24 @@ private:
     QHash<const Lot *, Lot> m_differenceModeBase;
 };
 
+// The write...() exporters stream UTF-8 directly into a QIODevice with bounded memory. If
+// maxChunkSize is > 0, the output is split into complete documents of at most that many bytes
+// (a single ITEM is never split): the first one goes to out, every following one to the device
+// returned by nextChunk(chunkIndex). The to...() variants return everything as a single string.
+
+using NextChunk = std::function<QIODevice *(int chunkIndex)>;
+
 QString toWantedListXML(const LotList &lots, const QString &wantedList);
+bool writeWantedListXML(QIODevice *out, const LotList &lots, const QString &wantedList,
+                        qint64 maxChunkSize = 0, const NextChunk &nextChunk = { });
 QString toInventoryRequest(const LotList &lots);
+bool writeInventoryRequest(QIODevice *out, const LotList &lots,
+                           qint64 maxChunkSize = 0, const NextChunk &nextChunk = { });
 QString toBrickLinkUpdateXML(const LotList &lots,
                              const std::function<const Lot *(const Lot *)> &differenceBaseLot);
+bool writeBrickLinkUpdateXML(QIODevice *out, const LotList &lots,
+                             const std::function<const Lot *(const Lot *)> &differenceBaseLot,
+                             qint64 maxChunkSize = 0, const NextChunk &nextChunk = { });
 
 enum class Hint {
     Plain = 0x01,
@@ -63,6 +81,8 @@ enum class Hint {
 };
 
 QString toBrickLinkXML(const LotList &lots);
+bool writeBrickLinkXML(QIODevice *out, const LotList &lots,
+                       qint64 maxChunkSize = 0, const NextChunk &nextChunk = { });
 ParseResult fromBrickLinkXML(const QByteArray &xml, Hint hint, const QDateTime &creationTime = { });
 
 ParseResult fromPartInventory(const Item *item, const Color *color = nullptr, int quantity = 1,
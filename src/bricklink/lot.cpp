@@ -40,9 +40,6 @@ Lot &Lot::operator=(const Lot &copy)
     m_alt_id              = copy.m_alt_id;
     m_cpart               = copy.m_cpart;
     m_lot_id              = copy.m_lot_id;
-    m_reserved            = copy.m_reserved;
-    m_comments            = copy.m_comments;
-    m_remarks             = copy.m_remarks;
     m_quantity            = copy.m_quantity;
     m_bulk_quantity       = copy.m_bulk_quantity;
     m_tier_quantity[0]    = copy.m_tier_quantity[0];
@@ -55,10 +52,7 @@ Lot &Lot::operator=(const Lot &copy)
     m_tier_price[1]       = copy.m_tier_price[1];
     m_tier_price[2]       = copy.m_tier_price[2];
     m_weight              = copy.m_weight;
-    m_markerText          = copy.m_markerText;
-    m_markerColor         = copy.m_markerColor;
-    m_dateAdded           = copy.m_dateAdded;
-    m_dateLastSold        = copy.m_dateLastSold;
+    m_extra               = copy.m_extra;
 
     return *this;
 }
@@ -90,9 +84,6 @@ bool Lot::operator==(const Lot &cmp) const
             && (m_retain           == cmp.m_retain)
             && (m_stockroom        == cmp.m_stockroom)
             && (m_lot_id           == cmp.m_lot_id)
-            && (m_reserved         == cmp.m_reserved)
-            && (m_comments         == cmp.m_comments)
-            && (m_remarks          == cmp.m_remarks)
             && (m_quantity         == cmp.m_quantity)
             && (m_bulk_quantity    == cmp.m_bulk_quantity)
             && (m_tier_quantity[0] == cmp.m_tier_quantity[0])
@@ -105,10 +96,45 @@ bool Lot::operator==(const Lot &cmp) const
             && qFuzzyCompare(m_tier_price[1], cmp.m_tier_price[1])
             && qFuzzyCompare(m_tier_price[2], cmp.m_tier_price[2])
             && qFuzzyCompare(m_weight,        cmp.m_weight)
-            && (m_markerText       == cmp.m_markerText)
-            && (m_markerColor      == cmp.m_markerColor)
-            && (m_dateAdded        == cmp.m_dateAdded)
-            && (m_dateLastSold     == cmp.m_dateLastSold);
+            && ((m_extra == cmp.m_extra)
+                || ((reserved()    == cmp.reserved())
+                    && (comments()     == cmp.comments())
+                    && (remarks()      == cmp.remarks())
+                    && (markerText()   == cmp.markerText())
+                    && (markerColor()  == cmp.markerColor())
+                    && (dateAdded()    == cmp.dateAdded())
+                    && (dateLastSold() == cmp.dateLastSold())));
+}
+
+void Lot::internStrings(QSet<QString> &pool)
+{
+    if (!m_extra)
+        return;
+
+    auto intern = [&pool](const QString &str) {
+        if (str.isEmpty())
+            return str;
+        auto it = pool.constFind(str);
+        if (it == pool.cend())
+            it = pool.insert(str);
+        return *it;
+    };
+
+    // only detach if at least one of the strings is not pooled yet
+    const Extra *e = m_extra.constData();
+    const QString reserved = intern(e->m_reserved);
+    const QString comments = intern(e->m_comments);
+    const QString remarks = intern(e->m_remarks);
+    const QString markerText = intern(e->m_markerText);
+
+    if (!reserved.isSharedWith(e->m_reserved) || !comments.isSharedWith(e->m_comments)
+            || !remarks.isSharedWith(e->m_remarks) || !markerText.isSharedWith(e->m_markerText)) {
+        Extra *de = m_extra.data();
+        de->m_reserved = reserved;
+        de->m_comments = comments;
+        de->m_remarks = remarks;
+        de->m_markerText = markerText;
+    }
 }
 
 Lot::~Lot()
@@ -121,14 +147,14 @@ void Lot::save(QDataStream &ds) const
        << (itemType() ? itemType()->id() : ItemType::InvalidId)
        << (color() ? color()->id() : Color::InvalidId)
        << qint8(m_status) << qint8(m_condition) << qint8(m_scondition) << qint8(m_retain ? 1 : 0)
-       << qint8(m_stockroom) << m_lot_id << m_reserved << m_comments << m_remarks
+       << qint8(m_stockroom) << m_lot_id << reserved() << comments() << remarks()
        << m_quantity << m_bulk_quantity
        << m_tier_quantity[0] << m_tier_quantity[1] << m_tier_quantity[2]
        << m_sale << m_price << m_cost
        << m_tier_price[0] << m_tier_price[1] << m_tier_price[2]
        << m_weight
-       << m_markerText << m_markerColor
-       << m_dateAdded << m_dateLastSold;
+       << markerText() << markerColor()
+       << dateAdded() << dateLastSold();
 }
 
 Lot *Lot::restore(QDataStream &ds, uint startChangelogAt)
@@ -180,18 +206,29 @@ Lot *Lot::restore(QDataStream &ds, uint startChangelogAt)
     // alternate, cpart and altid are left out on purpose!
 
     qint8 status = 0, cond = 0, scond = 0, retain = 0, stockroom = 0;
+    QString reserved, comments, remarks, markerText;
+    QColor markerColor;
+    QDateTime dateAdded, dateLastSold;
     ds >> status >> cond >> scond >> retain >> stockroom
-        >> lot->m_lot_id >> lot->m_reserved >> lot->m_comments >> lot->m_remarks
+        >> lot->m_lot_id >> reserved >> comments >> remarks
         >> lot->m_quantity >> lot->m_bulk_quantity
         >> lot->m_tier_quantity[0] >> lot->m_tier_quantity[1] >> lot->m_tier_quantity[2]
         >> lot->m_sale >> lot->m_price >> lot->m_cost
         >> lot->m_tier_price[0] >> lot->m_tier_price[1] >> lot->m_tier_price[2]
-        >> lot->m_weight >> lot->m_markerText >> lot->m_markerColor
-        >> lot->m_dateAdded >> lot->m_dateLastSold;
+        >> lot->m_weight >> markerText >> markerColor
+        >> dateAdded >> dateLastSold;
 
     if (ds.status() != QDataStream::Ok)
         return nullptr;
 
+    lot->setReserved(reserved);
+    lot->setComments(comments);
+    lot->setRemarks(remarks);
+    lot->setMarkerText(markerText);
+    lot->setMarkerColor(markerColor);
+    lot->setExtra(&Extra::m_dateAdded, dateAdded);
+    lot->setExtra(&Extra::m_dateLastSold, dateLastSold);
+
     lot->m_status = static_cast<Status>(status);
     lot->m_condition = static_cast<Condition>(cond);
     lot->m_scondition = static_cast<SubCondition>(scond);
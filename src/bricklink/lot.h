@@ -6,6 +6,8 @@
 #include <QtCore/QString>
 #include <QtCore/QVector>
 #include <QtCore/QDateTime>
+#include <QtCore/QSet>
+#include <QtCore/QSharedData>
 #include <QtGui/QColor>
 
 #include "bricklink/global.h"
@@ -65,10 +67,10 @@ public:
     void setCondition(Condition c)     { m_condition = c; }
     SubCondition subCondition() const  { return m_scondition; }
     void setSubCondition(SubCondition c) { m_scondition = c; }
-    QString comments() const           { return m_comments; }
-    void setComments(const QString &n) { m_comments = n; }
-    QString remarks() const            { return m_remarks; }
-    void setRemarks(const QString &r)  { m_remarks = r; }
+    QString comments() const           { return m_extra ? m_extra->m_comments : QString(); }
+    void setComments(const QString &n) { setExtra(&Extra::m_comments, n); }
+    QString remarks() const            { return m_extra ? m_extra->m_remarks : QString(); }
+    void setRemarks(const QString &r)  { setExtra(&Extra::m_remarks, r); }
 
     int quantity() const               { return m_quantity; }
     void setQuantity(int q)            { m_quantity = q; }
@@ -101,8 +103,8 @@ public:
     void setWeight(double w)           { m_weight = (w <= 0) ? 0 : w; }
     void setTotalWeight(double w)      { m_weight = (w <= 0) ? 0 : (w / (m_quantity ? qAbs(m_quantity) : 1)); }
 
-    QString reserved() const           { return m_reserved; }
-    void setReserved(const QString &r) { m_reserved = r; }
+    QString reserved() const           { return m_extra ? m_extra->m_reserved : QString(); }
+    void setReserved(const QString &r) { setExtra(&Extra::m_reserved, r); }
 
     bool alternate() const             { return m_alternate; }
     void setAlternate(bool a)          { m_alternate = a; }
@@ -126,16 +128,19 @@ public:
     void setTierPrice1(double p)       { setTierPrice(1, p); }
     void setTierPrice2(double p)       { setTierPrice(2, p); }
 
-    bool isMarked() const              { return !m_markerText.isEmpty() || m_markerColor.isValid(); }
-    QString markerText() const         { return m_markerText; }
-    QColor markerColor() const         { return m_markerColor; }
-    void setMarkerText(const QString &text)  { m_markerText = text; }
-    void setMarkerColor(const QColor &color) { m_markerColor = color; }
+    bool isMarked() const              { return m_extra && (!m_extra->m_markerText.isEmpty()
+                                                            || m_extra->m_markerColor.isValid()); }
+    QString markerText() const         { return m_extra ? m_extra->m_markerText : QString(); }
+    QColor markerColor() const         { return m_extra ? m_extra->m_markerColor : QColor(); }
+    void setMarkerText(const QString &text)  { setExtra(&Extra::m_markerText, text); }
+    void setMarkerColor(const QColor &color) { setExtra(&Extra::m_markerColor, color); }
 
-    QDateTime dateAdded() const        { return m_dateAdded; }
-    void setDateAdded(const QDateTime &dt)    { m_dateAdded = dt.toUTC(); }
-    QDateTime dateLastSold() const     { return m_dateLastSold; }
-    void setDateLastSold(const QDateTime &dt) { m_dateLastSold = dt.toUTC(); }
+    QDateTime dateAdded() const        { return m_extra ? m_extra->m_dateAdded : QDateTime(); }
+    void setDateAdded(const QDateTime &dt)    { setExtra(&Extra::m_dateAdded, dt.toUTC()); }
+    QDateTime dateLastSold() const     { return m_extra ? m_extra->m_dateLastSold : QDateTime(); }
+    void setDateLastSold(const QDateTime &dt) { setExtra(&Extra::m_dateLastSold, dt.toUTC()); }
+
+    void internStrings(QSet<QString> &pool);
 
     Incomplete *isIncomplete() const    { return m_incomplete.get(); }
     void setIncomplete(Incomplete *inc) { m_incomplete.reset(inc); }
@@ -144,6 +149,31 @@ public:
     static Lot *restore(QDataStream &ds, uint startChangelogAt);
 
 private:
+    // The rarely used fields live in a block that is shared between copies of a lot and only
+    // detached on write: copying a Lot is cheap and most lots don't need the block at all.
+    struct Extra : public QSharedData
+    {
+        QString   m_reserved;
+        QString   m_comments;
+        QString   m_remarks;
+        QString   m_markerText;
+        QColor    m_markerColor;
+        QDateTime m_dateAdded;
+        QDateTime m_dateLastSold;
+    };
+
+    template <typename T> void setExtra(T Extra::*field, const T &value)
+    {
+        if (!m_extra) {
+            if (value == T { })
+                return;
+            m_extra = new Extra;
+        } else if (m_extra.constData()->*field == value) {
+            return; // don't detach
+        }
+        m_extra.data()->*field = value;
+    }
+
     const Item * m_item;
     const Color *m_color;
 
@@ -159,10 +189,6 @@ private:
     int          m_cpart     : 1 = false;
 
     uint    m_lot_id = 0;
-    QString m_reserved;
-
-    QString m_comments;
-    QString m_remarks;
 
     int     m_quantity = 0;
     int     m_bulk_quantity = 1;
@@ -175,11 +201,7 @@ private:
 
     double  m_weight = 0;
 
-    QString m_markerText;
-    QColor  m_markerColor;
-
-    QDateTime m_dateAdded;
-    QDateTime m_dateLastSold;
+    QSharedDataPointer<Extra> m_extra;
 
     friend class Core;
 };
@@ -5,8 +5,7 @@
 #include <QtCore/QStringBuilder>
 #include <QtCore/QThreadStorage>
 #include <QtCore/QRegularExpression>
-#include <QtCore/QBitArray>
-#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtGui/QGuiApplication>
 #include <QtGui/QFontMetrics>
 #include <QtGui/QPixmap>
@@ -14,6 +13,7 @@
 #include <QtGui/QIcon>
 
 #include "utility/utility.h"
+#include "bricklink/canbuild.h"
 #include "bricklink/core.h"
 #include "bricklink/category.h"
 #include "bricklink/item.h"
@@ -905,7 +905,8 @@ InternalInventoryModel::InternalInventoryModel(Mode mode, const QVector<SimpleLo
     switch (mode) {
         case Mode::ConsistsOf:    fillConsistsOf(list); break;
         case Mode::AppearsIn:     fillAppearsIn(list); break;
-        case Mode::CanBuild:      fillCanBuild(list); break;
+        case Mode::CanBuild:
+        case Mode::CanBuildPartially: fillCanBuild(list); break;
         case Mode::Relationships: fillRelationships(list); break;
     }
     connect(core()->pictureCache(), &BrickLink::PictureCache::pictureUpdated,
@@ -1009,86 +1010,26 @@ void InternalInventoryModel::fillAppearsIn(const QVector<SimpleLot> &list)
 
 void InternalInventoryModel::fillCanBuild(const QVector<SimpleLot> &lots)
 {
-    QVector<std::pair<quint32, qint32>> have;
+    CanBuild::Have have;
     have.reserve(lots.size());
     for (const auto &lot : lots) {
         if (!lot.m_item || !lot.m_color || lot.m_quantity <= 0)
             continue;
-
-        // squeeze the data as tightly as possible: this map/reduce is quite CPU intensive and
-        // comparing 32 bits instead of 128 for each check helps a lot (plus is also keeps more
-        // data in the cache, as each entry is only 64 bits instead of 192).
-        have.append({ (quint32(lot.m_color->index()) << 20) | quint32(lot.m_item->index()),
-                     lot.m_quantity });
+        have[CanBuild::key(lot.m_color->index(), lot.m_item->index())] += lot.m_quantity;
     }
 
-    static auto indexCompare = [](const std::pair<quint32, qint32> &a,
-            const std::pair<quint32, qint32> &b) -> bool {
-        return a.first < b.first;
-    };
-
-    // sort by colorindex | itemindex
-    std::sort(have.begin(), have.end(), indexCompare);
-
-    auto map = [=](const Item &set) -> const Item * {
-        bool matched = false;
-        static const QByteArray canBuildIds = "SM";
-
-        if (set.hasInventory() && canBuildIds.contains(set.itemTypeId())) {
-            const auto inv = set.consistsOf();
-
-            // copy the have vector, as we need to modify it for counting down quantities
-            auto checkHave = have;
-
-            QBitArray alternatesMatched;
-
-            for (const auto &co : inv) {
-                if (co.isExtra() || co.isCounterPart())
-                    continue;
-
-                auto alternate = qsizetype(co.alternateId());
-                if (alternate) {
-                    if (alternatesMatched.size() < alternate)
-                        alternatesMatched.resize(alternate);
-                    else if (alternatesMatched.at(alternate - 1))
-                        continue;
-                }
-
-                quint32 index = (co.colorIndex() << 20) | co.itemIndex();
-                auto it = std::lower_bound(checkHave.begin(), checkHave.end(),
-                                           std::make_pair(index, 0), indexCompare);
-                if ((it != checkHave.end()) && (it->first == index)) {
-                    it->second -= co.quantity();
-                    if (it->second >= 0) {
-                        matched = true;
-                        if (alternate)
-                            alternatesMatched.setBit(alternate - 1);
-                        continue;
-                    }
-                }
-                if (!alternate) {
-                    matched = false;
-                    break;
-                }
-            }
-
-            // if we had alternatives, make sure all of them matched up
-            if (matched && !alternatesMatched.isEmpty())
-                matched = (alternatesMatched.count(true) == alternatesMatched.count());
-        }
-        return matched ? &set : nullptr;
-    };
+    const bool partially = (m_mode == Mode::CanBuildPartially);
 
-    const auto &sets = core()->items();
-    QtConcurrent::mapped(sets.cbegin(), sets.cend(), map)
-            .then(this, [this](QFuture<const BrickLink::Item *> future) {
-        if (!m_entries.isEmpty() || (m_mode != Mode::CanBuild))
+    QtConcurrent::run([canBuild = CanBuild::instance(), have, partially]() {
+        return canBuild->query(have, partially ? .8f : 1.f);
+    }).then(this, [this, partially](const QVector<CanBuild::Result> &results) {
+        if (!m_entries.isEmpty())
             return;
 
         beginResetModel();
-        for (const auto *match : std::as_const(future)) {
-            if (match)
-                m_entries.emplace_back(new Entry { match, nullptr, -1 });
+        for (const auto &result : results) {
+            const int percent = partially ? int(result.m_buildable * 100) : -1;
+            m_entries.emplace_back(new Entry { result.m_item, nullptr, percent });
         }
         endResetModel();
     });
@@ -1216,6 +1157,8 @@ QVariant InternalInventoryModel::data(const QModelIndex &index, int role) const
     case Qt::DisplayRole:
         switch (index.column()) {
         case InventoryModel::QuantityColumn:
+            if (m_mode == Mode::CanBuildPartially)
+                return QString(QString::number(e->m_quantity) + u'%');
             return (e->m_quantity < 0) ? u"-"_qs : QString::number(e->m_quantity);
         case InventoryModel::ItemIdColumn:
             return QString(QChar::fromLatin1(e->m_item->itemTypeId()) + u' ' + QString::fromLatin1(e->m_item->id()));
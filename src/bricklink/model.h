@@ -242,7 +242,7 @@ class InventoryModel : public QSortFilterProxyModel
     Q_PROPERTY(bool hasSections READ hasSections CONSTANT FINAL)
 
 public:
-    enum class Mode { AppearsIn, ConsistsOf, CanBuild, Relationships };
+    enum class Mode { AppearsIn, ConsistsOf, CanBuild, Relationships, CanBuildPartially };
 
     struct SimpleLot
     {
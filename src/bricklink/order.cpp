@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <memory>
+#include <algorithm>
 #include <array>
 
 #include <QBuffer>
@@ -644,7 +645,8 @@ Orders::Orders(Core *core)
     });
     connect(core, &Core::authenticatedTransferFinished,
             this, [this](TransferJob *job) {
-        bool jobCompleted = job->isCompleted() && (job->responseCode() == 200) && job->data();
+        bool jobCompleted = job->isCompleted() && (job->responseCode() == 200)
+                && (job->data() || job->file());
         QByteArray type = job->userTag();
 
         if (d->m_addressJobs.contains(job) && (type == "address")) {
@@ -687,7 +689,8 @@ Orders::Orders(Core *core)
                 d->m_db.transaction();
 
                 try {
-                    orders = parseOrdersXML(*job->data());
+                    // the XML was already parsed while it was downloading
+                    orders = static_cast<OrdersXmlParser *>(job->file())->finish();
 
                     for (auto it = orders.cbegin(); it != orders.cend(); ++it) {
                         Order *order = it.key();
@@ -1090,19 +1093,136 @@ void Orders::importOldCache(const QString &userId)
 
 QHash<Order *, QString> Orders::parseOrdersXML(const QByteArray &data_)
 {
-    QString data; // otherwise characterOffset doesn't match
+    OrdersXmlParser parser;
+    parser.addData(data_);
+    return parser.finish();
+}
+
+
+OrdersXmlParser::OrdersXmlParser()
+    : m_fixUnescapedFields(core()->isApiQuirkEnabled(ApiQuirk::OrderXmlHasUnescapedFields))
+{
+    open(QIODevice::WriteOnly);
+}
+
+OrdersXmlParser::~OrdersXmlParser()
+{
+    clear();
+}
+
+void OrdersXmlParser::clear()
+{
+    qDeleteAll(m_orders.keyBegin(), m_orders.keyEnd());
+    m_orders.clear();
+    m_buffer.clear();
+    m_line = 1;
+    m_root = Root::Before;
+    m_error.clear();
+}
+
+bool OrdersXmlParser::seek(qint64 pos)
+{
+    // the transfer rewinds its sink when a job is restarted
+    if (pos == 0)
+        clear();
+    return QIODevice::seek(pos);
+}
+
+qint64 OrdersXmlParser::writeData(const char *data, qint64 len)
+{
+    addData(QByteArrayView(data, len));
+    return len;
+}
+
+void OrdersXmlParser::addData(QByteArrayView data)
+{
+    if (!m_error.isEmpty())
+        return;
+
+    m_buffer.append(data);
+    qsizetype pos = 0;
+
+    try {
+        while (true) {
+            const auto startOfOrder = m_buffer.indexOf("<ORDER>", pos);
+            if (startOfOrder < 0)
+                break;
+            auto endOfOrder = m_buffer.indexOf("</ORDER>", startOfOrder);
+            if (endOfOrder < 0)
+                break;
+            endOfOrder += 8;
+
+            skipOutsideOfOrders(QByteArrayView(m_buffer).sliced(pos, startOfOrder - pos));
+            m_line += int(std::count(m_buffer.cbegin() + pos, m_buffer.cbegin() + startOfOrder, '\n'));
+            parseOrder(m_buffer.mid(startOfOrder, endOfOrder - startOfOrder));
+            m_line += int(std::count(m_buffer.cbegin() + startOfOrder, m_buffer.cbegin() + endOfOrder, '\n'));
+            pos = endOfOrder;
+        }
+        m_buffer.remove(0, pos);
+    } catch (const Exception &e) {
+        clear();
+        m_error = e.errorString();
+    }
+}
 
+QHash<Order *, QString> OrdersXmlParser::finish()
+{
+    if (m_error.isEmpty()) {
+        try {
+            skipOutsideOfOrders(m_buffer);
+            if ((m_root == Root::Inside) || ((m_root == Root::Before) && m_orders.isEmpty()))
+                throw Exception("Premature end of document");
+        } catch (const Exception &e) {
+            clear();
+            m_error = e.errorString();
+        }
+    }
+    if (!m_error.isEmpty())
+        throw Exception(m_error);
+
+    for (auto it = m_orders.keyBegin(); it != m_orders.keyEnd(); ++it)
+        QQmlEngine::setObjectOwnership(*it, QQmlEngine::CppOwnership);
+    m_buffer.clear();
+    return std::exchange(m_orders, { });
+}
+
+void OrdersXmlParser::skipOutsideOfOrders(QByteArrayView data)
+{
+    // only the XML declaration and the ORDERS root tag are allowed in between the ORDER records
+    while (!(data = data.trimmed()).isEmpty()) {
+        if (data.startsWith("<?xml")) {
+            const auto end = data.indexOf("?>");
+            if (end < 0)
+                break;
+            data = data.sliced(end + 2);
+        } else if (data.startsWith("<ORDERS>") && (m_root == Root::Before) && m_orders.isEmpty()) {
+            m_root = Root::Inside;
+            data = data.sliced(8);
+        } else if (data.startsWith("</ORDERS>") && (m_root == Root::Inside)) {
+            m_root = Root::After;
+            data = data.sliced(9);
+        } else {
+            break;
+        }
+    }
+    if (!data.isEmpty()) {
+        throw Exception("XML parse error at line %1: unexpected data outside of an ORDER tag")
+                .arg(m_line);
+    }
+}
+
+void OrdersXmlParser::parseOrder(QByteArray orderXml)
+{
     // BrickLink quirk: a few of the fields can contain unescaped '&' characters
     // we try to fix this by finding all '&' that are not followed by a ';' within 6 characters.
-    if (core()->isApiQuirkEnabled(ApiQuirk::OrderXmlHasUnescapedFields)) {
-        QByteArray fixed(data_);
+    if (m_fixUnescapedFields) {
         qsizetype pos = 0;
         while (pos >= 0) {
-            pos = fixed.indexOf('&', pos);
+            pos = orderXml.indexOf('&', pos);
             if (pos >= 0) {
                 bool doReplace = true;
                 for (qsizetype i = 0; i < 6; ++i) {
-                    const char c = fixed.at(pos + i + 1);
+                    const char c = orderXml.at(pos + i + 1);
                     if (c == ';') {
                         doReplace = false;
                         break;
@@ -1111,94 +1231,77 @@ QHash<Order *, QString> Orders::parseOrdersXML(const QByteArray &data_)
                     }
                 }
                 if (doReplace)
-                    fixed.replace(pos, 1, "&amp;");
+                    orderXml.replace(pos, 1, "&amp;");
                 ++pos;
             }
         }
-        data = QString::fromUtf8(fixed);
-    } else {
-        data = QString::fromUtf8(data_);
     }
+    const QString data = QString::fromUtf8(orderXml);
     QXmlStreamReader xml(data);
 
-    QHash<Order *, QString> result;
-    std::unique_ptr<Order> order;
+    static const auto rootTagHash = []() {
+        QHash<QStringView, std::function<void(Order *, const QString &)>> h;
+
+        h.insert(u"ORDERID",           [](auto *o, auto &v) { o->setId(v); } );
+        h.insert(u"BUYER",             [](auto *o, auto &v) { o->setOtherParty(v); o->setType(OrderType::Received); } );
+        h.insert(u"SELLER",            [](auto *o, auto &v) { o->setOtherParty(v); o->setType(OrderType::Placed); } );
+        h.insert(u"ORDERDATE",         [](auto *o, auto &v) { o->setDate(QDate::fromString(v, u"M/d/yyyy")); } );
+        h.insert(u"ORDERSTATUSCHANGED",[](auto *o, auto &v) { o->setLastUpdated(QDate::fromString(v, u"M/d/yyyy")); } );
+        h.insert(u"ORDERSHIPPING",     [](auto *o, auto &v) { o->setShipping(v.toDouble()); } );
+        h.insert(u"ORDERINSURANCE",    [](auto *o, auto &v) { o->setInsurance(v.toDouble()); } );
+        h.insert(u"ORDERADDCHRG1",     [](auto *o, auto &v) { o->setAdditionalCharges1(v.toDouble()); } );
+        h.insert(u"ORDERADDCHRG2",     [](auto *o, auto &v) { o->setAdditionalCharges2(v.toDouble()); } );
+        h.insert(u"ORDERCREDIT",       [](auto *o, auto &v) { o->setCredit(v.toDouble()); } );
+        h.insert(u"ORDERCREDITCOUPON", [](auto *o, auto &v) { o->setCreditCoupon(v.toDouble()); } );
+        h.insert(u"ORDERTOTAL",        [](auto *o, auto &v) { o->setOrderTotal(v.toDouble()); } );
+        h.insert(u"ORDERSALESTAX",     [](auto *o, auto &v) { o->setUsSalesTax(v.toDouble()); } );   // US SalesTax collected by BL
+        h.insert(u"ORDERVAT",          [](auto *o, auto &v) { o->setVatChargeBrickLink(v.toDouble()); } ); // VAT collected by BL
+        h.insert(u"BASECURRENCYCODE",  [](auto *o, auto &v) { o->setCurrencyCode(v); } );
+        h.insert(u"BASEGRANDTOTAL",    [](auto *o, auto &v) { o->setGrandTotal(v.toDouble()); } );
+        h.insert(u"PAYCURRENCYCODE",   [](auto *o, auto &v) { o->setPaymentCurrencyCode(v); } );
+        h.insert(u"ORDERLOTS",         [](auto *o, auto &v) { o->setLotCount(v.toInt()); } );
+        h.insert(u"ORDERITEMS",        [](auto *o, auto &v) { o->setItemCount(v.toInt()); } );
+        h.insert(u"ORDERCOST",         [](auto *o, auto &v) { o->setCost(v.toDouble()); } );
+        h.insert(u"ORDERSTATUS",       [](auto *o, auto &v) { o->setStatus(Order::statusFromString(v)); } );
+        h.insert(u"PAYMENTTYPE",       [](auto *o, auto &v) { o->setPaymentType(v); } );
+        h.insert(u"ORDERREMARKS",      [](auto *o, auto &v) { o->setRemarks(v); } );
+        h.insert(u"ORDERTRACKNO",      [](auto *o, auto &v) { o->setTrackingNumber(v); } );
+        h.insert(u"PAYMENTSTATUS",     [](auto *o, auto &v) { o->setPaymentStatus(v); } );
+        h.insert(u"PAYMENTSTATUSCHANGED", [](auto *o, auto &v) { o->setPaymentLastUpdated(QDate::fromString(v, u"M/d/yyyy")); } );
+        h.insert(u"VATCHARGES",        [](auto *o, auto &v) { o->setVatChargeSeller(v.toDouble()); } ); // VAT charge by seller
+        h.insert(u"LOCATION",          [](auto *o, auto &v) { if (!v.isEmpty()) o->setCountryCode(BrickLink::core()->countryIdFromName(v.section(u", "_qs, 0, 0))); } );
+        return h;
+    }();
 
-    QHash<QStringView, std::function<void(Order *, const QString &)>> rootTagHash;
-
-    rootTagHash.insert(u"ORDERID",           [](auto *o, auto &v) { o->setId(v); } );
-    rootTagHash.insert(u"BUYER",             [](auto *o, auto &v) { o->setOtherParty(v); o->setType(OrderType::Received); } );
-    rootTagHash.insert(u"SELLER",            [](auto *o, auto &v) { o->setOtherParty(v); o->setType(OrderType::Placed); } );
-    rootTagHash.insert(u"ORDERDATE",         [](auto *o, auto &v) { o->setDate(QDate::fromString(v, u"M/d/yyyy")); } );
-    rootTagHash.insert(u"ORDERSTATUSCHANGED",[](auto *o, auto &v) { o->setLastUpdated(QDate::fromString(v, u"M/d/yyyy")); } );
-    rootTagHash.insert(u"ORDERSHIPPING",     [](auto *o, auto &v) { o->setShipping(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERINSURANCE",    [](auto *o, auto &v) { o->setInsurance(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERADDCHRG1",     [](auto *o, auto &v) { o->setAdditionalCharges1(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERADDCHRG2",     [](auto *o, auto &v) { o->setAdditionalCharges2(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERCREDIT",       [](auto *o, auto &v) { o->setCredit(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERCREDITCOUPON", [](auto *o, auto &v) { o->setCreditCoupon(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERTOTAL",        [](auto *o, auto &v) { o->setOrderTotal(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERSALESTAX",     [](auto *o, auto &v) { o->setUsSalesTax(v.toDouble()); } );   // US SalesTax collected by BL
-    rootTagHash.insert(u"ORDERVAT",          [](auto *o, auto &v) { o->setVatChargeBrickLink(v.toDouble()); } ); // VAT collected by BL
-    rootTagHash.insert(u"BASECURRENCYCODE",  [](auto *o, auto &v) { o->setCurrencyCode(v); } );
-    rootTagHash.insert(u"BASEGRANDTOTAL",    [](auto *o, auto &v) { o->setGrandTotal(v.toDouble()); } );
-    rootTagHash.insert(u"PAYCURRENCYCODE",   [](auto *o, auto &v) { o->setPaymentCurrencyCode(v); } );
-    rootTagHash.insert(u"ORDERLOTS",         [](auto *o, auto &v) { o->setLotCount(v.toInt()); } );
-    rootTagHash.insert(u"ORDERITEMS",        [](auto *o, auto &v) { o->setItemCount(v.toInt()); } );
-    rootTagHash.insert(u"ORDERCOST",         [](auto *o, auto &v) { o->setCost(v.toDouble()); } );
-    rootTagHash.insert(u"ORDERSTATUS",       [](auto *o, auto &v) { o->setStatus(Order::statusFromString(v)); } );
-    rootTagHash.insert(u"PAYMENTTYPE",       [](auto *o, auto &v) { o->setPaymentType(v); } );
-    rootTagHash.insert(u"ORDERREMARKS",      [](auto *o, auto &v) { o->setRemarks(v); } );
-    rootTagHash.insert(u"ORDERTRACKNO",      [](auto *o, auto &v) { o->setTrackingNumber(v); } );
-    rootTagHash.insert(u"PAYMENTSTATUS",     [](auto *o, auto &v) { o->setPaymentStatus(v); } );
-    rootTagHash.insert(u"PAYMENTSTATUSCHANGED", [](auto *o, auto &v) { o->setPaymentLastUpdated(QDate::fromString(v, u"M/d/yyyy")); } );
-    rootTagHash.insert(u"VATCHARGES",        [](auto *o, auto &v) { o->setVatChargeSeller(v.toDouble()); } ); // VAT charge by seller
-    rootTagHash.insert(u"LOCATION",          [](auto *o, auto &v) { if (!v.isEmpty()) o->setCountryCode(BrickLink::core()->countryIdFromName(v.section(u", "_qs, 0, 0))); } );
+    std::unique_ptr<Order> order;
 
     try {
-        int startOfOrder = -1;
-
         while (true) {
             switch (xml.readNext()) {
             case QXmlStreamReader::StartElement: {
                 auto tagName = xml.name();
 
                 if (tagName == u"ORDER") {
-                    if (order || startOfOrder >= 0)
+                    if (order)
                         throw Exception("Found a nested ORDER tag");
-                    startOfOrder = int(xml.characterOffset());
                     order = std::make_unique<Order>();
-
-                    QQmlEngine::setObjectOwnership(order.get(), QQmlEngine::CppOwnership);
-
-                } else if (tagName != u"ORDERS") {
+                } else {
                     auto it = rootTagHash.find(xml.name());
                     if (it != rootTagHash.end())
                         (*it)(order.get(), xml.readElementText());
                     else
                         xml.skipCurrentElement();
                 }
-
                 break;
             }
-
-            case QXmlStreamReader::EndElement: {
-                auto tagName = xml.name();
-
-                if (tagName == u"ORDER") {
-                    if (!order || (startOfOrder < 0))
-                        throw Exception("Found a ORDER end tag without a start tag");
-                    int endOfOrder = int(xml.characterOffset());
-                    QString header = u"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<ORDER>\n"_qs;
-                    QString footer = u"\n"_qs;
-                    result.insert(order.release(), header + data.mid(startOfOrder, endOfOrder - startOfOrder + 1) + footer);
-                    startOfOrder = -1;
-                }
-                break;
+            case QXmlStreamReader::EndDocument: {
+                // the record is cut at "</ORDER>": the XML declaration has to be added back
+                QString header = u"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<ORDER>\n"_qs;
+                QString footer = u"\n"_qs;
+                order->moveToThread(thread());
+                m_orders.insert(order.release(), header + data.mid(7) + footer);
+                return;
             }
-            case QXmlStreamReader::EndDocument:
-                return result;
-
             case QXmlStreamReader::Invalid:
                 throw Exception(xml.errorString());
 
@@ -1207,9 +1310,8 @@ QHash<Order *, QString> Orders::parseOrdersXML(const QByteArray &data_)
             }
         }
     } catch (const Exception &e) {
-        qDeleteAll(result.keyBegin(), result.keyEnd());
         throw Exception("XML parse error at line %1, column %2: %3")
-                .arg(xml.lineNumber()).arg(xml.columnNumber()).arg(e.errorString());
+                .arg(m_line + int(xml.lineNumber()) - 1).arg(xml.columnNumber()).arg(e.errorString());
     }
 }
 
@@ -1430,7 +1532,7 @@ void Orders::startUpdateInternal(const QDate &fromDate, const QDate &toDate,
         query.addQueryItem(u"includeMyCost"_qs, u"Y"_qs);
         url.setQuery(query);
 
-        auto job = TransferJob::post(url);
+        auto job = TransferJob::post(url, new OrdersXmlParser);
         job->setUserData(type, true);
         d->m_jobs << job;
 
@@ -7,6 +7,7 @@
 #include <QDateTime>
 #include <QVector>
 #include <QIcon>
+#include <QIODevice>
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlQuery>
 
@@ -51,6 +52,40 @@ public:
     QString   m_phone;
 };
 
+// Parses the ORDERS XML while it is still being downloaded: it is the order jobs' sink device.
+// Every ORDER record is parsed as soon as it is complete, so only the current record is buffered.
+// The orders are created in the writing thread, but are moved to the thread owning the parser.
+
+class OrdersXmlParser : public QIODevice
+{
+public:
+    OrdersXmlParser();
+    ~OrdersXmlParser() override;
+
+    void addData(QByteArrayView data);
+    QHash<Order *, QString> finish(); // throws, the caller takes ownership of the orders
+
+    bool seek(qint64 pos) override;
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    void clear();
+    void skipOutsideOfOrders(QByteArrayView data);
+    void parseOrder(QByteArray orderXml);
+
+    enum class Root { Before, Inside, After };
+
+    const bool m_fixUnescapedFields;
+    QByteArray m_buffer;
+    int m_line = 1; // line number of m_buffer's start
+    Root m_root = Root::Before;
+    QHash<Order *, QString> m_orders;
+    QString m_error;
+};
+
 class OrdersPrivate
 {
 public:
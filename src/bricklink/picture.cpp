@@ -149,7 +149,10 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
                     "id TEXT NOT NULL PRIMARY KEY, "
                     "updated INTEGER, "             // msecsSinceEpoch
                     "accessed INTEGER NOT NULL, "   // msecsSinceEpoch
-                    "data BLOB) WITHOUT ROWID;"_qs)) {
+                    "data BLOB, "
+                    "etag TEXT, "                   // HTTP ETag
+                    "modified INTEGER) "            // HTTP Last-Modified, msecsSinceEpoch
+                    "WITHOUT ROWID;"_qs)) {
             qCWarning(LogSql) << "Failed to create the 'pic' table in the picture database:"
                               << createQuery.lastError().text();
             d->m_db.close();
@@ -157,7 +160,7 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
     }
 
     if (d->m_db.isOpen()) {
-        static constexpr int DBVersion = 1;
+        static constexpr int DBVersion = 2;
 
         {
             QSqlQuery jnlQuery(u"PRAGMA journal_mode = wal;"_qs, d->m_db);
@@ -169,11 +172,24 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
             QSqlQuery uvQuery(u"PRAGMA user_version;"_qs, d->m_db);
             uvQuery.next();
             auto userVersion = uvQuery.value(0).toInt();
-            if (userVersion == 0) // brand new file, bump version
+            if (userVersion == 0) { // brand new file, bump version
                 QSqlQuery(u"PRAGMA user_version=%1;"_qs.arg(DBVersion), d->m_db);
+            } else if (userVersion == 1) {
+                // v2 added the HTTP cache validators
+                d->m_db.transaction();
+                QSqlQuery etagQuery(u"ALTER TABLE pic ADD COLUMN etag TEXT;"_qs, d->m_db);
+                QSqlQuery modifiedQuery(u"ALTER TABLE pic ADD COLUMN modified INTEGER;"_qs, d->m_db);
+                if (etagQuery.lastError().isValid() || modifiedQuery.lastError().isValid()) {
+                    qCWarning(LogSql) << "Failed to upgrade the picture database:"
+                                      << etagQuery.lastError().text() << modifiedQuery.lastError().text();
+                    d->m_db.rollback();
+                    d->m_db.close();
+                } else {
+                    QSqlQuery(u"PRAGMA user_version=%1;"_qs.arg(DBVersion), d->m_db);
+                    d->m_db.commit();
+                }
+            }
         }
-
-        // DB schema upgrade code goes here...
     }
 
 #if 0 // DB conversion helper
@@ -343,7 +359,14 @@ void PictureCache::updatePicture(Picture *pic, bool highPriority)
     QString url = u"https://img.bricklink.com/ItemImage/" + QLatin1Char(pic->item()->itemTypeId())
             + u"N/" + QString::number(colorId) + u'/' + QLatin1String(pic->item()->id()) + u".png";
 
-    pic->m_transferJob = TransferJob::get(url);
+    // if we still have the image, a conditional request is enough: most of the time the answer
+    // is a tiny 304 instead of the image that would need to be decoded and re-encoded again
+    if (pic->isValid() && !pic->m_image.isNull() && !pic->m_etag.isEmpty())
+        pic->m_transferJob = TransferJob::getIfDifferent(url, pic->m_etag);
+    else if (pic->isValid() && !pic->m_image.isNull() && pic->m_lastModified.isValid())
+        pic->m_transferJob = TransferJob::getIfNewer(url, pic->m_lastModified);
+    else
+        pic->m_transferJob = TransferJob::get(url);
     pic->m_transferJob->setUserData("picture", QVariant::fromValue(pic));
     d->m_core->retrieve(pic->m_transferJob, highPriority);
 }
@@ -448,14 +471,14 @@ void PictureCachePrivate::reprioritize(Picture *pic, bool highPriority)
     m_loadMutex.unlock();
 }
 
-void PictureCachePrivate::save(Picture *pic)
+void PictureCachePrivate::save(Picture *pic, SaveType saveType)
 {
     if (!pic)
         return;
 
     pic->addRef();
     m_saveMutex.lock();
-    m_saveQueue.append({ pic, SaveData });
+    m_saveQueue.append({ pic, saveType });
     m_saveTrigger.wakeOne();
     auto queueSize = m_saveQueue.size();
     m_saveMutex.unlock();
@@ -469,7 +492,7 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
     db.open();
 
     QSqlQuery loadQuery(db);
-    loadQuery.prepare(u"SELECT updated,data FROM pic WHERE id=:id;"_qs);
+    loadQuery.prepare(u"SELECT updated,data,etag,modified FROM pic WHERE id=:id;"_qs);
 
     while (!m_stop) {
         QMutexLocker locker(&m_loadMutex);
@@ -491,6 +514,8 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
 
             bool loaded = false;
             QDateTime lastUpdated;
+            QString etag;
+            QDateTime lastModified;
             QImage img;
             bool highPriority = (loadType == LoadHighPriority);
             bool convertedFromOldCache = false;
@@ -504,6 +529,9 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
                                                       : QDateTime::fromMSecsSinceEpoch(loadQuery.value(0).toLongLong());
                     auto data = loadQuery.value(1).toByteArray();
                     loaded = imageFromData(img, data);
+                    etag = loadQuery.value(2).toString();
+                    if (!loadQuery.isNull(3))
+                        lastModified = QDateTime::fromMSecsSinceEpoch(loadQuery.value(3).toLongLong());
                 }
                 loadQuery.finish();
             }
@@ -527,6 +555,8 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
                 if (loaded) {
                     pic->setLastUpdated(lastUpdated);
                     pic->setImage(img);
+                    pic->m_etag = etag;
+                    pic->m_lastModified = lastModified;
 
                     // update the last accessed time stamp
                     pic->addRef();
@@ -563,13 +593,18 @@ void PictureCachePrivate::saveThread(QString dbName, int index)
     db.open();
 
     QSqlQuery saveQuery(db);
-    saveQuery.prepare(u"INSERT INTO pic(id,updated,accessed,data) VALUES(:id,:updated,:accessed,:data) "
+    saveQuery.prepare(u"INSERT INTO pic(id,updated,accessed,data,etag,modified) "
+                      "VALUES(:id,:updated,:accessed,:data,:etag,:modified) "
                       "ON CONFLICT(id) DO UPDATE "
-                      "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data;"_qs);
+                      "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data,"
+                      "etag=excluded.etag,modified=excluded.modified;"_qs);
 
     QSqlQuery accessQuery(db);
     accessQuery.prepare(u"UPDATE pic SET accessed=:accessed WHERE id=:id;"_qs);
 
+    QSqlQuery updateQuery(db);
+    updateQuery.prepare(u"UPDATE pic SET updated=:updated,accessed=:accessed WHERE id=:id;"_qs);
+
     while (!m_stop) {
         QMutexLocker locker(&m_saveMutex);
         if (m_saveQueue.isEmpty())
@@ -620,16 +655,33 @@ void PictureCachePrivate::saveThread(QString dbName, int index)
                                               << accessQuery.lastError().text();
                         }
                         accessQuery.finish();
+                    } else if (saveType == SaveUpdateTimeOnly) {
+                        updateQuery.bindValue(u":id"_qs, dbTag);
+                        updateQuery.bindValue(u":updated"_qs, pic->lastUpdated().toMSecsSinceEpoch());
+                        updateQuery.bindValue(u":accessed"_qs, now);
+                        if (!updateQuery.exec()) {
+                            qCWarning(LogSql) << "Failed to update the update time of a picture:"
+                                              << updateQuery.lastError().text();
+                        }
+                        updateQuery.finish();
                     } else {
                         const auto data = imageDataHash.value(pic);
                         auto lastUpdated = QVariant(QMetaType::fromType<qint64>());
                         if (pic->lastUpdated().isValid())
                             lastUpdated = QVariant::fromValue(pic->lastUpdated().toMSecsSinceEpoch());
+                        auto etag = QVariant(QMetaType::fromType<QString>());
+                        if (!pic->m_etag.isEmpty())
+                            etag = pic->m_etag;
+                        auto lastModified = QVariant(QMetaType::fromType<qint64>());
+                        if (pic->m_lastModified.isValid())
+                            lastModified = QVariant::fromValue(pic->m_lastModified.toMSecsSinceEpoch());
 
                         saveQuery.bindValue(u":id"_qs, dbTag);
                         saveQuery.bindValue(u":updated"_qs, lastUpdated);
                         saveQuery.bindValue(u":accessed"_qs, now);
                         saveQuery.bindValue(u":data"_qs, data);
+                        saveQuery.bindValue(u":etag"_qs, etag);
+                        saveQuery.bindValue(u":modified"_qs, lastModified);
 
                         if (!saveQuery.exec()) {
                             qCWarning(LogSql) << "Failed to save picture data:"
@@ -651,12 +703,19 @@ void PictureCachePrivate::transferJobFinished(TransferJob *j, Picture *pic)
     Q_ASSERT(pic && (j == pic->m_transferJob));
     pic->m_transferJob = nullptr;
 
-    if (j->isCompleted()) {
+    if (j->isCompleted() && j->wasNotModified()) {
+        pic->setLastUpdated(QDateTime::currentDateTime());
+        pic->setUpdateStatus(UpdateStatus::Ok);
+
+        save(pic, SaveUpdateTimeOnly);
+    } else if (j->isCompleted()) {
         QImage img;
         QByteArray data = *j->data();
         if (imageFromData(img, data)) {
             pic->setLastUpdated(QDateTime::currentDateTime());
             pic->setImage(img);
+            pic->m_etag = j->lastETag();
+            pic->m_lastModified = j->lastModified();
             pic->setIsValid(true);
             pic->setUpdateStatus(UpdateStatus::Ok);
             m_cache.setObjectCost(cacheKey(pic->item(), pic->color()), pic->cost());
@@ -63,6 +63,10 @@ private:
 
     QDateTime    m_lastUpdated;
 
+    // the HTTP cache validators of the last download: used to revalidate instead of re-downloading
+    QString      m_etag;
+    QDateTime    m_lastModified;
+
     bool         m_valid           : 1 = false;
     bool         m_updateAfterLoad : 1 = false;
     UpdateStatus m_updateStatus    : 3 = UpdateStatus::Ok;
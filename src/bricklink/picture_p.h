@@ -37,6 +37,7 @@ public:
     enum SaveType {
         SaveData,
         SaveAccessTimeOnly,
+        SaveUpdateTimeOnly, // revalidated, but not modified
     };
 
     QVector<std::pair<Picture *, LoadType>> m_loadQueue;
@@ -60,7 +61,7 @@ public:
 
     void load(Picture *pic, bool highPriority);
     void reprioritize(Picture *pic, bool highPriority);
-    void save(Picture *pic);
+    void save(Picture *pic, SaveType saveType = SaveData);
     void loadThread(QString dbName, int index);
     void saveThread(QString dbName, int index);
     void transferJobFinished(TransferJob *j, Picture *pic);
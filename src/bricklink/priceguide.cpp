@@ -124,18 +124,31 @@ void SingleHTMLScrapePGRetriever::fetch(PriceGuide *pg, bool highPriority)
     pg->addRef();
 
     QUrl url = QUrl(u"https://www.bricklink.com/priceGuideSummary.asp"_qs);
-    url.setQuery({
-                     { u"a"_qs,           QString(QLatin1Char(pg->item()->itemTypeId())) },
-                     { u"vcID"_qs,        u"1"_qs }, // USD
-                     { u"vatInc"_qs,      (pg->vatType() == VatType::Included) ? u"Y"_qs : u"N"_qs },
-                     { u"viewExclude"_qs, u"Y"_qs },
-                     { u"ajView"_qs,      u"Y"_qs }, // only the AJAX snippet
-                     { u"colorID"_qs,     QString::number(pg->color()->id()) },
-                     { u"itemID"_qs,      Utility::urlQueryEscape(pg->item()->id()) },
-                     { u"uncache"_qs,     QString::number(QDateTime::currentMSecsSinceEpoch()) },
-                 });
-
-    auto job = TransferJob::get(url, nullptr, 2);
+    QUrlQuery query({
+                        { u"a"_qs,           QString(QLatin1Char(pg->item()->itemTypeId())) },
+                        { u"vcID"_qs,        u"1"_qs }, // USD
+                        { u"vatInc"_qs,      (pg->vatType() == VatType::Included) ? u"Y"_qs : u"N"_qs },
+                        { u"viewExclude"_qs, u"Y"_qs },
+                        { u"ajView"_qs,      u"Y"_qs }, // only the AJAX snippet
+                        { u"colorID"_qs,     QString::number(pg->color()->id()) },
+                        { u"itemID"_qs,      Utility::urlQueryEscape(pg->item()->id()) },
+                    });
+
+    // only ask for the full page, if the server says that it changed since the last download.
+    // A conditional request must not bust the cache, as a changing URL never gets a 304.
+    const bool ifDifferent = pg->isValid() && !pg->m_etag.isEmpty();
+    const bool ifNewer = !ifDifferent && pg->isValid() && pg->m_lastModified.isValid();
+    if (!ifDifferent && !ifNewer)
+        query.addQueryItem(u"uncache"_qs, QString::number(QDateTime::currentMSecsSinceEpoch()));
+    url.setQuery(query);
+
+    TransferJob *job;
+    if (ifDifferent)
+        job = TransferJob::getIfDifferent(url, pg->m_etag, nullptr, 2);
+    else if (ifNewer)
+        job = TransferJob::getIfNewer(url, pg->m_lastModified, nullptr, 2);
+    else
+        job = TransferJob::get(url, nullptr, 2);
     job->setUserData("htmlPriceGuide", QVariant::fromValue(pg));
     m_jobs.insert(pg, job);
 
@@ -160,10 +173,12 @@ void SingleHTMLScrapePGRetriever::transferJobFinished(TransferJob *j, PriceGuide
     Q_ASSERT(job == j);
 
     try {
-        if (job->isCompleted()) {
+        if (job->isCompleted() && job->wasNotModified()) {
+            emit notModified(pg);
+        } else if (job->isCompleted()) {
             PriceGuide::Data data;
             if (parseHtml(*job->data(), data))
-                emit finished(pg, data);
+                emit finished(pg, data, job->lastETag(), job->lastModified());
             else
                 throw Exception("invalid price-guide data");
         } else if (job->isAborted()) {
@@ -495,7 +510,7 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
                 parsePGJson(u"ordered_new",    int(Time::PastSix), int(Condition::New));
                 parsePGJson(u"ordered_used",   int(Time::PastSix), int(Condition::Used));
 
-                emit finished(*pit, pgdata);
+                emit finished(*pit, pgdata, { }, { }); // POSTs cannot be revalidated
                 (*pit)->release();
 
                 *pit = nullptr;  // mark as "dealt with"
@@ -575,8 +590,13 @@ PriceGuideCache::PriceGuideCache(Core *core)
     qInfo() << "Using BrickLink price-guide retriever plugin:" << d->m_retriever->name();
 
     connect(d->m_retriever, &PriceGuideRetrieverInterface::finished,
-            this, [this](PriceGuide *pg, const PriceGuide::Data &data) {
-        d->retrieveFinished(pg, data);
+            this, [this](PriceGuide *pg, const PriceGuide::Data &data, const QString &etag,
+                         const QDateTime &lastModified) {
+        d->retrieveFinished(pg, data, etag, lastModified);
+    });
+    connect(d->m_retriever, &PriceGuideRetrieverInterface::notModified,
+            this, [this](PriceGuide *pg) {
+        d->retrieveNotModified(pg);
     });
     connect(d->m_retriever, &PriceGuideRetrieverInterface::failed,
             this, [this](PriceGuide *pg, const QString &errorString) {
@@ -600,7 +620,10 @@ PriceGuideCache::PriceGuideCache(Core *core)
                     "id TEXT NOT NULL PRIMARY KEY, "
                     "updated INTEGER, "             // msecsSinceEpoch
                     "accessed INTEGER NOT NULL, "   // msecsSinceEpoch
-                    "data BLOB) WITHOUT ROWID;"_qs)) {
+                    "data BLOB, "
+                    "etag TEXT, "                   // HTTP ETag
+                    "modified INTEGER) "            // HTTP Last-Modified, msecsSinceEpoch
+                    "WITHOUT ROWID;"_qs)) {
             qCWarning(LogSql) << "Failed to create the 'pg' table in the price-guide database:"
                        << createQuery.lastError().text();
             d->m_db.close();
@@ -608,7 +631,7 @@ PriceGuideCache::PriceGuideCache(Core *core)
     }
 
     if (d->m_db.isOpen()) {
-        static constexpr int DBVersion = 1;
+        static constexpr int DBVersion = 2;
 
         {
             QSqlQuery jnlQuery(u"PRAGMA journal_mode = wal;"_qs, d->m_db);
@@ -620,11 +643,24 @@ PriceGuideCache::PriceGuideCache(Core *core)
             QSqlQuery uvQuery(u"PRAGMA user_version"_qs, d->m_db);
             uvQuery.next();
             auto userVersion = uvQuery.value(0).toInt();
-            if (userVersion == 0) // brand new file, bump version
+            if (userVersion == 0) { // brand new file, bump version
                 QSqlQuery(u"PRAGMA user_version=%1"_qs.arg(DBVersion), d->m_db);
+            } else if (userVersion == 1) {
+                // v2 added the HTTP cache validators
+                d->m_db.transaction();
+                QSqlQuery etagQuery(u"ALTER TABLE pg ADD COLUMN etag TEXT;"_qs, d->m_db);
+                QSqlQuery modifiedQuery(u"ALTER TABLE pg ADD COLUMN modified INTEGER;"_qs, d->m_db);
+                if (etagQuery.lastError().isValid() || modifiedQuery.lastError().isValid()) {
+                    qCWarning(LogSql) << "Failed to upgrade the price-guide database:"
+                                      << etagQuery.lastError().text() << modifiedQuery.lastError().text();
+                    d->m_db.rollback();
+                    d->m_db.close();
+                } else {
+                    QSqlQuery(u"PRAGMA user_version=%1"_qs.arg(DBVersion), d->m_db);
+                    d->m_db.commit();
+                }
+            }
         }
-
-        // DB schema upgrade code goes here...
     }
 
     for (int i = 0; i < 1; ++i) // one writer should be enough
@@ -849,14 +885,14 @@ void PriceGuideCachePrivate::load(PriceGuide *pg, bool highPriority)
     AppStatistics::inst()->update(m_loadsStatId, queueSize);
 }
 
-void PriceGuideCachePrivate::save(PriceGuide *pg)
+void PriceGuideCachePrivate::save(PriceGuide *pg, SaveType saveType)
 {
     if (!pg)
         return;
 
     pg->addRef();
     m_saveMutex.lock();
-    m_saveQueue.append({ pg, SaveData });
+    m_saveQueue.append({ pg, saveType });
     m_saveTrigger.wakeOne();
     auto queueSize = m_saveQueue.size();
     m_saveMutex.unlock();
@@ -870,7 +906,7 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
     db.open();
 
     QSqlQuery loadQuery(db);
-    loadQuery.prepare(u"SELECT updated,data FROM pg WHERE id=:id;"_qs);
+    loadQuery.prepare(u"SELECT updated,data,etag,modified FROM pg WHERE id=:id;"_qs);
 
     while (!m_stop) {
         QMutexLocker locker(&m_loadMutex);
@@ -894,6 +930,8 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
             bool loaded = false;
             QDateTime lastUpdated;
             QByteArray data;
+            QString etag;
+            QDateTime lastModified;
             bool highPriority = (loadType == LoadHighPriority);
 
             if (db.isOpen()) {
@@ -905,6 +943,9 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
                                                       : QDateTime::fromMSecsSinceEpoch(loadQuery.value(0).toLongLong());
                     data = loadQuery.value(1).toByteArray();
                     loaded = data.isEmpty() || (data.size() == sizeof(PriceGuide::Data));
+                    etag = loadQuery.value(2).toString();
+                    if (!loadQuery.isNull(3))
+                        lastModified = QDateTime::fromMSecsSinceEpoch(loadQuery.value(3).toLongLong());
                 }
                 loadQuery.finish();
             }
@@ -913,6 +954,8 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
                 if (loaded) {
                     pg->setLastUpdated(lastUpdated);
                     std::memcpy(&pg->m_data, data, sizeof(PriceGuide::Data));
+                    pg->m_etag = etag;
+                    pg->m_lastModified = lastModified;
 
                     // update the last accessed time stamp
                     pg->addRef();
@@ -948,13 +991,18 @@ void PriceGuideCachePrivate::saveThread(QString dbName, int index)
     db.open();
 
     QSqlQuery saveQuery(db);
-    saveQuery.prepare(u"INSERT INTO pg(id,updated,accessed,data) VALUES(:id,:updated,:accessed,:data) "
+    saveQuery.prepare(u"INSERT INTO pg(id,updated,accessed,data,etag,modified) "
+                      "VALUES(:id,:updated,:accessed,:data,:etag,:modified) "
                       "ON CONFLICT(id) DO UPDATE "
-                      "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data;"_qs);
+                      "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data,"
+                      "etag=excluded.etag,modified=excluded.modified;"_qs);
 
     QSqlQuery accessQuery(db);
     accessQuery.prepare(u"UPDATE pg SET accessed=:accessed WHERE id=:id;"_qs);
 
+    QSqlQuery updateQuery(db);
+    updateQuery.prepare(u"UPDATE pg SET updated=:updated,accessed=:accessed WHERE id=:id;"_qs);
+
     while (!m_stop) {
         QMutexLocker locker(&m_saveMutex);
         if (m_saveQueue.isEmpty())
@@ -985,16 +1033,33 @@ void PriceGuideCachePrivate::saveThread(QString dbName, int index)
                                               << accessQuery.lastError().text();
                         }
                         accessQuery.finish();
+                    } else if (saveType == SaveUpdateTimeOnly) {
+                        updateQuery.bindValue(u":id"_qs, dbTag);
+                        updateQuery.bindValue(u":updated"_qs, pg->lastUpdated().toMSecsSinceEpoch());
+                        updateQuery.bindValue(u":accessed"_qs, now);
+                        if (!updateQuery.exec()) {
+                            qCWarning(LogSql) << "Failed to update the update time of a price-guide:"
+                                              << updateQuery.lastError().text();
+                        }
+                        updateQuery.finish();
                     } else {
                         auto lastUpdated = QVariant(QMetaType::fromType<qint64>());
                         if (pg->lastUpdated().isValid())
                             lastUpdated = QVariant::fromValue(pg->lastUpdated().toMSecsSinceEpoch());
+                        auto etag = QVariant(QMetaType::fromType<QString>());
+                        if (!pg->m_etag.isEmpty())
+                            etag = pg->m_etag;
+                        auto lastModified = QVariant(QMetaType::fromType<qint64>());
+                        if (pg->m_lastModified.isValid())
+                            lastModified = QVariant::fromValue(pg->m_lastModified.toMSecsSinceEpoch());
 
                         saveQuery.bindValue(u":id"_qs, dbTag);
                         saveQuery.bindValue(u":updated"_qs, lastUpdated);
                         saveQuery.bindValue(u":accessed"_qs, now);
                         saveQuery.bindValue(u":data"_qs, QByteArray::fromRawData(reinterpret_cast<const char *>(&pg->m_data),
                                                                                  sizeof(PriceGuide::Data)));
+                        saveQuery.bindValue(u":etag"_qs, etag);
+                        saveQuery.bindValue(u":modified"_qs, lastModified);
                         if (!saveQuery.exec()) {
                             qCWarning(LogSql) << "Failed to save price-guide data:"
                                               << saveQuery.lastError().text();
@@ -1010,10 +1075,13 @@ void PriceGuideCachePrivate::saveThread(QString dbName, int index)
     db.close();
 }
 
-void PriceGuideCachePrivate::retrieveFinished(PriceGuide *pg, const PriceGuide::Data &data)
+void PriceGuideCachePrivate::retrieveFinished(PriceGuide *pg, const PriceGuide::Data &data,
+                                              const QString &etag, const QDateTime &lastModified)
 {
     pg->setLastUpdated(QDateTime::currentDateTime());
     pg->m_data = data;
+    pg->m_etag = etag;
+    pg->m_lastModified = lastModified;
 
     save(pg);
 
@@ -1040,6 +1108,16 @@ void PriceGuideCachePrivate::retrieveFinished(PriceGuide *pg, const PriceGuide::
     emit q->priceGuideUpdated(pg);
 }
 
+void PriceGuideCachePrivate::retrieveNotModified(PriceGuide *pg)
+{
+    pg->setLastUpdated(QDateTime::currentDateTime());
+
+    save(pg, SaveUpdateTimeOnly);
+
+    pg->setUpdateStatus(UpdateStatus::Ok);
+    emit q->priceGuideUpdated(pg);
+}
+
 void PriceGuideCachePrivate::retrieveFailed(PriceGuide *pg, const QString &errorString [[maybe_unused]])
 {
     //qCWarning(LogCache).noquote() << errorString;
@@ -71,6 +71,10 @@ private:
 
     QDateTime    m_lastUpdated;
 
+    // the HTTP cache validators of the last download: used to revalidate instead of re-downloading
+    QString      m_etag;
+    QDateTime    m_lastModified;
+
     VatType      m_vatType         : 8 = VatType::Excluded;
     char         m_retrieverId     : 8 = '0';
     bool         m_valid           : 1 = false;
@@ -91,6 +95,7 @@ private:
 
     friend class PriceGuideCache;
     friend class PriceGuideCachePrivate;
+    friend class SingleHTMLScrapePGRetriever;
 };
 
 
@@ -41,7 +41,9 @@ public:
     virtual void cancelAll() = 0;
 
 signals:
-    void finished(BrickLink::PriceGuide *pg, const BrickLink::PriceGuide::Data &data);
+    void finished(BrickLink::PriceGuide *pg, const BrickLink::PriceGuide::Data &data,
+                  const QString &etag, const QDateTime &lastModified);
+    void notModified(BrickLink::PriceGuide *pg);
     void failed(BrickLink::PriceGuide *pg, const QString &errorString);
 };
 
@@ -125,6 +127,7 @@ public:
     enum SaveType {
         SaveData,
         SaveAccessTimeOnly,
+        SaveUpdateTimeOnly, // revalidated, but not modified
     };
 
     QVector<std::pair<PriceGuide *, LoadType>> m_loadQueue;
@@ -147,11 +150,13 @@ public:
     bool isUpdateNeeded(PriceGuide *pg) const;
 
     void load(PriceGuide *pg, bool highPriority);
-    void save(PriceGuide *pg);
+    void save(PriceGuide *pg, SaveType saveType = SaveData);
     void loadThread(QString dbName, int index);
     void saveThread(QString dbName, int index);
 
-    void retrieveFinished(PriceGuide *pg, const PriceGuide::Data &data);
+    void retrieveFinished(PriceGuide *pg, const PriceGuide::Data &data, const QString &etag,
+                          const QDateTime &lastModified);
+    void retrieveNotModified(PriceGuide *pg);
     void retrieveFailed(PriceGuide *pg, const QString &errorString);
 };
 
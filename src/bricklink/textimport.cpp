@@ -15,6 +15,8 @@
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonValue>
 #include <QtCore/QStringBuilder>
+#include <QtCore/QSet>
+#include <QtConcurrent/QtConcurrent>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
 
@@ -23,6 +25,7 @@
 #include "bricklink/core.h"
 #include "bricklink/dimensions.h"
 #include "bricklink/textimport.h"
+#include "bricklink/inventorystore.h"
 #include "bricklink/partcolorcode.h"
 #include "bricklink/changelogentry.h"
 
@@ -35,12 +38,38 @@
 /////////////////////////////////////////////////////////////////////////////////////////
 
 
+// the derived-data passes are run as map/reduce stages over these item ranges: the reduce
+// steps are ordered, so the results are the same as with a single sequential sweep
+using ItemRange = std::pair<uint, uint>;
+
+static QVector<ItemRange> itemRanges(size_t itemCount)
+{
+    static constexpr size_t RangeSize = 4096;
+
+    QVector<ItemRange> ranges;
+    for (size_t from = 0; from < itemCount; from += RangeSize)
+        ranges.append({ uint(from), uint(std::min(itemCount, from + RangeSize)) });
+    return ranges;
+}
+
+
 BrickLink::TextImport::TextImport()
     : m_db(core()->database())
+    , m_inventoryStore(new InventoryStore(core()->dataPath() + u"inventories.store"_qs))
 { }
 
 BrickLink::TextImport::~TextImport()
-{ }
+{
+    try {
+        m_inventoryStore->compact();
+
+        // the old per-item files are superseded, now that their contents are safely stored
+        for (const QString &fileName : std::as_const(m_migratedInventoryFiles))
+            QFile::remove(fileName);
+    } catch (const Exception &e) {
+        qWarning() << "Error compacting the inventory store:" << e.what();
+    }
+}
 
 bool BrickLink::TextImport::import(const QString &path)
 {
@@ -69,6 +98,8 @@ bool BrickLink::TextImport::import(const QString &path)
         readInventoryList(path + u"btinvlist.csv");
         readChangeLog(path + u"btchglog.csv");
 
+        m_inventoryStore->open();
+
         return true;
     } catch (const Exception &e) {
         qWarning() << "Error importing database:" << e.what();
@@ -80,7 +111,7 @@ bool BrickLink::TextImport::import(const QString &path)
 void BrickLink::TextImport::readColors(const QString &path)
 {
     XmlHelpers::ParseXML p(path, "CATALOG", "ITEM");
-    p.parse([this, &p](QDomElement e) {
+    p.parse([this, &p](const XmlHelpers::ParseXML::Element &e) {
         Color col;
         uint colid = p.elementText(e, "COLOR").toUInt();
 
@@ -127,7 +158,7 @@ void BrickLink::TextImport::readColors(const QString &path)
 void BrickLink::TextImport::readCategories(const QString &path)
 {
     XmlHelpers::ParseXML p(path, "CATALOG", "ITEM");
-    p.parse([this, &p](QDomElement e) {
+    p.parse([this, &p](const XmlHelpers::ParseXML::Element &e) {
         Category cat;
         uint catid = p.elementText(e, "CATEGORY").toUInt();
 
@@ -208,7 +239,7 @@ void BrickLink::TextImport::readAdditionalItemCategories(const QString &path, co
 void BrickLink::TextImport::readItemTypes(const QString &path)
 {
     XmlHelpers::ParseXML p(path, "CATALOG", "ITEM");
-    p.parse([this, &p](QDomElement e) {
+    p.parse([this, &p](const XmlHelpers::ParseXML::Element &e) {
         ItemType itt;
         char c = ItemType::idFromFirstCharInString(p.elementText(e, "ITEMTYPE"));
 
@@ -232,7 +263,7 @@ void BrickLink::TextImport::readItemTypes(const QString &path)
 void BrickLink::TextImport::readItems(const QString &path, const BrickLink::ItemType *itt)
 {
     XmlHelpers::ParseXML p(path, "CATALOG", "ITEM");
-    p.parse([this, &p, itt](QDomElement e) {
+    p.parse([this, &p, itt](const XmlHelpers::ParseXML::Element &e) {
         Item item;
         item.m_id.copyQByteArray(p.elementText(e, "ITEMID").toLatin1(), nullptr);
         const QString itemName = p.elementText(e, "ITEMNAME").simplified();
@@ -285,7 +316,7 @@ void BrickLink::TextImport::readItems(const QString &path, const BrickLink::Item
 void BrickLink::TextImport::readPartColorCodes(const QString &path)
 {
     XmlHelpers::ParseXML p(path, "CODES", "ITEM");
-    p.parse([this, &p](QDomElement e) {
+    p.parse([this, &p](const XmlHelpers::ParseXML::Element &e) {
         char itemTypeId = ItemType::idFromFirstCharInString(p.elementText(e, "ITEMTYPE"));
         const QByteArray itemId = p.elementText(e, "ITEMID").toLatin1();
         const QString colorName = p.elementText(e, "COLOR").simplified();
@@ -342,74 +373,83 @@ bool BrickLink::TextImport::importInventories(std::vector<bool> &processedInvs,
     return true;
 }
 
-bool BrickLink::TextImport::readInventory(const Item *item, ImportInventoriesStep step)
+void BrickLink::TextImport::addDownloadedInventory(const Item *item, const QByteArray &xml)
 {
-    std::unique_ptr<QFile> f(BrickLink::core()->dataReadFile(u"inventory.xml", item));
-
-    QDateTime fileTime = f->fileTime(QFileDevice::FileModificationTime);
-    QDate fileDate = fileTime.date();
+    m_inventoryStore->insert(item, QDateTime::currentDateTimeUtc(), InventoryStore::parseXml(xml));
+}
 
+bool BrickLink::TextImport::readInventory(const Item *item, ImportInventoriesStep step)
+{
     uint itemIndex = uint(item - items().data());
 
-    if (!f || !f->isOpen()
-        || (fileTime.toSecsSinceEpoch() < m_inventoryLastUpdated.value(itemIndex, -1))) {
+    QDateTime lastDownload = m_inventoryStore->lastDownload(item);
+
+    // migrate inventories downloaded by older versions, which used one XML file per item
+    if (!lastDownload.isValid() && (step == ImportFromDiskCache)) {
+        std::unique_ptr<QFile> f(BrickLink::core()->dataReadFile(u"inventory.xml", item));
+        if (f && f->isOpen()) {
+            try {
+                QDateTime fileTime = f->fileTime(QFileDevice::FileModificationTime);
+                m_inventoryStore->insert(item, fileTime, InventoryStore::parseXml(f->readAll()));
+                lastDownload = fileTime;
+                m_migratedInventoryFiles.append(f->fileName());
+            } catch (const Exception &) {
+                // just download it again
+            }
+        }
+    }
+
+    if (!lastDownload.isValid()
+        || (lastDownload.toSecsSinceEpoch() < m_inventoryLastUpdated.value(itemIndex, -1))) {
         return false;
     }
+    QDate downloadDate = lastDownload.date();
 
     QVector<Item::ConsistsOf> inventory;
     QVector<QPair<int, int>> knownColors;
 
     try {
-        XmlHelpers::ParseXML p(f.release(), "INVENTORY", "ITEM");
-        p.parse([this, &p, &inventory, &knownColors, fileDate](QDomElement e) {
-            char itemTypeId = ItemType::idFromFirstCharInString(p.elementText(e, "ITEMTYPE"));
-            const QByteArray itemId = p.elementText(e, "ITEMID").toLatin1();
-            uint colorId = p.elementText(e, "COLOR").toUInt();
-            int qty = p.elementText(e, "QTY").toInt();
-            bool extra = (p.elementText(e, "EXTRA") == u"Y");
-            bool counterPart = (p.elementText(e, "COUNTERPART") == u"Y");
-            bool alternate = (p.elementText(e, "ALTERNATE") == u"Y");
-            uint matchId = p.elementText(e, "MATCHID").toUInt();
-
-            auto item = core()->item(itemTypeId, itemId);
-            auto color = core()->color(colorId);
-
-            if (!item)
-                throw Exception("Unknown item-id %1 %2").arg(itemTypeId).arg(QString::fromLatin1(itemId));
-            if (!color)
-                throw Exception("Unknown color-id %1").arg(colorId);
-            if (!qty)
-                throw Exception("Invalid Quantity %1").arg(qty);
+        const auto records = m_inventoryStore->inventory(item);
 
-            int itemIndex = item->index();
-            int colorIndex = color->index();
+        for (const InventoryStore::Record &r : records) {
+            auto coItem = core()->item(r.itemTypeId, r.itemId);
+            auto coColor = core()->color(r.colorId);
+
+            if (!coItem)
+                throw Exception("Unknown item-id %1 %2").arg(r.itemTypeId).arg(QString::fromLatin1(r.itemId));
+            if (!coColor)
+                throw Exception("Unknown color-id %1").arg(r.colorId);
+            if (!r.quantity)
+                throw Exception("Invalid Quantity %1").arg(r.quantity);
+
+            int coItemIndex = coItem->index();
+            int coColorIndex = coColor->index();
 
             Item::ConsistsOf co;
-            co.m_bits.m_quantity = qty;
-            co.m_bits.m_itemIndex = itemIndex;
-            co.m_bits.m_colorIndex = colorIndex;
-            co.m_bits.m_extra = extra;
-            co.m_bits.m_isalt = alternate;
-            co.m_bits.m_altid = matchId;
-            co.m_bits.m_cpart = counterPart;
+            co.m_bits.m_quantity = r.quantity;
+            co.m_bits.m_itemIndex = coItemIndex;
+            co.m_bits.m_colorIndex = coColorIndex;
+            co.m_bits.m_extra = r.extra;
+            co.m_bits.m_isalt = r.alternate;
+            co.m_bits.m_altid = r.matchId;
+            co.m_bits.m_cpart = r.counterPart;
 
             // if this itemid was involved in a changelog entry after the last time we downloaded
             // the inventory, we need to reload
-            QByteArray itemTypeAndId = itemTypeId + itemId;
+            QByteArray itemTypeAndId = r.itemTypeId + r.itemId;
             auto [lit, uit] = std::equal_range(m_db->m_itemChangelog.cbegin(), m_db->m_itemChangelog.cend(), itemTypeAndId);
             for (auto it = lit; it != uit; ++it) {
-                if (it->date() > fileDate) {
+                if (it->date() > downloadDate) {
                     throw Exception("Item id %1 changed on %2 (last download: %3)")
                         .arg(QString::fromLatin1(itemTypeAndId))
                         .arg(it->date().toString(u"yyyy/MM/dd"))
-                        .arg(fileDate.toString(u"yyyy/MM/dd"));
+                        .arg(downloadDate.toString(u"yyyy/MM/dd"));
                 }
             }
 
             inventory.append(co);
-            knownColors.append({ itemIndex, colorIndex});
-
-        });
+            knownColors.append({ coItemIndex, coColorIndex });
+        }
 
         for (const auto &kc : std::as_const(knownColors))
             addToKnownColors(kc.first, kc.second);
@@ -964,17 +1004,21 @@ void BrickLink::TextImport::readRelationships(const QString &path)
 
 void BrickLink::TextImport::finalizeDatabase()
 {
-    for (auto it = m_consists_of_hash.cbegin(); it != m_consists_of_hash.cend(); ++it) {
-        Item &item = m_db->m_items[it.key()];
-        const auto &coItems = it.value();
+    // every item is only touched once in each of these loops, so they can run in parallel
+
+    auto consistsOfItems = m_consists_of_hash.keys();
+    QtConcurrent::blockingMap(consistsOfItems, [this](uint itemIndex) {
+        Item &item = m_db->m_items[itemIndex];
+        const auto coItems = m_consists_of_hash.value(itemIndex);
         item.m_consists_of.copyContainer(coItems.cbegin(), coItems.cend(), nullptr);
-    }
+    });
 
-    for (auto it = m_appears_in_hash.cbegin(); it != m_appears_in_hash.cend(); ++it) {
-        Item &item = m_db->m_items[it.key()];
+    auto appearsInItems = m_appears_in_hash.keys();
+    QtConcurrent::blockingMap(appearsInItems, [this](uint itemIndex) {
+        Item &item = m_db->m_items[itemIndex];
 
         // color-idx -> { vector < qty, item-idx > }
-        const QHash<uint, QVector<QPair<int, uint>>> &appearHash = it.value();
+        const QHash<uint, QVector<QPair<int, uint>>> appearHash = m_appears_in_hash.value(itemIndex);
 
         // we are compacting a "hash of a vector of pairs" down to a list of 32bit integers
         QVector<Item::AppearsInRecord> tmp;
@@ -995,7 +1039,7 @@ void BrickLink::TextImport::finalizeDatabase()
             }
         }
         item.m_appears_in.copyContainer(tmp.cbegin(), tmp.cend(), nullptr);
-    }
+    });
 }
 
 void BrickLink::TextImport::calculateColorPopularity()
@@ -1015,12 +1059,39 @@ void BrickLink::TextImport::calculateColorPopularity()
 
 void BrickLink::TextImport::calculateItemTypeCategories()
 {
-    for (const auto &item : m_db->m_items) {
-        // calculate the item-type -> category relation
-        ItemType &itemType = m_db->m_itemTypes[item.m_itemTypeIndex];
-        auto &catv = itemType.m_categoryIndexes;
+    // item-type-idx -> { category-idx }, in order of appearance
+    using TypeCategories = QVector<QVector<quint16>>;
+
+    const auto itemTypeCount = qsizetype(m_db->m_itemTypes.size());
+
+    const auto typeCategories = QtConcurrent::blockingMappedReduced<TypeCategories>(
+                itemRanges(m_db->m_items.size()), [this, itemTypeCount](const ItemRange &range) {
+        TypeCategories tc(itemTypeCount);
+        for (uint itemIndex = range.first; itemIndex < range.second; ++itemIndex) {
+            const Item &item = m_db->m_items[itemIndex];
+            auto &catv = tc[item.m_itemTypeIndex];
+
+            for (quint16 catIndex : item.m_categoryIndexes) {
+                if (!catv.contains(catIndex))
+                    catv.append(catIndex);
+            }
+        }
+        return tc;
+    }, [](TypeCategories &result, const TypeCategories &tc) {
+        result.resize(tc.size());
+        for (qsizetype i = 0; i < tc.size(); ++i) {
+            for (quint16 catIndex : tc.at(i)) {
+                if (!result.at(i).contains(catIndex))
+                    result[i].append(catIndex);
+            }
+        }
+    }, QtConcurrent::OrderedReduce);
+
+    // calculate the item-type -> category relation
+    for (qsizetype i = 0; i < typeCategories.size(); ++i) {
+        auto &catv = m_db->m_itemTypes[size_t(i)].m_categoryIndexes;
 
-        for (quint16 catIndex : item.m_categoryIndexes) {
+        for (quint16 catIndex : typeCategories.at(i)) {
             if (std::find(catv.cbegin(), catv.cend(), catIndex) == catv.cend())
                 catv.push_back(catIndex, nullptr);
         }
@@ -1029,44 +1100,86 @@ void BrickLink::TextImport::calculateItemTypeCategories()
 
 void BrickLink::TextImport::calculateKnownAssemblyColors()
 {
-    for (auto it = m_appears_in_hash.begin(); it != m_appears_in_hash.end(); ++it) {
+    // The type supports colors, but we have entries for color "not available"
+    //   -> check assemblies
+    // "ncItem" contains "item" with color == 0: find all possible colors for "ncItem" and
+    // copy those to "item's" appearHash. Also update the known colors.
+
+    struct Resolved
+    {
+        uint itemIndex;
+        QVector<std::pair<quint16, QPair<int, uint>>> moved; // color-idx, < qty, item-idx >
+        QVector<QPair<int, uint>> noColor;
+    };
+
+    QVector<uint> candidates;
+    for (auto it = m_appears_in_hash.cbegin(); it != m_appears_in_hash.cend(); ++it) {
         const Item &item = m_db->m_items[it.key()];
         const ItemType &itemType = m_db->m_itemTypes[item.m_itemTypeIndex];
 
-        if (!it->contains(0) || !itemType.hasColors())
-            continue;
-
-        // The type supports colors, but we have entries for color "not available"
-        //   -> check assemblies
-
-        // We need to copy here, as we modify (*it) later on and this would invalidate noColor
-        QVector<QPair<int, uint>> noColor = it->value(0);
-
-        for (auto ncit = noColor.begin(); ncit != noColor.end(); ) {
-            int ncQty = ncit->first;
-            uint ncItemIndex = ncit->second;
-            const Item &ncItem = m_db->m_items[ncItemIndex];
-
-            // "aiItem" contains "item" with color == 0: now find all possible colors
-            // for "aiItem" and copy those to "item's" appearHash.
-            // Also update the known colors.
-            bool foundColor = false;
-            for (auto colorIndex : ncItem.m_knownColorIndexes) {
-                if (colorIndex) {
-                    addToKnownColors(item.index(), colorIndex);
-                    (*it)[colorIndex].append({ ncQty, ncItemIndex });
-                    foundColor = true;
+        if (it->contains(0) && itemType.hasColors())
+            candidates.append(it.key());
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // The map step only reads the known colors, while the results are applied in item order:
+    // the outcome does not depend on the hash order anymore. Items that gained known colors
+    // might resolve some of the remaining "not available" entries, so we repeat this for
+    // all the items depending on them.
+    QVector<uint> pending = candidates;
+
+    while (!pending.isEmpty()) {
+        const auto resolved = QtConcurrent::blockingMapped<QVector<Resolved>>(pending, [this](uint itemIndex) {
+            Resolved r { itemIndex, { }, { } };
+
+            const auto noColor = m_appears_in_hash.value(itemIndex).value(0);
+            for (const auto &nc : noColor) {
+                const Item &ncItem = m_db->m_items[nc.second];
+
+                bool foundColor = false;
+                for (auto colorIndex : ncItem.m_knownColorIndexes) {
+                    if (colorIndex) {
+                        r.moved.append({ colorIndex, nc });
+                        foundColor = true;
+                    }
                 }
+                if (!foundColor)
+                    r.noColor.append(nc);
+            }
+            return r;
+        });
+
+        QSet<uint> changedItems;
+
+        for (const Resolved &r : resolved) {
+            if (r.moved.isEmpty())
+                continue;
+
+            auto &appearHash = m_appears_in_hash[r.itemIndex];
+            for (const auto &[colorIndex, entry] : r.moved) {
+                if (addToKnownColors(int(r.itemIndex), colorIndex))
+                    changedItems.insert(r.itemIndex);
+                appearHash[colorIndex].append(entry);
             }
-            if (foundColor)
-                ncit = noColor.erase(ncit);
+            if (!r.noColor.isEmpty())
+                appearHash[0] = r.noColor;
             else
-                ++ncit;
+                appearHash.remove(0);
+        }
+
+        pending.clear();
+        if (changedItems.isEmpty())
+            break;
+
+        for (uint itemIndex : std::as_const(candidates)) {
+            const auto noColor = m_appears_in_hash.value(itemIndex).value(0);
+            for (const auto &nc : noColor) {
+                if (changedItems.contains(nc.second)) {
+                    pending.append(itemIndex);
+                    break;
+                }
+            }
         }
-        if (!noColor.isEmpty())
-            (*it)[0] = noColor;
-        else
-            it->remove(0);
     }
 }
 
@@ -1077,27 +1190,58 @@ const std::vector<BrickLink::Item> &BrickLink::TextImport::items() const
 
 void BrickLink::TextImport::calculateCategoryRecency()
 {
-    QHash<uint, std::pair<quint64, quint32>> catCounter;
-
-    for (const auto &item : std::as_const(m_db->m_items)) {
-        if (item.m_year_from && item.m_year_to) {
-            for (quint16 catIndex : item.m_categoryIndexes) {
-                auto &cc = catCounter[catIndex];
-                cc.first += (item.m_year_from + item.m_year_to);
-                cc.second += 2;
-
-                auto &cat = m_db->m_categories[catIndex];
-                cat.m_year_from = cat.m_year_from ? std::min(cat.m_year_from, item.m_year_from)
-                                                  : item.m_year_from;
-                cat.m_year_to = std::max(cat.m_year_to, item.m_year_to);
+    struct CategoryYears
+    {
+        quint64 yearSum = 0;
+        quint32 yearCount = 0;
+        quint8 yearFrom = 0;
+        quint8 yearTo = 0;
+    };
+    using CategoryYearsVector = QVector<CategoryYears>;
+
+    const auto categoryCount = qsizetype(m_db->m_categories.size());
+
+    const auto catYears = QtConcurrent::blockingMappedReduced<CategoryYearsVector>(
+                itemRanges(m_db->m_items.size()), [this, categoryCount](const ItemRange &range) {
+        CategoryYearsVector cyv(categoryCount);
+        for (uint itemIndex = range.first; itemIndex < range.second; ++itemIndex) {
+            const Item &item = m_db->m_items[itemIndex];
+            if (item.m_year_from && item.m_year_to) {
+                for (quint16 catIndex : item.m_categoryIndexes) {
+                    auto &cy = cyv[catIndex];
+                    cy.yearSum += (item.m_year_from + item.m_year_to);
+                    cy.yearCount += 2;
+                    cy.yearFrom = cy.yearFrom ? std::min(cy.yearFrom, item.m_year_from)
+                                              : item.m_year_from;
+                    cy.yearTo = std::max(cy.yearTo, item.m_year_to);
+                }
             }
         }
-    }
-    for (uint catIndex = 0; catIndex < m_db->m_categories.size(); ++catIndex) {
-        auto cc = catCounter.value(catIndex);
-        if (cc.first && cc.second) {
-            auto y = quint8(qBound(0ULL, cc.first / cc.second, 255ULL));
-            m_db->m_categories[catIndex].m_year_recency = y;
+        return cyv;
+    }, [](CategoryYearsVector &result, const CategoryYearsVector &cyv) {
+        result.resize(cyv.size());
+        for (qsizetype i = 0; i < cyv.size(); ++i) {
+            auto &r = result[i];
+            const auto &cy = cyv.at(i);
+            r.yearSum += cy.yearSum;
+            r.yearCount += cy.yearCount;
+            if (cy.yearFrom)
+                r.yearFrom = r.yearFrom ? std::min(r.yearFrom, cy.yearFrom) : cy.yearFrom;
+            r.yearTo = std::max(r.yearTo, cy.yearTo);
+        }
+    }, QtConcurrent::OrderedReduce);
+
+    for (qsizetype catIndex = 0; catIndex < catYears.size(); ++catIndex) {
+        const auto &cy = catYears.at(catIndex);
+        auto &cat = m_db->m_categories[size_t(catIndex)];
+
+        if (cy.yearFrom) {
+            cat.m_year_from = cat.m_year_from ? std::min(cat.m_year_from, cy.yearFrom) : cy.yearFrom;
+            cat.m_year_to = std::max(cat.m_year_to, cy.yearTo);
+        }
+        if (cy.yearSum && cy.yearCount) {
+            auto y = quint8(qBound(0ULL, cy.yearSum / cy.yearCount, 255ULL));
+            cat.m_year_recency = y;
         }
     }
 }
@@ -1111,37 +1255,80 @@ void BrickLink::TextImport::calculatePartsYearUsed()
     //   #1 for parts in non-parts (these all have a year-released) and
     //   #2 for parts in parts (which by then should hopefully all have a year-released
 
-    for (int pass = 1; pass <= 2; ++pass) {
-        for (uint itemIndex = 0; itemIndex < m_db->m_items.size(); ++itemIndex) {
-            Item &item = m_db->m_items[itemIndex];
+    // pass #1 only reads the years of non-parts, so it can be split up
+    using PartYears = QHash<uint, std::pair<quint8, quint8>>; // part-idx -> { from, to }
 
-            bool isPart = (item.itemTypeId() == 'P');
+    const auto partYears = QtConcurrent::blockingMappedReduced<PartYears>(
+                itemRanges(m_db->m_items.size()), [this](const ItemRange &range) {
+        PartYears py;
+        for (uint itemIndex = range.first; itemIndex < range.second; ++itemIndex) {
+            const Item &item = m_db->m_items[itemIndex];
 
-            if ((pass == 1 ? !isPart : isPart) && item.yearReleased()) {
+            if ((item.itemTypeId() != 'P') && item.yearReleased()) {
                 const auto itemParts = m_consists_of_hash.value(itemIndex);
 
                 for (const BrickLink::Item::ConsistsOf &part : itemParts) {
-                    Item &partItem = m_db->m_items[part.itemIndex()];
-                    if (partItem.itemTypeId() == 'P') {
-                        partItem.m_year_from = partItem.m_year_from ? std::min(partItem.m_year_from, item.m_year_from)
-                                                                    : item.m_year_from;
-                        partItem.m_year_to   = std::max(partItem.m_year_to, item.m_year_to);
+                    if (m_db->m_items[part.itemIndex()].itemTypeId() == 'P') {
+                        auto it = py.find(part.itemIndex());
+                        if (it == py.end()) {
+                            py.insert(part.itemIndex(), { item.m_year_from, item.m_year_to });
+                        } else {
+                            it->first = std::min(it->first, item.m_year_from);
+                            it->second = std::max(it->second, item.m_year_to);
+                        }
                     }
                 }
             }
         }
+        return py;
+    }, [](PartYears &result, const PartYears &py) {
+        for (auto it = py.cbegin(); it != py.cend(); ++it) {
+            auto rit = result.find(it.key());
+            if (rit == result.end()) {
+                result.insert(it.key(), it.value());
+            } else {
+                rit->first = std::min(rit->first, it->first);
+                rit->second = std::max(rit->second, it->second);
+            }
+        }
+    }, QtConcurrent::OrderedReduce);
+
+    for (auto it = partYears.cbegin(); it != partYears.cend(); ++it) {
+        Item &partItem = m_db->m_items[it.key()];
+        partItem.m_year_from = partItem.m_year_from ? std::min(partItem.m_year_from, it->first)
+                                                    : it->first;
+        partItem.m_year_to   = std::max(partItem.m_year_to, it->second);
+    }
+
+    // pass #2 has to be sequential, as parts can propagate their years to other parts
+    for (uint itemIndex = 0; itemIndex < m_db->m_items.size(); ++itemIndex) {
+        Item &item = m_db->m_items[itemIndex];
+
+        if ((item.itemTypeId() == 'P') && item.yearReleased()) {
+            const auto itemParts = m_consists_of_hash.value(itemIndex);
+
+            for (const BrickLink::Item::ConsistsOf &part : itemParts) {
+                Item &partItem = m_db->m_items[part.itemIndex()];
+                if (partItem.itemTypeId() == 'P') {
+                    partItem.m_year_from = partItem.m_year_from ? std::min(partItem.m_year_from, item.m_year_from)
+                                                                : item.m_year_from;
+                    partItem.m_year_to   = std::max(partItem.m_year_to, item.m_year_to);
+                }
+            }
+        }
     }
 }
 
-void BrickLink::TextImport::addToKnownColors(int itemIndex, int addColorIndex)
+bool BrickLink::TextImport::addToKnownColors(int itemIndex, int addColorIndex)
 {
     if (addColorIndex <= 0)
-        return;
+        return false;
 
     Item &item = m_db->m_items[itemIndex];
     for (quint16 colIndex : item.m_knownColorIndexes) {
         if (colIndex == quint16(addColorIndex))
-            return;
+            return false;
     }
     item.m_knownColorIndexes.push_back(quint16(addColorIndex), nullptr);
+    return true;
 }
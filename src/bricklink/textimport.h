@@ -3,12 +3,14 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <QtCore/QString>
 #include <QtCore/QByteArray>
 #include <QtCore/QHash>
 #include <QtCore/QVector>
+#include <QtCore/QStringList>
 
 #include "global.h"
 #include "item.h"
@@ -16,6 +18,8 @@
 
 namespace BrickLink {
 
+class InventoryStore;
+
 class TextImport
 {
 public:
@@ -31,6 +35,7 @@ public:
     };
 
     bool importInventories(std::vector<bool> &processedInvs, ImportInventoriesStep step);
+    void addDownloadedInventory(const Item *item, const QByteArray &xml);
 
     void calculateCategoryRecency();
     void calculatePartsYearUsed();
@@ -57,7 +62,7 @@ private:
     int findCategoryIndex(uint id) const;
 
     void calculateColorPopularity();
-    void addToKnownColors(int itemIndex, int colorIndex);
+    bool addToKnownColors(int itemIndex, int colorIndex);
 
 private:
     Database *m_db;
@@ -67,6 +72,8 @@ private:
     QHash<uint, QVector<Item::ConsistsOf>>   m_consists_of_hash;
     // item-idx -> secs since epoch
     QHash<uint, qint64> m_inventoryLastUpdated;
+    std::unique_ptr<InventoryStore> m_inventoryStore;
+    QStringList m_migratedInventoryFiles;
 };
 
 } // namespace BrickLink
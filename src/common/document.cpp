@@ -14,6 +14,7 @@
 #include <QtGui/QFont>
 #include <QtGui/QFontMetrics>
 #include <QtGui/QGuiApplication>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QAction>
 #include <QDebug>
 
@@ -1550,14 +1551,12 @@ QCoro::Task<> Document::exportBrickLinkXMLToFile()
         fn = fn + u".xml";
 #endif
 
-    const QByteArray xml = BrickLink::IO::toBrickLinkXML(lots).toUtf8();
-
     QSaveFile f(fn);
     f.setDirectWriteFallback(true);
     try {
         if (!f.open(QIODevice::WriteOnly))
             throw Exception(tr("Failed to open file %1 for writing."));
-        if (f.write(xml.data(), xml.size()) != qint64(xml.size()))
+        if (!BrickLink::IO::writeBrickLinkXML(&f, lots))
             throw Exception(tr("Failed to save data to file %1."));
         if (!f.commit())
             throw Exception(tr("Failed to save data to file %1."));
@@ -1893,10 +1892,21 @@ void Document::copyFields(const LotList &srcLots, const DocumentModel::FieldMerg
     std::vector<std::pair<Lot *, Lot>> changes;
     changes.reserve(uint(m_model->lots().size())); // just a guestimate
 
+    QHash<DocumentModel::MergeKey, LotList> srcIndex;
+    for (Lot *srcLot : srcLots) {
+        if (auto key = DocumentModel::mergeKey(*srcLot))
+            srcIndex[*key].append(srcLot);
+    }
+
     model()->beginMacro();
 
     for (Lot *dstLot : m_model->lots()) {
-        for (const auto &srcLot : srcLots) {
+        const auto key = DocumentModel::mergeKey(*dstLot);
+        if (!key)
+            continue;
+        const auto matchingSrcLots = srcIndex.value(*key);
+
+        for (const auto &srcLot : matchingSrcLots) {
             if (!DocumentModel::canLotsBeMerged(*dstLot, *srcLot))
                 continue;
 
@@ -1921,8 +1931,16 @@ void Document::subtractItems(const LotList &subLots)
 
     std::vector<std::pair<Lot *, Lot>> changes;
     changes.reserve(uint(subLots.size() * 2)); // just a guestimate
+    QHash<Lot *, qsizetype> changeIndex; // lot -> its entry in changes
+    changeIndex.reserve(subLots.size() * 2);
     LotList newLots;
 
+    QHash<DocumentModel::MergeKey, LotList> lotIndex;
+    for (Lot *lot : lots) {
+        if (auto key = DocumentModel::mergeKey(*lot))
+            lotIndex[*key].append(lot);
+    }
+
     model()->beginMacro();
 
     for (const Lot *subLot : subLots) {
@@ -1930,17 +1948,21 @@ void Document::subtractItems(const LotList &subLots)
         if (!subLot->item() || !subLot->color() || !qty)
             continue;
 
-        bool hadMatch = false;
+        qsizetype lastChange = -1;
+        const auto key = DocumentModel::mergeKey(*subLot);
+        const auto matchingLots = key ? lotIndex.value(*key) : LotList { };
 
-        for (Lot *lot : lots) {
+        for (Lot *lot : matchingLots) {
             if (!DocumentModel::canLotsBeMerged(*lot, *subLot))
                 continue;
 
-            Lot newItem = *lot;
-            auto change = std::find_if(changes.begin(), changes.end(), [=](const auto &c) {
-                return c.first == lot;
-            });
-            Lot &newItemRef = (change == changes.end()) ? newItem : change->second;
+            auto it = changeIndex.constFind(lot);
+            if (it == changeIndex.cend()) {
+                it = changeIndex.insert(lot, qsizetype(changes.size()));
+                changes.emplace_back(lot, *lot);
+            }
+            lastChange = *it;
+            Lot &newItemRef = changes[size_t(lastChange)].second;
             int qtyInItem = newItemRef.quantity();
 
             if (qtyInItem >= qty) {
@@ -1951,24 +1973,13 @@ void Document::subtractItems(const LotList &subLots)
                 qty -= qtyInItem;
             }
 
-            // make sure that this is the last entry in changes, so we can reference it
-            // easily below, if a qty is left
-            if (&newItemRef == &newItem) {
-                changes.emplace_back(lot, newItem);
-            } else {
-                auto last = std::prev(changes.end());
-                if (last != change)
-                    std::swap(*change, *last);
-            }
-            hadMatch = true;
-
             if (qty == 0)
                 break;
         }
         if (qty) {   // still a qty left
-            if (hadMatch) {
-                Lot &lastChange = changes.back().second;
-                lastChange.setQuantity(lastChange.quantity() - qty);
+            if (lastChange >= 0) {
+                Lot &lastChangeRef = changes[size_t(lastChange)].second;
+                lastChangeRef.setQuantity(lastChangeRef.quantity() - qty);
             } else {
                 auto newLot = new Lot();
                 newLot->setItem(subLot->item());
@@ -2414,67 +2425,252 @@ void Document::cancelBlockingOperation()
 ///////////////////////////////////////////////////////////////////////
 
 
+/* Autosave layout:
+ *   snapshot: magic, version, document state, lot count, (id, lot data) per lot, magic
+ *   journal:  appended records (payload, CRC) with the document state, the (id, lot data) of
+ *             all lots that were added or changed and, if it changed, the new order of lot ids
+ *
+ * Only the first autosave of a document writes a full snapshot. Afterwards only the changes
+ * are appended to the journal, which is merged back into the snapshot on a background thread
+ * once it grows too large. A record with a bad CRC is the result of an interrupted write: it
+ * and everything after it is ignored on restore.
+ */
+
 static const char *autosaveMagic = "||BRICKSTORE AUTOSAVE MAGIC||";
 static const char *autosaveTemplate = "brickstore_%1.autosave";
+static const char *autosaveJournalTemplate = "brickstore_%1.autosave.journal";
+static constexpr qint32 autosaveVersion = 7;
+
+struct AutosaveState
+{
+    QString title;
+    QString filePath;
+    QString currencyCode;
+    QByteArray columnsState;
+    QByteArray sortFilterState;
+    QVector<quint32> order;
+    QHash<quint32, QByteArray> lots;
+};
 
-bool Document::isRestoredFromAutosave() const
+static QByteArray autosaveLotData(const Lot *lot, const Lot *base)
 {
-    return m_restoredFromAutosave;
+    QByteArray ba;
+    QDataStream ds(&ba, QIODevice::WriteOnly);
+    ds << BrickLink::core()->latestChangelogId();
+    lot->save(ds);
+    ds << bool(base);
+    if (base)
+        base->save(ds);
+    return ba;
 }
 
-void Document::deleteAutosave()
+static bool writeAutosaveSnapshot(QIODevice *dev, const AutosaveState &state)
 {
-    QDir temp(QStandardPaths::writableLocation(QStandardPaths::TempLocation));
-    QString filename = QString::fromLatin1(autosaveTemplate).arg(m_uuid.toString());
-    temp.remove(filename);
+    QDataStream ds(dev);
+    ds << QByteArray(autosaveMagic)
+       << autosaveVersion
+       << state.title
+       << state.filePath
+       << state.currencyCode
+       << state.columnsState
+       << state.sortFilterState
+       << qint32(state.order.size());
+
+    for (const quint32 id : state.order)
+        ds << id << state.lots.value(id);
+    ds << QByteArray(autosaveMagic);
+    return (ds.status() == QDataStream::Ok);
+}
+
+static bool readAutosave(const QString &fileName, const QString &journalFileName, AutosaveState &state)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream ds(&f);
+    QByteArray magic;
+    qint32 version = 0;
+    qint32 count = 0;
+
+    ds >> magic >> version;
+    if ((magic != QByteArray(autosaveMagic)) || (version != autosaveVersion))
+        return false;
+    ds >> state.title >> state.filePath >> state.currencyCode >> state.columnsState
+        >> state.sortFilterState >> count;
+
+    for (qint32 i = 0; (i < count) && (ds.status() == QDataStream::Ok); ++i) {
+        quint32 id;
+        QByteArray data;
+        ds >> id >> data;
+        state.order.append(id);
+        state.lots.insert(id, data);
+    }
+    ds >> magic;
+    if ((ds.status() != QDataStream::Ok) || (magic != QByteArray(autosaveMagic)))
+        return false;
+
+    QFile jf(journalFileName);
+    if (jf.open(QIODevice::ReadOnly)) {
+        QDataStream jds(&jf);
+
+        while (!jds.atEnd()) {
+            QByteArray record;
+            quint16 crc;
+            jds >> record >> crc;
+            if ((jds.status() != QDataStream::Ok) || (qChecksum(record) != crc))
+                break;
+
+            AutosaveState recordState;
+            QVector<std::pair<quint32, QByteArray>> changedLots;
+            bool orderChanged = false;
+
+            QDataStream rds(record);
+            rds >> recordState.title >> recordState.filePath >> recordState.currencyCode
+                >> recordState.columnsState >> recordState.sortFilterState >> changedLots
+                >> orderChanged;
+            if (orderChanged)
+                rds >> recordState.order;
+            if (rds.status() != QDataStream::Ok)
+                break;
+
+            state.title = recordState.title;
+            state.filePath = recordState.filePath;
+            state.currencyCode = recordState.currencyCode;
+            state.columnsState = recordState.columnsState;
+            state.sortFilterState = recordState.sortFilterState;
+            if (orderChanged)
+                state.order = recordState.order;
+            for (const auto &[id, data] : std::as_const(changedLots))
+                state.lots.insert(id, data);
+        }
+    }
+
+    // drop the data of lots that were removed in the meantime
+    if (state.lots.size() != state.order.size()) {
+        QHash<quint32, QByteArray> lots;
+        lots.reserve(state.order.size());
+        for (const quint32 id : std::as_const(state.order))
+            lots.insert(id, state.lots.value(id));
+        state.lots = lots;
+    }
+    return true;
+}
+
+bool Document::isRestoredFromAutosave() const
+{
+    return m_restoredFromAutosave;
 }
 
-class AutosaveJob : public QRunnable
+class AutosaveJob
 {
 public:
-    explicit AutosaveJob(Document *document, const QByteArray &contents)
-        : QRunnable()
-        , m_document(document)
+    explicit AutosaveJob(Document *document, AutosaveState &&snapshot)
+        : m_document(document)
+        , m_uuid(document->m_uuid)
+        , m_snapshot(std::move(snapshot))
+        , m_isSnapshot(true)
+    { }
+
+    explicit AutosaveJob(Document *document, const QByteArray &journalRecord)
+        : m_document(document)
         , m_uuid(document->m_uuid)
-        , m_contents(contents)
+        , m_journalRecord(journalRecord)
     { }
 
-    void run() override;
+    void run();
+
 private:
+    static bool compact(const QString &fileName, const QString &journalFileName);
+
     QPointer<Document> m_document;
     const QUuid m_uuid;
-    const QByteArray m_contents;
+    const AutosaveState m_snapshot;
+    const QByteArray m_journalRecord;
+    const bool m_isSnapshot = false;
 };
 
 void AutosaveJob::run()
 {
     QDir temp(QStandardPaths::writableLocation(QStandardPaths::TempLocation));
-    QString fileName = QString::fromLatin1(autosaveTemplate).arg(m_uuid.toString());
-    QString newFileName = fileName + u".new";
-
-    { // reading is cheaper than writing, so check first
-        QFile f(temp.filePath(fileName));
-        if (f.open(QIODevice::ReadOnly)) {
-            if (f.readAll() == m_contents)
-                return;
+    QString fileName = temp.filePath(QString::fromLatin1(autosaveTemplate).arg(m_uuid.toString()));
+    QString journalFileName = temp.filePath(QString::fromLatin1(autosaveJournalTemplate).arg(m_uuid.toString()));
+    bool ok = false;
+
+    if (m_isSnapshot) {
+        QSaveFile f(fileName);
+        if (f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            ok = writeAutosaveSnapshot(&f, m_snapshot) && f.commit();
+        if (ok)
+            QFile::remove(journalFileName);
+        else
+            qWarning() << "Autosave to" << fileName << "failed";
+    } else {
+        qint64 journalSize = 0;
+        {
+            QFile f(journalFileName);
+            if (f.open(QIODevice::WriteOnly | QIODevice::Append)) {
+                QDataStream ds(&f);
+                ds << m_journalRecord << qChecksum(m_journalRecord);
+                ok = (ds.status() == QDataStream::Ok) && f.flush();
+                journalSize = f.size();
+            }
         }
+        if (!ok)
+            qWarning() << "Autosave to" << journalFileName << "failed";
+        else if (journalSize > (QFileInfo(fileName).size() / 2))
+            compact(fileName, journalFileName); // the journal is still valid, if this fails
     }
 
-    QSaveFile f(temp.filePath(fileName));
-    if (f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        f.write(m_contents);
-        if (f.commit()) {
-            QPointer<Document> document = m_document;
-            QMetaObject::invokeMethod(qApp, [=]() {
-                if (document)
-                    document->m_autosaveClean = true;
-            });
-        } else {
-            qWarning() << "Autosave rename from" << newFileName << "to" << fileName << "failed";
+    QPointer<Document> document = m_document;
+    QMetaObject::invokeMethod(qApp, [=]() {
+        if (document) {
+            if (ok)
+                document->m_autosaveClean = true;
+            else
+                document->m_autosaveIds.clear(); // start over with a new snapshot
         }
+    });
+}
+
+bool AutosaveJob::compact(const QString &fileName, const QString &journalFileName)
+{
+    AutosaveState state;
+    if (!readAutosave(fileName, journalFileName, state))
+        return false;
+
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || !writeAutosaveSnapshot(&f, state) || !f.commit()) {
+        qWarning() << "Compacting the autosave journal into" << fileName << "failed";
+        return false;
     }
+    QFile::remove(journalFileName);
+    return true;
 }
 
+void Document::queueAutosaveJob(const std::function<void()> &job) const
+{
+    // the jobs of one document have to run in order: a snapshot removes the journal, so a
+    // journal record that overtook it would be lost. Different documents still run in parallel.
+    if (m_autosaveJobs.isFinished())
+        m_autosaveJobs = QtConcurrent::run(job);
+    else
+        m_autosaveJobs = m_autosaveJobs.then(QThreadPool::globalInstance(), job);
+}
+
+void Document::deleteAutosave()
+{
+    // the files are removed after the pending jobs are done, as these would recreate them
+    queueAutosaveJob([uuid = m_uuid]() {
+        QDir temp(QStandardPaths::writableLocation(QStandardPaths::TempLocation));
+        temp.remove(QString::fromLatin1(autosaveTemplate).arg(uuid.toString()));
+        temp.remove(QString::fromLatin1(autosaveJournalTemplate).arg(uuid.toString()));
+    });
+
+    m_autosaveIds.clear();
+    m_autosaveOrder.clear();
+}
 
 void Document::autosave() const
 {
@@ -2482,28 +2678,61 @@ void Document::autosave() const
         return;
 
     const auto lots = m_model->lots();
-    QByteArray ba;
-    QDataStream ds(&ba, QIODevice::WriteOnly);
-    ds << QByteArray(autosaveMagic)
-       << qint32(6) // version
-       << title()
-       << filePath()
-       << m_model->currencyCode()
-       << saveColumnsState()
-       << model()->saveSortFilterState()
-       << BrickLink::core()->latestChangelogId()
-       << qint32(lots.count());
-
-    for (auto lot : lots) {
-        lot->save(ds);
-        auto base = m_model->differenceBaseLot(lot);
-        ds << bool(base);
-        if (base)
-            base->save(ds);
-    }
-    ds << QByteArray(autosaveMagic);
+    const auto dirtyLots = m_model->takeAutosaveDirtyLots();
+    const bool isSnapshot = m_autosaveIds.isEmpty(); // nothing on disk yet
+
+    QHash<const Lot *, quint32> ids;
+    ids.reserve(lots.size());
+    QVector<quint32> order;
+    order.reserve(lots.size());
+    QVector<std::pair<quint32, QByteArray>> changedLots;
+
+    // only the lots that were added or changed since the last autosave need to be serialized
+    for (const Lot *lot : lots) {
+        quint32 id = m_autosaveIds.value(lot);
+        const bool isNew = !id;
+        if (isNew)
+            id = ++m_autosaveLastId;
+        ids.insert(lot, id);
+        order.append(id);
+
+        if (isSnapshot || isNew || dirtyLots.contains(lot))
+            changedLots.emplace_back(id, autosaveLotData(lot, m_model->differenceBaseLot(lot)));
+    }
+    m_autosaveIds = ids;
+    const bool orderChanged = (order != m_autosaveOrder);
+    m_autosaveOrder = order;
+
+    if (isSnapshot) {
+        AutosaveState state;
+        state.title = title();
+        state.filePath = filePath();
+        state.currencyCode = m_model->currencyCode();
+        state.columnsState = saveColumnsState();
+        state.sortFilterState = model()->saveSortFilterState();
+        state.order = order;
+        state.lots.reserve(changedLots.size());
+        for (auto &[id, data] : changedLots)
+            state.lots.insert(id, std::move(data));
+
+        auto job = std::make_shared<AutosaveJob>(const_cast<Document *>(this), std::move(state));
+        queueAutosaveJob([job]() { job->run(); });
+    } else {
+        QByteArray record;
+        QDataStream ds(&record, QIODevice::WriteOnly);
+        ds << title()
+           << filePath()
+           << m_model->currencyCode()
+           << saveColumnsState()
+           << model()->saveSortFilterState()
+           << changedLots
+           << orderChanged;
+        if (orderChanged)
+            ds << order;
 
-    QThreadPool::globalInstance()->start(new AutosaveJob(const_cast<Document *>(this), ba));
+        auto job = std::make_shared<AutosaveJob>(const_cast<Document *>(this), record);
+        queueAutosaveJob([job]() { job->run(); });
+    }
 }
 
 int Document::restorableAutosaves()
@@ -2520,76 +2749,61 @@ int Document::processAutosaves(AutosaveAction action)
     const auto ondisk = temp.entryList({ QString::fromLatin1(autosaveTemplate).arg(u"*") });
 
     for (const QString &filename : ondisk) {
-        QFile f(temp.filePath(filename));
-        if ((action == AutosaveAction::Restore) && f.open(QIODevice::ReadOnly)) {
-            QByteArray magic;
-            qint32 version;
-            QString savedTitle;
-            QString savedFileName;
-            QString savedCurrencyCode;
-            QByteArray columnState;
-            QByteArray savedSortFilterState;
-            qint32 count = 0;
-            uint startChangelogAt = 0;
-
-            QDataStream ds(&f);
-            ds >> magic >> version;
-            if ((magic != QByteArray(autosaveMagic)) || (version != 6))
-                continue;
-            ds >> savedTitle >> savedFileName >> savedCurrencyCode >> columnState
-                >> savedSortFilterState >> startChangelogAt >> count;
+        const QString journalFilename = filename + u".journal";
+        AutosaveState state;
 
+        if ((action == AutosaveAction::Restore)
+                && readAutosave(temp.filePath(filename), temp.filePath(journalFilename), state)
+                && !state.order.isEmpty()) {
             BrickLink::IO::ParseResult pr;
-            pr.setCurrencyCode(savedCurrencyCode);
-
-            if (count > 0) {
-                for (int i = 0; i < count; ++i) {
-                    if (auto lot = Lot::restore(ds, startChangelogAt)) {
-                        bool hasBase = false;
-                        ds >> hasBase;
-                        if (hasBase) {
-                            if (auto base = Lot::restore(ds, startChangelogAt)) {
-                                pr.addToDifferenceModeBase(lot, *base);
-                                delete base;
-                            } else {
-                                hasBase = false;
-                            }
+            pr.setCurrencyCode(state.currencyCode);
+
+            for (const quint32 id : std::as_const(state.order)) {
+                QDataStream ds(state.lots.value(id));
+                uint startChangelogAt = 0;
+                ds >> startChangelogAt;
+
+                if (auto lot = Lot::restore(ds, startChangelogAt)) {
+                    bool hasBase = false;
+                    ds >> hasBase;
+                    if (hasBase) {
+                        if (auto base = Lot::restore(ds, startChangelogAt)) {
+                            pr.addToDifferenceModeBase(lot, *base);
+                            delete base;
+                        } else {
+                            hasBase = false;
                         }
-                        if (!hasBase)
-                            pr.addToDifferenceModeBase(lot, *lot);
-                        pr.addLot(std::move(lot));
                     }
+                    if (!hasBase)
+                        pr.addToDifferenceModeBase(lot, *lot);
+                    pr.addLot(std::move(lot));
                 }
-                ds >> magic;
-
-                if (magic == QByteArray(autosaveMagic)) {
-                    QString restoredTag = tr("RESTORED", "Tag for document restored from autosave");
-
-                    // Document owns the items now
-                    DocumentIO::BsxContents bsx;
-                    auto model = new DocumentModel(std::move(pr), true /*mark as modified*/);
-                    model->restoreSortFilterState(savedSortFilterState);
-                    auto *doc = new Document(model, columnState, true /* is autosave restore*/);
-
-                    if (!savedFileName.isEmpty()) {
-                        QFileInfo fi(savedFileName);
-                        QString newFileName = fi.dir().filePath(restoredTag + u" " + fi.fileName());
-                        try {
-                            doc->saveToFile(newFileName);
-                        } catch (const Exception &) {
-                            // not really much we can do here
-                        }
-                    } else {
-                        doc->setTitle(restoredTag + u" " + savedTitle);
-                    }
-                    QMetaObject::invokeMethod(doc, &Document::requestActivation, Qt::QueuedConnection);
+            }
+
+            QString restoredTag = tr("RESTORED", "Tag for document restored from autosave");
+
+            // Document owns the items now
+            auto model = new DocumentModel(std::move(pr), true /*mark as modified*/);
+            model->restoreSortFilterState(state.sortFilterState);
+            auto *doc = new Document(model, state.columnsState, true /* is autosave restore*/);
 
-                    ++restoredCount;
+            if (!state.filePath.isEmpty()) {
+                QFileInfo fi(state.filePath);
+                QString newFileName = fi.dir().filePath(restoredTag + u" " + fi.fileName());
+                try {
+                    doc->saveToFile(newFileName);
+                } catch (const Exception &) {
+                    // not really much we can do here
                 }
+            } else {
+                doc->setTitle(restoredTag + u" " + state.title);
             }
-            f.close();
+            QMetaObject::invokeMethod(doc, &Document::requestActivation, Qt::QueuedConnection);
+
+            ++restoredCount;
         }
-        f.remove();
+        temp.remove(filename);
+        temp.remove(journalFilename);
     }
     return restoredCount;
 }
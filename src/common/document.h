@@ -11,6 +11,7 @@
 #include <QMultiHash>
 #include <QModelIndex>
 #include <QPointer>
+#include <QFuture>
 
 #include <QCoro/QCoroTask>
 
@@ -288,6 +289,7 @@ private:
     void setColumnLayoutDirect(QVector<ColumnData> &columnData);
 
     void autosave() const;
+    void queueAutosaveJob(const std::function<void()> &job) const;
     void deleteAutosave();
 
 private:
@@ -331,6 +333,10 @@ private:
     QUuid                 m_uuid;  // for autosave
     QTimer                m_autosaveTimer;
     mutable bool          m_autosaveClean = true;
+    mutable QHash<const Lot *, quint32> m_autosaveIds; // ids of the lots in the autosave files
+    mutable QVector<quint32> m_autosaveOrder;
+    mutable quint32       m_autosaveLastId = 0;
+    mutable QFuture<void> m_autosaveJobs; // the last queued autosave job
     bool                  m_restoredFromAutosave = false;
 
     friend class AutosaveJob;
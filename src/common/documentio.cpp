@@ -1,22 +1,25 @@
 // Copyright (C) 2004-2023 Robert Griebl
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <atomic>
 #include <memory>
 #include <cmath>
+#include <vector>
 
 #include <QtGui/QGuiApplication>
 #include <QtGui/QCursor>
 #include <QFileInfo>
 #include <QDir>
 #include <QStringView>
-#include <QTemporaryFile>
+#include <QTextStream>
 #include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 #include <QDebug>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include "utility/exception.h"
 #include "utility/utility.h"
 #include "utility/stopwatch.h"
+#include "utility/xmlhelpers.h"
 #include "minizip/minizip.h"
 #include "bricklink/cart.h"
 #include "bricklink/core.h"
@@ -171,36 +174,30 @@ QCoro::Task<Document *> DocumentIO::importLDrawModel(QString fileName)
         co_return nullptr;
 
     try {
-        std::unique_ptr<QFile> f;
+        std::unique_ptr<QIODevice> f;
         bool isStudio = fn.endsWith(u".io");
 
         if (isStudio) {
-            stopwatch unpack("unpack/decrypt studio zip");
+            // this is a zip file - the encrypted model2.ldr (pw: soho0909) is decrypted and
+            // decompressed on the fly while parsing
 
-            // this is a zip file - unpack the encrypted model2.ldr (pw: soho0909)
-
-            f = std::make_unique<QTemporaryFile>();
-
-            if (f->open(QIODevice::ReadWrite)) {
-                try {
-                    MiniZip::unzip(fn, f.get(), "model2.ldr", "soho0909");
-                    f->close();
-                } catch (const Exception &e) {
-                    throw Exception(tr("Could not open the Studio ZIP container") + u": " + e.errorString());
-                }
+            try {
+                f = MiniZip::openForReading(fn, "model2.ldr", "soho0909");
+            } catch (const Exception &e) {
+                throw Exception(tr("Could not open the Studio ZIP container") + u": " + e.errorString());
             }
         } else {
-            f = std::make_unique<QFile>(fn);
+            auto file = std::make_unique<QFile>(fn);
+            if (!file->open(QIODevice::ReadOnly))
+                throw Exception(file.get(), tr("Could not open LDraw file for reading"));
+            f = std::move(file);
         }
 
-        if (!f->open(QIODevice::ReadOnly))
-            throw Exception(f.get(), tr("Could not open LDraw file for reading"));
-
         QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
         BrickLink::IO::ParseResult pr;
 
-        bool b = DocumentIO::parseLDrawModel(f.get(), isStudio, pr);
+        bool b = DocumentIO::parseLDrawModel(f.get(), QFileInfo(fn).absolutePath(), isStudio, pr);
         Document *document = nullptr;
 
         QGuiApplication::restoreOverrideCursor();
@@ -219,7 +216,55 @@ QCoro::Task<Document *> DocumentIO::importLDrawModel(QString fileName)
     co_return nullptr;
 }
 
-bool DocumentIO::parseLDrawModel(QFile *f, bool isStudio, BrickLink::IO::ParseResult &pr)
+// An MPD file is read exactly once: every "0 FILE" block is recorded in this index together
+// with the type-1 references it contains. Resolving sub-models later on is just a hash lookup,
+// so we neither have to rescan the file per sub-model nor need a seekable device: Studio
+// models are streamed straight out of their (encrypted) ZIP container.
+
+struct DocumentIO::LDrawModelIndex
+{
+    struct Reference
+    {
+        uint colorId;
+        QString partName; // lower-case
+    };
+    struct SubModel
+    {
+        QString name;     // lower-case, empty for the implicit main model of plain LDraw files
+        QVector<Reference> references;
+    };
+
+    QString dir;
+    bool isMpd = false;
+    QVector<SubModel> subModels;
+    QHash<QString, qsizetype> subModelIndex;
+
+    const SubModel *find(const QString &modelName) const
+    {
+        if (subModels.isEmpty())
+            return nullptr;
+        if (modelName.isEmpty() || !isMpd)
+            return &subModels.constFirst();
+        auto it = subModelIndex.constFind(modelName);
+        return (it != subModelIndex.cend()) ? &subModels.at(*it) : nullptr;
+    }
+};
+
+static QStringView nextLDrawToken(QStringView &line)
+{
+    qsizetype start = 0;
+    while ((start < line.size()) && line.at(start).isSpace())
+        ++start;
+    qsizetype end = start;
+    while ((end < line.size()) && !line.at(end).isSpace())
+        ++end;
+    QStringView token = line.sliced(start, end - start);
+    line = line.sliced(end);
+    return token;
+}
+
+bool DocumentIO::parseLDrawModel(QIODevice *f, const QString &dir, bool isStudio,
+                                 BrickLink::IO::ParseResult &pr)
 {
     QVector<QString> recursion_detection;
     QHash<QString, QVector<Lot *>> subCache;
@@ -228,7 +273,10 @@ bool DocumentIO::parseLDrawModel(QFile *f, bool isStudio, BrickLink::IO::ParseRe
     {
         stopwatch parse("parse ldraw model");
 
-        if (!parseLDrawModelInternal(f, isStudio, QString(), ldrawLots, subCache, recursion_detection))
+        LDrawModelIndex index;
+        if (!indexLDrawModel(f, dir, index))
+            return false;
+        if (!parseLDrawModelInternal(index, isStudio, QString(), ldrawLots, subCache, recursion_detection))
             return false;
     }
     {
@@ -279,8 +327,63 @@ bool DocumentIO::parseLDrawModel(QFile *f, bool isStudio, BrickLink::IO::ParseRe
     return true;
 }
 
-bool DocumentIO::parseLDrawModelInternal(QFile *f, bool isStudio, const QString &modelName,
-                                         QVector<Lot *> &lots,
+bool DocumentIO::indexLDrawModel(QIODevice *in, const QString &dir, LDrawModelIndex &index)
+{
+    if (!in || !in->isOpen())
+        return false;
+
+    index.dir = dir;
+    index.subModels.resize(1); // the implicit main model, renamed by the first "0 FILE"
+    auto *current = &index.subModels.last();
+
+    QTextStream ts(in);
+    QString line;
+
+    while (ts.readLineInto(&line)) {
+        QStringView rest { line };
+        const auto type = nextLDrawToken(rest);
+
+        if (type == u"0") {
+            if (nextLDrawToken(rest) != u"FILE")
+                continue;
+            const QString name = rest.trimmed().toString().toLower();
+            if (name.isEmpty())
+                continue;
+
+            if (!index.isMpd) {
+                current->name = name;
+            } else {
+                index.subModels.append({ name, { } });
+                current = &index.subModels.last();
+            }
+            index.isMpd = true;
+            // the first occurrence wins, just like a sequential search would
+            if (!index.subModelIndex.contains(name))
+                index.subModelIndex.insert(name, index.subModels.size() - 1);
+
+        } else if (type == u"1") {
+            const uint colid = nextLDrawToken(rest).toUInt();
+
+            // skip the 12 position and transformation matrix values
+            int matrixValues = 0;
+            while ((matrixValues < 12) && !nextLDrawToken(rest).isEmpty())
+                ++matrixValues;
+            if (matrixValues < 12)
+                continue;
+
+            const QString partname = rest.trimmed().toString().toLower();
+            if (!partname.isEmpty())
+                current->references.append({ colid, partname });
+        }
+    }
+    // QTextStream treats a read error like the end of the file: don't import a truncated model
+    if (!in->atEnd())
+        throw ParseException(in, qPrintable(in->errorString()));
+    return true;
+}
+
+bool DocumentIO::parseLDrawModelInternal(const LDrawModelIndex &index, bool isStudio,
+                                         const QString &modelName, QVector<Lot *> &lots,
                                          QHash<QString, QVector<Lot *>> &subCache,
                                          QVector<QString> &recursionDetection)
 {
@@ -292,145 +395,278 @@ bool DocumentIO::parseLDrawModelInternal(QFile *f, bool isStudio, const QString
 
     if (recursionDetection.contains(modelName))
         return false;
-    recursionDetection.append(modelName);
 
-    QStringList searchpath;
-    bool is_mpd = false;
-    int current_mpd_index = -1;
-    QString current_mpd_model;
-    bool is_mpd_model_found = false;
+    const auto *subModel = index.find(modelName);
+    if (!subModel)
+        return false;
 
-    searchpath.append(QFileInfo(*f).dir().absolutePath());
+    recursionDetection.append(modelName);
 
-    if (f->isOpen()) {
-        QTextStream in(f);
-        QString line;
+    for (const auto &ref : subModel->references) {
+        const QString &partname = ref.partName;
+        const uint colid = ref.colorId;
 
-        while (!(line = in.readLine()).isNull()) {
-            if (line.isEmpty())
-                continue;
+        QString partid = partname;
+        partid.truncate(partid.lastIndexOf(u'.'));
 
-            if (line.at(0) == u'0') {
-                const auto split = QStringView{line}.split(u' ', Qt::SkipEmptyParts);
-                auto strPosition = [line](QStringView sv) { return sv.constData() - line.constData(); };
+        const BrickLink::Item *itemp = BrickLink::core()->item('P', partid.toLatin1());
 
-                if ((split.count() >= 2) && (split.at(1) == u"FILE")) {
-                    is_mpd = true;
-                    current_mpd_model = line.mid(strPosition(split.at(2))).toLower();
-                    current_mpd_index++;
+        if (!itemp && !partname.endsWith(u".dat")) {
+            bool got_subfile = false;
+            QVector<Lot *> subLots;
 
-                    if (is_mpd_model_found)
-                        break;
+            if (index.isMpd)
+                got_subfile = parseLDrawModelInternal(index, isStudio, partname, subLots, subCache, recursionDetection);
 
-                    if ((current_mpd_model == modelName.toLower()) || (modelName.isEmpty() && (current_mpd_index == 0)))
-                        is_mpd_model_found = true;
+            if (!got_subfile) {
+                QFile subf(index.dir + u'/' + partname);
 
-                    if (f->isSequential())
-                        return false; // we need to seek!
+                if (subf.open(QIODevice::ReadOnly)) {
+                    LDrawModelIndex subIndex;
+                    if (indexLDrawModel(&subf, QFileInfo(subf).dir().absolutePath(), subIndex))
+                        (void) parseLDrawModelInternal(subIndex, isStudio, partname, subLots, subCache, recursionDetection);
+
+                    got_subfile = true;
                 }
+            }
+            if (got_subfile) {
+                subCache.insert(partname, subLots);
+                lots.append(subLots);
+                continue;
+            }
+        }
 
-            } else if (line.at(0) == u'1') {
-                if (is_mpd && !is_mpd_model_found)
-                    continue;
-                const auto split = QStringView{line}.split(u' ', Qt::SkipEmptyParts);
-                auto strPosition = [line](QStringView sv) { return sv.constData() - line.constData(); };
+        const BrickLink::Color *colp = isStudio ? BrickLink::core()->color(colid)
+                                                : BrickLink::core()->colorFromLDrawId(int(colid));
 
-                if (split.count() >= 15) {
-                    uint colid = split.at(1).toUInt();
-                    QString partname = line.mid(strPosition(split.at(14))).toLower();
+        if (colp && (colp->id() == BrickLink::Color::InvalidId)) // LDraw-only color
+            colp = nullptr;
 
-                    QString partid = partname;
-                    partid.truncate(partid.lastIndexOf(u'.'));
+        auto *lot = new Lot(itemp, colp);
+        lot->setQuantity(1);
 
-                    const BrickLink::Item *itemp = BrickLink::core()->item('P', partid.toLatin1());
+        if (!colp || !itemp) {
+            auto *inc = new BrickLink::Incomplete;
 
-                    if (!itemp && !partname.endsWith(u".dat")) {
-                        bool got_subfile = false;
-                        QVector<Lot *> subLots;
+            if (!itemp) {
+                inc->m_item_id = partid.toLatin1();
+                inc->m_itemtype_id = 'P';
+                inc->m_itemtype_name = u"Part"_qs;
+            }
+            if (!colp) {
+                if (isStudio)
+                    inc->m_color_id = colid;
+                else
+                    inc->m_color_name = u"LDraw #"_qs + QString::number(colid);
+            }
+            lot->setIncomplete(inc);
+        }
+        lots.append(lot);
+    }
 
-                        if (is_mpd) {
-                            qint64 oldpos = f->pos();
-                            f->seek(0);
+    recursionDetection.removeLast();
+    return true;
+}
 
-                            got_subfile = parseLDrawModelInternal(f, isStudio, partname, subLots, subCache, recursionDetection);
 
-                            f->seek(oldpos);
-                        }
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
 
-                        if (!got_subfile) {
-                            for (const auto &path : std::as_const(searchpath)) {
-                                QFile subf(path + u'/' + partname);
 
-                                if (subf.open(QIODevice::ReadOnly)) {
 
-                                    (void) parseLDrawModelInternal(&subf, isStudio, partname, subLots, subCache, recursionDetection);
 
-                                    got_subfile = true;
-                                    break;
-                                }
-                            }
-                        }
-                        if (got_subfile) {
-                            subCache.insert(partname, subLots);
-                            lots.append(subLots);
-                            continue;
-                        }
-                    }
+namespace {
 
-                    const BrickLink::Color *colp = isStudio ? BrickLink::core()->color(colid)
-                                                            : BrickLink::core()->colorFromLDrawId(int(colid));
+struct BsxItem
+{
+    std::unique_ptr<Lot> lot;
+    std::unique_ptr<Lot> base;
+    bool hasBaseValues = false;
+    QXmlStreamAttributes baseValues;
+    QVariant legacyOrigPrice;
+    QVariant legacyOrigQty;
+    BrickLink::Core::ResolveResult result = BrickLink::Core::ResolveResult::Direct;
+};
 
-                    if (colp && (colp->id() == BrickLink::Color::InvalidId)) // LDraw-only color
-                        colp = nullptr;
+struct BsxBatch
+{
+    QByteArray xml; // only set, if the batch was split off by XmlHelpers::splitRecords()
+    std::vector<BsxItem> items;
+};
 
-                    auto *lot = new Lot(itemp, colp);
-                    lot->setQuantity(1);
+using BsxTagHash = QHash<QStringView, std::function<void(Lot *, const QString &value)>>;
 
-                    if (!colp || !itemp) {
-                        auto *inc = new BrickLink::Incomplete;
+const BsxTagHash &bsxTagHash()
+{
+    static const BsxTagHash tagHash {
+        { u"ItemID",       [](auto *lot, auto &v) { lot->isIncomplete()->m_item_id = v.toLatin1(); } },
+        { u"ColorID",      [](auto *lot, auto &v) { lot->isIncomplete()->m_color_id = v.toUInt(); } },
+        { u"CategoryID",   [](auto *lot, auto &v) { lot->isIncomplete()->m_category_id = v.toUInt(); } },
+        { u"ItemTypeID",   [](auto *lot, auto &v) { lot->isIncomplete()->m_itemtype_id = BrickLink::ItemType::idFromFirstCharInString(v); } },
+        { u"ItemName",     [](auto *lot, auto &v) { lot->isIncomplete()->m_item_name = v; } },
+        { u"ColorName",    [](auto *lot, auto &v) { lot->isIncomplete()->m_color_name = v; } },
+        { u"CategoryName", [](auto *lot, auto &v) { lot->isIncomplete()->m_category_name = v; } },
+        { u"ItemTypeName", [](auto *lot, auto &v) { lot->isIncomplete()->m_itemtype_name = v; } },
+        { u"Price",        [](auto *lot, auto &v) { lot->setPrice(Utility::fixFinite(v.toDouble())); } },
+        { u"Bulk",         [](auto *lot, auto &v) { lot->setBulkQuantity(v.toInt()); } },
+        { u"Qty",          [](auto *lot, auto &v) { lot->setQuantity(v.toInt()); } },
+        { u"Sale",         [](auto *lot, auto &v) { lot->setSale(v.toInt()); } },
+        { u"Comments",     [](auto *lot, auto &v) { lot->setComments(v); } },
+        { u"Remarks",      [](auto *lot, auto &v) { lot->setRemarks(v); } },
+        { u"TQ1",          [](auto *lot, auto &v) { lot->setTierQuantity(0, v.toInt()); } },
+        { u"TQ2",          [](auto *lot, auto &v) { lot->setTierQuantity(1, v.toInt()); } },
+        { u"TQ3",          [](auto *lot, auto &v) { lot->setTierQuantity(2, v.toInt()); } },
+        { u"TP1",          [](auto *lot, auto &v) { lot->setTierPrice(0, Utility::fixFinite(v.toDouble())); } },
+        { u"TP2",          [](auto *lot, auto &v) { lot->setTierPrice(1, Utility::fixFinite(v.toDouble())); } },
+        { u"TP3",          [](auto *lot, auto &v) { lot->setTierPrice(2, Utility::fixFinite(v.toDouble())); } },
+        { u"LotID",        [](auto *lot, auto &v) { lot->setLotId(v.toUInt()); } },
+        { u"Retain",       [](auto *lot, auto &v) { lot->setRetain(v.isEmpty() || (v == u"Y")); } },
+        { u"Reserved",     [](auto *lot, auto &v) { lot->setReserved(v); } },
+        { u"TotalWeight",  [](auto *lot, auto &v) { lot->setTotalWeight(Utility::fixFinite(v.toDouble())); } },
+        { u"Cost",         [](auto *lot, auto &v) { lot->setCost(Utility::fixFinite(v.toDouble())); } },
+        { u"Condition",    [](auto *lot, auto &v) {
+            lot->setCondition(v == u"N" ? BrickLink::Condition::New
+                                        : BrickLink::Condition::Used); } },
+        { u"SubCondition", [](auto *lot, auto &v) {
+            // 'M' for sealed is an historic artefact. BL called this 'MISB' back in the day
+            lot->setSubCondition(v == u"C" ? BrickLink::SubCondition::Complete :
+                                 v == u"I" ? BrickLink::SubCondition::Incomplete :
+                                 v == u"M" ? BrickLink::SubCondition::Sealed
+                                           : BrickLink::SubCondition::None); } },
+        { u"Status",       [](auto *lot, auto &v) {
+            lot->setStatus(v == u"X" ? BrickLink::Status::Exclude :
+                           v == u"I" ? BrickLink::Status::Include :
+                           v == u"E" ? BrickLink::Status::Extra
+                                     : BrickLink::Status::Include); } },
+        { u"Stockroom",    [](auto *lot, auto &v) {
+            lot->setStockroom(v == u"A" || v.isEmpty() ? BrickLink::Stockroom::A :
+                              v == u"B" ? BrickLink::Stockroom::B :
+                              v == u"C" ? BrickLink::Stockroom::C
+                                        : BrickLink::Stockroom::None); } },
+        { u"MarkerText",   [](auto *lot, auto &v) { lot->setMarkerText(v); } },
+        { u"MarkerColor",  [](auto *lot, auto &v) { lot->setMarkerColor(QColor(v)); } },
+        { u"DateAdded",    [](auto *lot, auto &v) {
+            if (!v.isEmpty())
+                lot->setDateAdded(QDateTime::fromString(v, Qt::ISODate)); } },
+        { u"DateLastSold", [](auto *lot, auto &v) {
+            if (!v.isEmpty())
+                lot->setDateLastSold(QDateTime::fromString(v, Qt::ISODate)); } },
+    };
+    return tagHash;
+}
 
-                        if (!itemp) {
-                            inc->m_item_id = partid.toLatin1();
-                            inc->m_itemtype_id = 'P';
-                            inc->m_itemtype_name = u"Part"_qs;
-                        }
-                        if (!colp) {
-                            if (isStudio)
-                                inc->m_color_id = colid;
-                            else
-                                inc->m_color_name = u"LDraw #"_qs + QString::number(colid);
-                        }
-                        lot->setIncomplete(inc);
-                    }
-                    lots.append(lot);
-                }
-            }
+// expects the reader to be positioned on an Item start element
+BsxItem parseBsxItem(QXmlStreamReader &xml)
+{
+    const auto &tagHash = bsxTagHash();
+
+    BsxItem item;
+    item.lot.reset(new Lot());
+    item.lot->setIncomplete(new BrickLink::Incomplete);
+
+    while (xml.readNextStartElement()) {
+        const auto tag = xml.name();
+
+        if (tag == u"DifferenceBaseValues") {
+            item.hasBaseValues = true;
+            item.baseValues = xml.attributes();
+            xml.skipCurrentElement();
+        } else if (tag == u"OrigPrice") {
+            item.legacyOrigPrice.setValue(Utility::fixFinite(xml.readElementText().toDouble()));
+        } else if (tag == u"OrigQty") {
+            item.legacyOrigQty.setValue(xml.readElementText().toInt());
+        } else if (auto it = tagHash.constFind(tag); it != tagHash.cend()) {
+            (*it)(item.lot.get(), xml.readElementText());
+        } else {
+            xml.skipCurrentElement();
         }
     }
-
-    recursionDetection.removeLast();
-
-    return is_mpd ? is_mpd_model_found : true;
+    return item;
 }
 
+// only touches the item itself, so this can run in parallel
+void resolveBsxItem(BsxItem &item, uint startAtChangelogId, const QDateTime &creationTime)
+{
+    Lot *lot = item.lot.get();
+    item.result = BrickLink::core()->resolveIncomplete(lot, startAtChangelogId, creationTime);
+
+    // convert the legacy OrigQty / OrigPrice fields
+    auto &baseValues = item.baseValues;
+    if (!item.hasBaseValues && (item.legacyOrigPrice.isValid() || item.legacyOrigQty.isValid())) {
+        if (item.legacyOrigQty.isValid())
+            baseValues.append(u"Qty"_qs, QString::number(item.legacyOrigQty.toInt()));
+        if (!item.legacyOrigPrice.isNull())
+            baseValues.append(u"Price"_qs, QString::number(item.legacyOrigPrice.toDouble(), 'f', 3));
+    }
 
-///////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////
-
+    item.base.reset(new Lot(*lot));
+    if (!baseValues.isEmpty()) {
+        const auto &tagHash = bsxTagHash();
+        Lot &base = *item.base;
+        base.setIncomplete(new BrickLink::Incomplete);
 
+        for (const auto &attr : std::as_const(baseValues)) {
+            auto it = tagHash.constFind(attr.name());
+            if (it != tagHash.cend())
+                (*it)(&base, attr.value().toString());
+        }
+        if (BrickLink::core()->resolveIncomplete(&base, startAtChangelogId, creationTime)
+            == BrickLink::Core::ResolveResult::Fail) {
+            if (!base.item() && lot->item())
+                base.setItem(lot->item());
+            if (!base.color() && lot->color())
+                base.setColor(lot->color());
+            base.setIncomplete(nullptr);
+        }
+    }
+}
 
+} // namespace
 
 Document *DocumentIO::parseBsxInventory(QFile *in)
 {
     //stopwatch loadBsxWatch("Load BSX");
 
     Q_ASSERT(in);
-    QXmlStreamReader xml(in);
+    const QByteArray data = in->readAll();
     BsxContents bsx;
     QDateTime creationTime = in->fileTime(QFile::FileModificationTime);
     uint startAtChangelogId = 0;
 
+    // The Item records are cut out of the file and parsed in parallel batches, while the
+    // remaining skeleton is parsed sequentially. Files that do not follow the standard layout
+    // (or have XML errors in their Items) are parsed sequentially as a whole.
+    static constexpr qsizetype BatchSize = 500;
+    std::vector<BsxBatch> batches;
+
+    auto split = XmlHelpers::splitRecords(data, "Inventory", "Item", BatchSize);
+    if (split) {
+        batches.resize(size_t(split->batches.size()));
+        for (size_t i = 0; i < batches.size(); ++i)
+            batches[i].xml = split->batches.at(qsizetype(i));
+
+        std::atomic<bool> failed = false;
+        QtConcurrent::blockingMap(batches, [&failed](BsxBatch &batch) {
+            QXmlStreamReader xml(batch.xml);
+            if (xml.readNextStartElement()) {
+                batch.items.reserve(BatchSize);
+                while (xml.readNextStartElement())
+                    batch.items.push_back(parseBsxItem(xml));
+            }
+            if (xml.hasError())
+                failed = true;
+            batch.xml.clear();
+        });
+
+        if (failed) {
+            batches.clear();
+            split.reset();
+        }
+    }
+
+    QXmlStreamReader xml(split ? split->skeleton : data);
+
     try {
         bsx.setCurrencyCode(u"$$$"_qs);  // flag as legacy currency
 
@@ -460,132 +696,13 @@ Document *DocumentIO::parseBsxInventory(QFile *in)
         };
 
         auto parseInventory = [&]() {
-            QVariant legacyOrigPrice, legacyOrigQty;
-            bool hasBaseValues = false;
-            QXmlStreamAttributes baseValues;
-
-            const QHash<QStringView, std::function<void(Lot *, const QString &value)>> tagHash {
-            { u"ItemID",       [](auto *lot, auto &v) { lot->isIncomplete()->m_item_id = v.toLatin1(); } },
-            { u"ColorID",      [](auto *lot, auto &v) { lot->isIncomplete()->m_color_id = v.toUInt(); } },
-            { u"CategoryID",   [](auto *lot, auto &v) { lot->isIncomplete()->m_category_id = v.toUInt(); } },
-            { u"ItemTypeID",   [](auto *lot, auto &v) { lot->isIncomplete()->m_itemtype_id = BrickLink::ItemType::idFromFirstCharInString(v); } },
-            { u"ItemName",     [](auto *lot, auto &v) { lot->isIncomplete()->m_item_name = v; } },
-            { u"ColorName",    [](auto *lot, auto &v) { lot->isIncomplete()->m_color_name = v; } },
-            { u"CategoryName", [](auto *lot, auto &v) { lot->isIncomplete()->m_category_name = v; } },
-            { u"ItemTypeName", [](auto *lot, auto &v) { lot->isIncomplete()->m_itemtype_name = v; } },
-            { u"Price",        [](auto *lot, auto &v) { lot->setPrice(Utility::fixFinite(v.toDouble())); } },
-            { u"Bulk",         [](auto *lot, auto &v) { lot->setBulkQuantity(v.toInt()); } },
-            { u"Qty",          [](auto *lot, auto &v) { lot->setQuantity(v.toInt()); } },
-            { u"Sale",         [](auto *lot, auto &v) { lot->setSale(v.toInt()); } },
-            { u"Comments",     [](auto *lot, auto &v) { lot->setComments(v); } },
-            { u"Remarks",      [](auto *lot, auto &v) { lot->setRemarks(v); } },
-            { u"TQ1",          [](auto *lot, auto &v) { lot->setTierQuantity(0, v.toInt()); } },
-            { u"TQ2",          [](auto *lot, auto &v) { lot->setTierQuantity(1, v.toInt()); } },
-            { u"TQ3",          [](auto *lot, auto &v) { lot->setTierQuantity(2, v.toInt()); } },
-            { u"TP1",          [](auto *lot, auto &v) { lot->setTierPrice(0, Utility::fixFinite(v.toDouble())); } },
-            { u"TP2",          [](auto *lot, auto &v) { lot->setTierPrice(1, Utility::fixFinite(v.toDouble())); } },
-            { u"TP3",          [](auto *lot, auto &v) { lot->setTierPrice(2, Utility::fixFinite(v.toDouble())); } },
-            { u"LotID",        [](auto *lot, auto &v) { lot->setLotId(v.toUInt()); } },
-            { u"Retain",       [](auto *lot, auto &v) { lot->setRetain(v.isEmpty() || (v == u"Y")); } },
-            { u"Reserved",     [](auto *lot, auto &v) { lot->setReserved(v); } },
-            { u"TotalWeight",  [](auto *lot, auto &v) { lot->setTotalWeight(Utility::fixFinite(v.toDouble())); } },
-            { u"Cost",         [](auto *lot, auto &v) { lot->setCost(Utility::fixFinite(v.toDouble())); } },
-            { u"Condition",    [](auto *lot, auto &v) {
-                lot->setCondition(v == u"N" ? BrickLink::Condition::New
-                                            : BrickLink::Condition::Used); } },
-            { u"SubCondition", [](auto *lot, auto &v) {
-                // 'M' for sealed is an historic artefact. BL called this 'MISB' back in the day
-                lot->setSubCondition(v == u"C" ? BrickLink::SubCondition::Complete :
-                                     v == u"I" ? BrickLink::SubCondition::Incomplete :
-                                     v == u"M" ? BrickLink::SubCondition::Sealed
-                                               : BrickLink::SubCondition::None); } },
-            { u"Status",       [](auto *lot, auto &v) {
-                lot->setStatus(v == u"X" ? BrickLink::Status::Exclude :
-                               v == u"I" ? BrickLink::Status::Include :
-                               v == u"E" ? BrickLink::Status::Extra
-                                         : BrickLink::Status::Include); } },
-            { u"Stockroom",    [](auto *lot, auto &v) {
-                lot->setStockroom(v == u"A" || v.isEmpty() ? BrickLink::Stockroom::A :
-                                  v == u"B" ? BrickLink::Stockroom::B :
-                                  v == u"C" ? BrickLink::Stockroom::C
-                                            : BrickLink::Stockroom::None); } },
-            { u"MarkerText",   [](auto *lot, auto &v) { lot->setMarkerText(v); } },
-            { u"MarkerColor",  [](auto *lot, auto &v) { lot->setMarkerColor(QColor(v)); } },
-            { u"DateAdded",    [](auto *lot, auto &v) {
-                if (!v.isEmpty())
-                    lot->setDateAdded(QDateTime::fromString(v, Qt::ISODate)); } },
-            { u"DateLastSold", [](auto *lot, auto &v) {
-                if (!v.isEmpty())
-                    lot->setDateLastSold(QDateTime::fromString(v, Qt::ISODate)); } },
-            { u"OrigPrice",    [&legacyOrigPrice](auto *lot, auto &v) {
-                Q_UNUSED(lot)
-                legacyOrigPrice.setValue(Utility::fixFinite(v.toDouble()));
-            } },
-            { u"OrigQty",      [&legacyOrigQty](auto *lot, auto &v) {
-                Q_UNUSED(lot)
-                legacyOrigQty.setValue(v.toInt());
-            } }, };
-
             while (xml.readNextStartElement()) {
                 if (xml.name() != u"Item")
                     throw Exception("Expected Item element, but got: %1").arg(xml.name());
 
-                auto lot = new Lot();
-                lot->setIncomplete(new BrickLink::Incomplete);
-                baseValues.clear();
-
-                while (xml.readNextStartElement()) {
-                    auto tag = xml.name();
-
-                    if (tag != u"DifferenceBaseValues") {
-                        auto it = tagHash.find(tag);
-                        if (it != tagHash.end())
-                            (*it)(lot, xml.readElementText());
-                        else
-                            xml.skipCurrentElement();
-                    } else {
-                        hasBaseValues = true;
-                        baseValues = xml.attributes();
-                        xml.skipCurrentElement();
-                    }
-                }
-
-                switch (BrickLink::core()->resolveIncomplete(lot, startAtChangelogId, creationTime)) {
-                case BrickLink::Core::ResolveResult::Fail: bsx.incInvalidLotCount(); break;
-                case BrickLink::Core::ResolveResult::ChangeLog: bsx.incFixedLotCount(); break;
-                default: break;
-                }
-
-                // convert the legacy OrigQty / OrigPrice fields
-                if (!hasBaseValues && (legacyOrigPrice.isValid() || legacyOrigQty.isValid())) {
-                    if (legacyOrigQty.isValid())
-                        baseValues.append(u"Qty"_qs, QString::number(legacyOrigQty.toInt()));
-                    if (!legacyOrigPrice.isNull())
-                        baseValues.append(u"Price"_qs, QString::number(legacyOrigPrice.toDouble(), 'f', 3));
-                }
-
-                Lot base = *lot;
-                if (!baseValues.isEmpty()) {
-                    base.setIncomplete(new BrickLink::Incomplete);
-
-                    for (const auto &attr : std::as_const(baseValues)) {
-                        auto it = tagHash.find(attr.name());
-                        if (it != tagHash.end()) {
-                            (*it)(&base, attr.value().toString());
-                        }
-                    }
-                    if (BrickLink::core()->resolveIncomplete(&base, startAtChangelogId, creationTime)
-                        == BrickLink::Core::ResolveResult::Fail) {
-                        if (!base.item() && lot->item())
-                            base.setItem(lot->item());
-                        if (!base.color() && lot->color())
-                            base.setColor(lot->color());
-                        base.setIncomplete(nullptr);
-                    }
-                }
-                bsx.addToDifferenceModeBase(lot, base);
-
-                bsx.addLot(std::move(lot));
+                if (batches.empty() || (qsizetype(batches.back().items.size()) == BatchSize))
+                    batches.emplace_back();
+                batches.back().items.push_back(parseBsxItem(xml));
             }
         };
 
@@ -637,6 +754,23 @@ Document *DocumentIO::parseBsxInventory(QFile *in)
                 if (!foundRoot || !foundInventory)
                     throw Exception("Not a valid BrickStoreXML file");
 
+                QtConcurrent::blockingMap(batches, [=](BsxBatch &batch) {
+                    for (auto &item : batch.items)
+                        resolveBsxItem(item, startAtChangelogId, creationTime);
+                });
+
+                for (auto &batch : batches) {
+                    for (auto &item : batch.items) {
+                        switch (item.result) {
+                        case BrickLink::Core::ResolveResult::Fail: bsx.incInvalidLotCount(); break;
+                        case BrickLink::Core::ResolveResult::ChangeLog: bsx.incFixedLotCount(); break;
+                        default: break;
+                        }
+                        bsx.addToDifferenceModeBase(item.lot.get(), *item.base);
+                        bsx.addLot(item.lot.release());
+                    }
+                }
+
                 auto model = std::make_unique<DocumentModel>(std::move(bsx), (bsx.fixedLotCount() != 0) /*forceModified*/);
                 if (!bsx.guiSortFilterState.isEmpty())
                     model->restoreSortFilterState(bsx.guiSortFilterState);
@@ -653,184 +787,275 @@ Document *DocumentIO::parseBsxInventory(QFile *in)
 }
 
 
+namespace {
+
+// Saving is dominated by the per-lot work, so instead of going through QXmlStreamWriter and
+// QVariant, all the fields of an Item are described in a static table and written as UTF-8
+// straight into a buffer. The output is the same as QXmlStreamWriter's auto-formatting.
+
+struct BsxField
+{
+    enum Flags { Required = 0, Optional = 1, Constant = 2, WriteEmpty = 8 };
+
+    const char *tag;
+    int flags;
+    void (*value)(const Lot &lot, QByteArray &utf8);
+    bool (*isDefault)(const Lot &lot) = nullptr;   // Optional fields only
+    bool (*isPresent)(const Lot &lot) = nullptr;   // nullptr: always
+};
+
+template <auto Getter> bool sameValue(const Lot &lot1, const Lot &lot2)
+{
+    return (lot1.*Getter)() == (lot2.*Getter)();
+}
+
+template <auto Getter> void asInt(const Lot &lot, QByteArray &utf8)
+{
+    utf8.append(QByteArray::number((lot.*Getter)()));
+}
+
+template <auto Getter> void asCurrency(const Lot &lot, QByteArray &utf8)
+{
+    utf8.append(QByteArray::number(Utility::fixFinite((lot.*Getter)()), 'f', 3));
+}
+
+template <auto Getter> void asString(const Lot &lot, QByteArray &utf8)
+{
+    utf8.append((lot.*Getter)().toUtf8());
+}
+
+template <auto Getter> void asDateTime(const Lot &lot, QByteArray &utf8)
+{
+    utf8.append((lot.*Getter)().toString(Qt::ISODate).toUtf8());
+}
+
+struct BsxFieldEntry
+{
+    BsxField field;
+    bool (*equals)(const Lot &lot1, const Lot &lot2);
+};
+
+static const BsxFieldEntry bsxFields[] = {
+    // vvv Required Fields (part 1)
+    { { "ItemID", BsxField::Required, [](const Lot &lot, QByteArray &utf8) {
+          utf8.append(lot.itemId()); } },
+      sameValue<&Lot::itemId> },
+    { { "ItemTypeID", BsxField::Required, [](const Lot &lot, QByteArray &utf8) {
+          QChar qc = QLatin1Char(lot.itemTypeId());
+          if (qc.isPrint())
+              utf8.append(QString(qc).toUtf8()); } },
+      sameValue<&Lot::itemTypeId> },
+    { { "ColorID", BsxField::Required, asInt<&Lot::colorId> },
+      sameValue<&Lot::colorId> },
+
+    // vvv Redundancy Fields
+
+    // this extra information is useful, if the e.g.the color- or item-id
+    // are no longer available after a database update
+    { { "ItemName", BsxField::Required, asString<&Lot::itemName> },
+      sameValue<&Lot::itemName> },
+    { { "ItemTypeName", BsxField::Required, asString<&Lot::itemTypeName> },
+      sameValue<&Lot::itemTypeName> },
+    { { "ColorName", BsxField::Required, asString<&Lot::colorName> },
+      sameValue<&Lot::colorName> },
+    { { "CategoryID", BsxField::Required, asInt<&Lot::categoryId> },
+      sameValue<&Lot::categoryId> },
+    { { "CategoryName", BsxField::Required, asString<&Lot::categoryName> },
+      sameValue<&Lot::categoryName> },
+
+    // vvv Required Fields (part 2)
+
+    { { "Status", BsxField::Required, [](const Lot &lot, QByteArray &utf8) {
+          switch (lot.status()) {
+          default                        :
+          case BrickLink::Status::Exclude: utf8.append('X'); break;
+          case BrickLink::Status::Include: utf8.append('I'); break;
+          case BrickLink::Status::Extra  : utf8.append('E'); break;
+          } } },
+      sameValue<&Lot::status> },
+    { { "Qty", BsxField::Required, asInt<&Lot::quantity> },
+      sameValue<&Lot::quantity> },
+    { { "Price", BsxField::Required, asCurrency<&Lot::price> },
+      sameValue<&Lot::price> },
+    { { "Condition", BsxField::Required, [](const Lot &lot, QByteArray &utf8) {
+          utf8.append((lot.condition() == BrickLink::Condition::New) ? 'N' : 'U'); } },
+      sameValue<&Lot::condition> },
+
+    // vvv Optional Fields (part 2)
+
+    { { "SubCondition", BsxField::Optional, [](const Lot &lot, QByteArray &utf8) {
+          // 'M' for sealed is an historic artefact. BL called this 'MISB' back in the day
+          switch (lot.subCondition()) {
+          case BrickLink::SubCondition::Incomplete: utf8.append('I'); break;
+          case BrickLink::SubCondition::Complete  : utf8.append('C'); break;
+          case BrickLink::SubCondition::Sealed    : utf8.append('M'); break;
+          default                                 : utf8.append('N'); break;
+          } },
+        [](const Lot &lot) { return lot.subCondition() == BrickLink::SubCondition::None; } },
+      sameValue<&Lot::subCondition> },
+    { { "Bulk", BsxField::Optional, asInt<&Lot::bulkQuantity>,
+        [](const Lot &lot) { return lot.bulkQuantity() == 1; } },
+      sameValue<&Lot::bulkQuantity> },
+    { { "Sale", BsxField::Optional, asInt<&Lot::sale>,
+        [](const Lot &lot) { return lot.sale() == 0; } },
+      sameValue<&Lot::sale> },
+    { { "Cost", BsxField::Optional, asCurrency<&Lot::cost>,
+        [](const Lot &lot) { return lot.cost() == 0; } },
+      sameValue<&Lot::cost> },
+    { { "Comments", BsxField::Optional, asString<&Lot::comments>,
+        [](const Lot &lot) { return lot.comments().isEmpty(); } },
+      sameValue<&Lot::comments> },
+    { { "Remarks", BsxField::Optional, asString<&Lot::remarks>,
+        [](const Lot &lot) { return lot.remarks().isEmpty(); } },
+      sameValue<&Lot::remarks> },
+    { { "Reserved", BsxField::Optional, asString<&Lot::reserved>,
+        [](const Lot &lot) { return lot.reserved().isEmpty(); } },
+      sameValue<&Lot::reserved> },
+    { { "LotID", BsxField::Optional, asInt<&Lot::lotId>,
+        [](const Lot &lot) { return lot.lotId() == 0; } },
+      sameValue<&Lot::lotId> },
+    { { "TQ1", BsxField::Optional, asInt<&Lot::tierQuantity0>,
+        [](const Lot &lot) { return lot.tierQuantity0() == 0; } },
+      sameValue<&Lot::tierQuantity0> },
+    { { "TP1", BsxField::Optional, asCurrency<&Lot::tierPrice0>,
+        [](const Lot &lot) { return lot.tierPrice0() == 0; } },
+      sameValue<&Lot::tierPrice0> },
+    { { "TQ2", BsxField::Optional, asInt<&Lot::tierQuantity1>,
+        [](const Lot &lot) { return lot.tierQuantity1() == 0; } },
+      sameValue<&Lot::tierQuantity1> },
+    { { "TP2", BsxField::Optional, asCurrency<&Lot::tierPrice1>,
+        [](const Lot &lot) { return lot.tierPrice1() == 0; } },
+      sameValue<&Lot::tierPrice1> },
+    { { "TQ3", BsxField::Optional, asInt<&Lot::tierQuantity2>,
+        [](const Lot &lot) { return lot.tierQuantity2() == 0; } },
+      sameValue<&Lot::tierQuantity2> },
+    { { "TP3", BsxField::Optional, asCurrency<&Lot::tierPrice2>,
+        [](const Lot &lot) { return lot.tierPrice2() == 0; } },
+      sameValue<&Lot::tierPrice2> },
+    { { "Retain", BsxField::Optional | BsxField::WriteEmpty, [](const Lot &lot, QByteArray &utf8) {
+          utf8.append(lot.retain() ? 'Y' : 'N'); },
+        [](const Lot &lot) { return !lot.retain(); } },
+      sameValue<&Lot::retain> },
+    { { "Stockroom", BsxField::Optional, [](const Lot &lot, QByteArray &utf8) {
+          switch (lot.stockroom()) {
+          case BrickLink::Stockroom::A: utf8.append('A'); break;
+          case BrickLink::Stockroom::B: utf8.append('B'); break;
+          case BrickLink::Stockroom::C: utf8.append('C'); break;
+          default                     : utf8.append('N'); break;
+          } },
+        [](const Lot &lot) { return lot.stockroom() == BrickLink::Stockroom::None; } },
+      sameValue<&Lot::stockroom> },
+    { { "TotalWeight", BsxField::Required, [](const Lot &lot, QByteArray &utf8) {
+          utf8.append(QByteArray::number(Utility::fixFinite(lot.totalWeight()), 'f', 4)); },
+        nullptr, [](const Lot &lot) { return lot.hasCustomWeight(); } },
+      sameValue<&Lot::totalWeight> },
+    { { "MarkerText", BsxField::Constant, asString<&Lot::markerText>,
+        nullptr, [](const Lot &lot) { return !lot.markerText().isEmpty(); } },
+      nullptr },
+    { { "MarkerColor", BsxField::Constant, [](const Lot &lot, QByteArray &utf8) {
+          utf8.append(lot.markerColor().name().toLatin1()); },
+        nullptr, [](const Lot &lot) { return lot.markerColor().isValid(); } },
+      nullptr },
+    { { "DateAdded", BsxField::Constant, asDateTime<&Lot::dateAdded>,
+        nullptr, [](const Lot &lot) { return lot.dateAdded().isValid(); } },
+      nullptr },
+    { { "DateLastSold", BsxField::Constant, asDateTime<&Lot::dateLastSold>,
+        nullptr, [](const Lot &lot) { return lot.dateLastSold().isValid(); } },
+      nullptr },
+};
+
+} // namespace
+
 bool DocumentIO::createBsxInventory(QIODevice *out, const Document *doc)
 {
     if (!out)
         return false;
 
-    QXmlStreamWriter xml(out);
-    xml.setAutoFormatting(true);
-    xml.setAutoFormattingIndent(1);
-    xml.writeStartDocument();
+    XmlHelpers::Utf8Writer w(out);
+    w.raw("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
 
     // We don't write a DOCTYPE anymore, because RelaxNG wants the schema independent from
     // the actual XML file. As a side effect, BSX files can now be opened directly in Excel.
 
-    xml.writeStartElement(u"BrickStoreXML"_qs);
-    xml.writeStartElement(u"Inventory"_qs);
-    xml.writeAttribute(u"Currency"_qs, doc->model()->currencyCode());
-    xml.writeAttribute(u"BrickLinkChangelogId"_qs, QString::number(BrickLink::core()->latestChangelogId()));
-
-    const Lot *lot;
-    const Lot *base;
-    QXmlStreamAttributes baseValues;
-
-    enum CreateFlags { Required = 0, Optional = 1, Constant = 2, WriteEmpty = 8 };
+    w.raw("<BrickStoreXML>\n");
+    w.raw(" <Inventory Currency=\"");
+    w.escaped(doc->model()->currencyCode().toUtf8(), true);
+    w.raw("\" BrickLinkChangelogId=\"");
+    w.raw(QByteArray::number(BrickLink::core()->latestChangelogId()));
+    w.raw("\">\n");
 
-    auto create = [&](QStringView tagName, auto getter, auto stringify,
-            int flags = CreateFlags::Required, const QVariant &def = { }) {
-
-        auto v = (lot->*getter)();
-        const QString t = tagName.toString();
-        const bool writeEmpty = (flags & WriteEmpty);
-        const bool optional = ((flags & ~WriteEmpty) == Optional);
-        const bool constant = ((flags & ~WriteEmpty) == Constant);
-
-        if (!optional || (QVariant::fromValue(v) != def)) {
-            if (writeEmpty)
-                xml.writeEmptyElement(t);
-            else
-                xml.writeTextElement(t, stringify(v));
-        }
-        if (!constant && base) {
-            auto bv = (base->*getter)();
-            if (QVariant::fromValue(v) != QVariant::fromValue(bv))
-                baseValues.append(t, stringify(bv));
-        }
-    };
-    static auto asString   = [](const QString &s)      { return s; };
-    static auto asCurrency = [](double d)              { return QString::number(Utility::fixFinite(d), 'f', 3); };
-    static auto asInt      = [](auto i)                { return QString::number(i); };
-    static auto asDateTime = [](const QDateTime &dt)   { return dt.toString(Qt::ISODate); };
+    QByteArray value;
+    QByteArray baseValues;
 
     const auto lots = doc->model()->lots();
-    const auto diffModeBase = doc->model()->differenceBase();
-    for (const auto *loopLot : lots) {
-        lot = loopLot;
-        auto &baseRef = diffModeBase[lot];
-        base = &baseRef;
-        baseValues.clear();
-
-        xml.writeStartElement(u"Item"_qs);
-
-        // vvv Required Fields (part 1)
-        create(u"ItemID",       &Lot::itemId,       [](auto l1s) {
-            return QString::fromLatin1(l1s); });
-        create(u"ItemTypeID",   &Lot::itemTypeId,   [](auto c) {
-            QChar qc = QLatin1Char(c);
-            return qc.isPrint() ? QString(qc) :QString();
-        });
-        create(u"ColorID",      &Lot::colorId,      asInt);
-
-        // vvv Redundancy Fields
-
-        // this extra information is useful, if the e.g.the color- or item-id
-        // are no longer available after a database update
-        create(u"ItemName",     &Lot::itemName,     asString);
-        create(u"ItemTypeName", &Lot::itemTypeName, asString);
-        create(u"ColorName",    &Lot::colorName,    asString);
-        create(u"CategoryID",   &Lot::categoryId,   asInt);
-        create(u"CategoryName", &Lot::categoryName, asString);
-
-        // vvv Required Fields (part 2)
-
-        create(u"Status", &Lot::status, [](auto st) {
-            switch (st) {
-            default                        :
-            case BrickLink::Status::Exclude: return u"X"_qs;
-            case BrickLink::Status::Include: return u"I"_qs;
-            case BrickLink::Status::Extra  : return u"E"_qs;
-            }
-        });
+    for (const Lot *lot : lots) {
+        const Lot *base = doc->model()->differenceBaseLot(lot);
+        baseValues.resize(0);
 
-        create(u"Qty",       &Lot::quantity,     asInt);
-        create(u"Price",     &Lot::price,        asCurrency);
-        create(u"Condition", &Lot::condition, [](auto c) {
-            return (c == BrickLink::Condition::New) ? u"N"_qs : u"U"_qs; });
+        w.raw("  <Item>\n");
 
-        // vvv Optional Fields (part 2)
+        for (const auto &[field, equals] : bsxFields) {
+            if (field.isPresent && !field.isPresent(*lot))
+                continue;
 
-        create(u"SubCondition", &Lot::subCondition,
-                [](auto sc) {
-            // 'M' for sealed is an historic artefact. BL called this 'MISB' back in the day
-            switch (sc) {
-            case BrickLink::SubCondition::Incomplete: return u"I"_qs;
-            case BrickLink::SubCondition::Complete  : return u"C"_qs;
-            case BrickLink::SubCondition::Sealed    : return u"M"_qs;
-            default                                 : return u"N"_qs;
+            const bool writeEmpty = (field.flags & BsxField::WriteEmpty);
+            const bool optional = ((field.flags & ~BsxField::WriteEmpty) == BsxField::Optional);
+
+            if (!optional || !field.isDefault(*lot)) {
+                w.indent(3);
+                w.raw("<");
+                w.raw(field.tag);
+                if (writeEmpty) {
+                    w.raw("/>\n");
+                } else {
+                    w.raw(">");
+                    value.resize(0);
+                    field.value(*lot, value);
+                    w.escaped(value, false);
+                    w.raw("</");
+                    w.raw(field.tag);
+                    w.raw(">\n");
+                }
             }
-        }, Optional, QVariant::fromValue(BrickLink::SubCondition::None));
-
-        create(u"Bulk",      &Lot::bulkQuantity,  asInt,      Optional, 1);
-        create(u"Sale",      &Lot::sale,          asInt,      Optional, 0);
-        create(u"Cost",      &Lot::cost,          asCurrency, Optional, 0);
-        create(u"Comments",  &Lot::comments,      asString,   Optional, QString());
-        create(u"Remarks",   &Lot::remarks,       asString,   Optional, QString());
-        create(u"Reserved",  &Lot::reserved,      asString,   Optional, QString());
-        create(u"LotID",     &Lot::lotId,         asInt,      Optional, 0);
-        create(u"TQ1",       &Lot::tierQuantity0, asInt,      Optional, 0);
-        create(u"TP1",       &Lot::tierPrice0,    asCurrency, Optional, 0);
-        create(u"TQ2",       &Lot::tierQuantity1, asInt,      Optional, 0);
-        create(u"TP2",       &Lot::tierPrice1,    asCurrency, Optional, 0);
-        create(u"TQ3",       &Lot::tierQuantity2, asInt,      Optional, 0);
-        create(u"TP3",       &Lot::tierPrice2,    asCurrency, Optional, 0);
-
-        create(u"Retain", &Lot::retain, [](bool b) {
-            return b ? u"Y"_qs : u"N"_qs; }, Optional | WriteEmpty, false);
-
-        create(u"Stockroom", &Lot::stockroom, [](auto st) {
-            switch (st) {
-            case BrickLink::Stockroom::A: return u"A"_qs;
-            case BrickLink::Stockroom::B: return u"B"_qs;
-            case BrickLink::Stockroom::C: return u"C"_qs;
-            default                     : return u"N"_qs;
+            if (equals && base && !equals(*lot, *base)) {
+                value.resize(0);
+                field.value(*base, value);
+                baseValues.append(' ').append(field.tag).append("=\"");
+                XmlHelpers::Utf8Writer::escape(baseValues, value, true);
+                baseValues.append('"');
             }
-        }, Optional, QVariant::fromValue(BrickLink::Stockroom::None));
-
-        if (lot->hasCustomWeight()) {
-            create(u"TotalWeight", &Lot::totalWeight, [](double d) {
-                return QString::number(Utility::fixFinite(d), 'f', 4); }, Required);
         }
-        if (!lot->markerText().isEmpty())
-            create(u"MarkerText", &Lot::markerText, asString, Constant);
-        if (lot->markerColor().isValid())
-            create(u"MarkerColor", &Lot::markerColor, [](QColor c) { return c.name(); }, Constant);
-
-        if (lot->dateAdded().isValid())
-            create(u"DateAdded", &Lot::dateAdded, asDateTime, Constant);
-        if (lot->dateLastSold().isValid())
-            create(u"DateLastSold", &Lot::dateLastSold, asDateTime, Constant);
-
-        if (base && !baseValues.isEmpty()) {
-            xml.writeStartElement(u"DifferenceBaseValues"_qs);
-            xml.writeAttributes(baseValues);
-            xml.writeEndElement(); // DifferenceBaseValues
+        if (!baseValues.isEmpty()) {
+            w.raw("   <DifferenceBaseValues");
+            w.raw(baseValues);
+            w.raw("/>\n");
         }
-        xml.writeEndElement(); // Item
+        w.raw("  </Item>\n");
     }
 
-    xml.writeEndElement(); // Inventory
-
-    xml.writeStartElement(u"GuiState"_qs);
-    xml.writeAttribute(u"Application"_qs, u"BrickStore"_qs);
-    xml.writeAttribute(u"Version"_qs, QString::number(2));
-    QByteArray columnLayout = doc->saveColumnsState();
-    if (!columnLayout.isEmpty()) {
-        xml.writeStartElement(u"ColumnLayout"_qs);
-        xml.writeAttribute(u"Compressed"_qs, u"1"_qs);
-        xml.writeCDATA(QString::fromLatin1(qCompress(columnLayout).toBase64()));
-        xml.writeEndElement(); // ColumnLayout
-    }
-    QByteArray sortFilterState = doc->model()->saveSortFilterState();
-    if (!sortFilterState.isEmpty()) {
-        xml.writeStartElement(u"SortFilterState"_qs);
-        xml.writeAttribute(u"Compressed"_qs, u"1"_qs);
-        xml.writeCDATA(QString::fromLatin1(qCompress(sortFilterState).toBase64()));
-        xml.writeEndElement(); // SortFilterState
+    w.raw(" </Inventory>\n");
+
+    const QByteArray columnLayout = doc->saveColumnsState();
+    const QByteArray sortFilterState = doc->model()->saveSortFilterState();
+
+    w.raw(" <GuiState Application=\"BrickStore\" Version=\"2\"");
+    if (columnLayout.isEmpty() && sortFilterState.isEmpty()) {
+        w.raw("/>\n");
+    } else {
+        w.raw(">\n");
+        if (!columnLayout.isEmpty()) {
+            w.raw("  <ColumnLayout Compressed=\"1\"><![CDATA[");
+            w.raw(qCompress(columnLayout).toBase64());
+            w.raw("]]></ColumnLayout>\n");
+        }
+        if (!sortFilterState.isEmpty()) {
+            w.raw("  <SortFilterState Compressed=\"1\"><![CDATA[");
+            w.raw(qCompress(sortFilterState).toBase64());
+            w.raw("]]></SortFilterState>\n");
+        }
+        w.raw(" </GuiState>\n");
     }
-    xml.writeEndElement(); // GuiState
 
-    xml.writeEndElement(); // BrickStoreXML
-    xml.writeEndDocument();
-    return !xml.hasError();
+    w.raw("</BrickStoreXML>\n");
+    return w.finish();
 }
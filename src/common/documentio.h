@@ -55,9 +55,13 @@ public:
     static bool createBsxInventory(QIODevice *out, const Document *doc);
 
 private:
-    static bool parseLDrawModel(QFile *f, bool isStudio, BrickLink::IO::ParseResult &pr);
-    static bool parseLDrawModelInternal(QFile *f, bool isStudio, const QString &modelName,
-                                        QVector<Lot *> &lots,
+    struct LDrawModelIndex;
+
+    static bool parseLDrawModel(QIODevice *f, const QString &dir, bool isStudio,
+                                BrickLink::IO::ParseResult &pr);
+    static bool indexLDrawModel(QIODevice *in, const QString &dir, LDrawModelIndex &index);
+    static bool parseLDrawModelInternal(const LDrawModelIndex &index, bool isStudio,
+                                        const QString &modelName, QVector<Lot *> &lots,
                                         QHash<QString, QVector<Lot *> > &subCache,
                                         QVector<QString> &recursionDetection);
 
@@ -3,6 +3,7 @@
 
 #include <utility>
 #include <algorithm>
+#include <iterator>
 
 #include <QCoreApplication>
 #include <QCursor>
@@ -10,6 +11,7 @@
 #include <QDir>
 #include <QTimer>
 #include <QtConcurrentFilter>
+#include <QtConcurrentMap>
 #include <QtAlgorithms>
 #include <QStringListModel>
 
@@ -20,6 +22,7 @@
 #  define MODELTEST_ATTACH(x)   ;
 #endif
 
+#include "utility/appstatistics.h"
 #include "utility/utility.h"
 #include "common/currency.h"
 #include "common/undo.h"
@@ -219,17 +222,150 @@ QString AddRemoveCmd::genDesc(bool is_add, int count)
 ///////////////////////////////////////////////////////////////////////
 
 
+namespace {
+
+// All the Lot fields that can be recorded as a delta by ChangeCmd. The numeric ones (including
+// enums and flags) are packed into plain double columns, the rest into QVariant columns.
+
+struct NumberField
+{
+    double (*get)(const Lot &);
+    void (*set)(Lot &, double);
+};
+
+struct VariantField
+{
+    QVariant (*get)(const Lot &);
+    void (*set)(Lot &, const QVariant &);
+};
+
+static const NumberField numberFields[] = {
+    { [](const Lot &l) { return double(l.status()); },
+      [](Lot &l, double v) { l.setStatus(static_cast<BrickLink::Status>(int(v))); } },
+    { [](const Lot &l) { return double(l.condition()); },
+      [](Lot &l, double v) { l.setCondition(static_cast<BrickLink::Condition>(int(v))); } },
+    { [](const Lot &l) { return double(l.subCondition()); },
+      [](Lot &l, double v) { l.setSubCondition(static_cast<BrickLink::SubCondition>(int(v))); } },
+    { [](const Lot &l) { return double(l.retain()); },
+      [](Lot &l, double v) { l.setRetain(bool(v)); } },
+    { [](const Lot &l) { return double(l.stockroom()); },
+      [](Lot &l, double v) { l.setStockroom(static_cast<BrickLink::Stockroom>(int(v))); } },
+    { [](const Lot &l) { return double(l.alternate()); },
+      [](Lot &l, double v) { l.setAlternate(bool(v)); } },
+    { [](const Lot &l) { return double(l.alternateId()); },
+      [](Lot &l, double v) { l.setAlternateId(uint(v)); } },
+    { [](const Lot &l) { return double(l.counterPart()); },
+      [](Lot &l, double v) { l.setCounterPart(bool(v)); } },
+    { [](const Lot &l) { return double(l.lotId()); },
+      [](Lot &l, double v) { l.setLotId(uint(v)); } },
+    { [](const Lot &l) { return double(l.quantity()); },
+      [](Lot &l, double v) { l.setQuantity(int(v)); } },
+    { [](const Lot &l) { return double(l.bulkQuantity()); },
+      [](Lot &l, double v) { l.setBulkQuantity(int(v)); } },
+    { [](const Lot &l) { return double(l.tierQuantity(0)); },
+      [](Lot &l, double v) { l.setTierQuantity(0, int(v)); } },
+    { [](const Lot &l) { return double(l.tierQuantity(1)); },
+      [](Lot &l, double v) { l.setTierQuantity(1, int(v)); } },
+    { [](const Lot &l) { return double(l.tierQuantity(2)); },
+      [](Lot &l, double v) { l.setTierQuantity(2, int(v)); } },
+    { [](const Lot &l) { return double(l.sale()); },
+      [](Lot &l, double v) { l.setSale(int(v)); } },
+    { [](const Lot &l) { return l.price(); },
+      [](Lot &l, double v) { l.setPrice(v); } },
+    { [](const Lot &l) { return l.cost(); },
+      [](Lot &l, double v) { l.setCost(v); } },
+    { [](const Lot &l) { return l.tierPrice(0); },
+      [](Lot &l, double v) { l.setTierPrice(0, v); } },
+    { [](const Lot &l) { return l.tierPrice(1); },
+      [](Lot &l, double v) { l.setTierPrice(1, v); } },
+    { [](const Lot &l) { return l.tierPrice(2); },
+      [](Lot &l, double v) { l.setTierPrice(2, v); } },
+    { [](const Lot &l) { return l.hasCustomWeight() ? l.weight() : 0.; },
+      [](Lot &l, double v) { l.setWeight(v); } },
+};
+
+static const VariantField variantFields[] = {
+    { [](const Lot &l) { return QVariant::fromValue(l.reserved()); },
+      [](Lot &l, const QVariant &v) { l.setReserved(v.toString()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.comments()); },
+      [](Lot &l, const QVariant &v) { l.setComments(v.toString()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.remarks()); },
+      [](Lot &l, const QVariant &v) { l.setRemarks(v.toString()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.markerText()); },
+      [](Lot &l, const QVariant &v) { l.setMarkerText(v.toString()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.markerColor()); },
+      [](Lot &l, const QVariant &v) { l.setMarkerColor(v.value<QColor>()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.dateAdded()); },
+      [](Lot &l, const QVariant &v) { l.setDateAdded(v.toDateTime()); } },
+    { [](const Lot &l) { return QVariant::fromValue(l.dateLastSold()); },
+      [](Lot &l, const QVariant &v) { l.setDateLastSold(v.toDateTime()); } },
+};
+
+static constexpr int NumberFieldCount = int(std::size(numberFields));
+static constexpr int VariantFieldCount = int(std::size(variantFields));
+static_assert((NumberFieldCount + VariantFieldCount) <= 64);
+
+// field indexes: numbers first, then variants
+static quint64 changedFields(const Lot &lot1, const Lot &lot2)
+{
+    quint64 mask = 0;
+    for (int i = 0; i < NumberFieldCount; ++i) {
+        if (numberFields[i].get(lot1) != numberFields[i].get(lot2))
+            mask |= (quint64(1) << i);
+    }
+    for (int i = 0; i < VariantFieldCount; ++i) {
+        if (variantFields[i].get(lot1) != variantFields[i].get(lot2))
+            mask |= (quint64(1) << (NumberFieldCount + i));
+    }
+    return mask;
+}
+
+} // namespace
+
+
 QTimer *ChangeCmd::s_eventLoopCounter = nullptr;
+qint64 ChangeCmd::s_memoryUsage = 0;
+int ChangeCmd::s_memoryStatId = -1;
 
 ChangeCmd::ChangeCmd(DocumentModel *model, const std::vector<std::pair<Lot *, Lot>> &changes, DocumentModel::Field hint)
     : QUndoCommand()
     , m_model(model)
     , m_hint(hint)
-    , m_changes(changes)
 {
-    std::sort(m_changes.begin(), m_changes.end(), [](const auto &a, const auto &b) {
-        return a.first < b.first;
-    });
+    std::vector<const Lot *> newValues;
+    newValues.reserve(changes.size());
+    quint64 fields = 0;
+
+    for (const auto &[lot, newLot] : changes) {
+        if ((lot->item() != newLot.item()) || (lot->color() != newLot.color())
+                || lot->isIncomplete() || newLot.isIncomplete()) {
+            m_fullLots.append(lot);
+            m_fullValues.push_back(newLot);
+        } else {
+            m_lots.append(lot);
+            newValues.push_back(&newLot);
+            fields |= changedFields(*lot, newLot);
+        }
+    }
+
+    // the columns start out with the new values: the first redo() swaps them in
+    for (int f = 0; f < (NumberFieldCount + VariantFieldCount); ++f) {
+        if (!(fields & (quint64(1) << f)))
+            continue;
+        if (f < NumberFieldCount) {
+            std::vector<double> column;
+            column.reserve(newValues.size());
+            for (const Lot *newLot : newValues)
+                column.push_back(numberFields[f].get(*newLot));
+            m_numberColumns.emplace_back(f, std::move(column));
+        } else {
+            QVector<QVariant> column;
+            column.reserve(qsizetype(newValues.size()));
+            for (const Lot *newLot : newValues)
+                column.append(variantFields[f - NumberFieldCount].get(*newLot));
+            m_variantColumns.emplace_back(f, std::move(column));
+        }
+    }
 
     if (!s_eventLoopCounter) {
         s_eventLoopCounter = new QTimer(QCoreApplication::instance());
@@ -245,14 +381,77 @@ ChangeCmd::ChangeCmd(DocumentModel *model, const std::vector<std::pair<Lot *, Lo
     m_loopCount = s_eventLoopCounter->property("loopCount").toUInt();
     s_eventLoopCounter->start();
 
+    if (s_memoryStatId < 0)
+        s_memoryStatId = AppStatistics::inst()->addSource(u"Undo memory"_qs, u"KB"_qs);
+
     updateText();
+    updateMemoryUsage();
+}
+
+ChangeCmd::~ChangeCmd()
+{
+    s_memoryUsage -= m_memoryUsage;
+    AppStatistics::inst()->update(s_memoryStatId, s_memoryUsage / 1024);
+}
+
+void ChangeCmd::addColumn(int field, const ChangeCmd *other,
+                          const QHash<const Lot *, qsizetype> &otherIndex)
+{
+    // A field that was not recorded yet: the lots already have the values to swap in, unless
+    // a merged command changed that field later on: its column has the value to restore then
+    if (field < NumberFieldCount) {
+        const std::vector<double> *otherColumn = nullptr;
+        if (other) {
+            for (const auto &c : other->m_numberColumns) {
+                if (c.first == field)
+                    otherColumn = &c.second;
+            }
+        }
+        std::vector<double> column;
+        column.reserve(size_t(m_lots.size()));
+        for (const Lot *lot : std::as_const(m_lots)) {
+            const auto j = otherColumn ? otherIndex.value(lot, -1) : -1;
+            column.push_back((j >= 0) ? otherColumn->at(size_t(j)) : numberFields[field].get(*lot));
+        }
+        m_numberColumns.emplace_back(field, std::move(column));
+    } else {
+        const QVector<QVariant> *otherColumn = nullptr;
+        if (other) {
+            for (const auto &c : other->m_variantColumns) {
+                if (c.first == field)
+                    otherColumn = &c.second;
+            }
+        }
+        QVector<QVariant> column;
+        column.reserve(m_lots.size());
+        for (const Lot *lot : std::as_const(m_lots)) {
+            const auto j = otherColumn ? otherIndex.value(lot, -1) : -1;
+            column.append((j >= 0) ? otherColumn->at(j) : variantFields[field - NumberFieldCount].get(*lot));
+        }
+        m_variantColumns.emplace_back(field, std::move(column));
+    }
+}
+
+void ChangeCmd::updateMemoryUsage()
+{
+    // a rough estimate: the QVariant payloads are mostly implicitly shared with the lots
+    qint64 usage = qint64(sizeof(ChangeCmd)) + m_lots.size() * qint64(sizeof(Lot *));
+    for (const auto &column : m_numberColumns)
+        usage += qint64(column.second.size() * sizeof(double));
+    for (const auto &column : m_variantColumns)
+        usage += column.second.size() * qint64(sizeof(QVariant));
+    usage += m_fullLots.size() * qint64(sizeof(Lot *) + sizeof(Lot));
+
+    s_memoryUsage += (usage - m_memoryUsage);
+    m_memoryUsage = usage;
+    AppStatistics::inst()->update(s_memoryStatId, s_memoryUsage / 1024);
 }
 
 void ChangeCmd::updateText()
 {
     //: Generic undo/redo text for table edits: %1 == column name (e.g. "Price")
     setText(QCoreApplication::translate("ChangeCmd", "Modified %1 on %Ln item(s)", nullptr,
-                                        int(m_changes.size()))
+                                        int(m_lots.size() + m_fullLots.size()))
             //: Generic undo/redo text for table edits: if more than one column was edited at once
             .arg((m_hint < DocumentModel::FieldCount) ? m_model->headerData(m_hint, Qt::Horizontal).toString()
                                                  : QCoreApplication::translate("ChangeCmd", "multiple fields")));
@@ -268,15 +467,65 @@ bool ChangeCmd::mergeWith(const QUndoCommand *other)
     if (other->id() == id()) {
         auto *otherChange = static_cast<const ChangeCmd *>(other);
         if ((m_loopCount == otherChange->m_loopCount) && (m_hint == otherChange->m_hint)) {
-            std::copy_if(otherChange->m_changes.cbegin(), otherChange->m_changes.cend(),
-                         std::back_inserter(m_changes), [this](const auto &change) {
-                return !std::binary_search(m_changes.begin(), m_changes.end(),
-                                           std::make_pair(change.first, Lot { }),
-                                           [](const auto &a, const auto &b) {
-                    return a.first < b.first;
-                });
-            });
+            // lots that we already know about keep their older state
+            QSet<const Lot *> known(m_lots.cbegin(), m_lots.cend());
+            const QSet<const Lot *> knownFull(m_fullLots.cbegin(), m_fullLots.cend());
+
+            // our field columns cannot restore an item or color change
+            for (const Lot *lot : otherChange->m_fullLots) {
+                if (known.contains(lot))
+                    return false;
+            }
+            known.unite(knownFull);
+
+            // both commands have been redone at this point: the other's lots hold the new
+            // state and its columns the old one
+            QHash<const Lot *, qsizetype> otherIndex;
+            otherIndex.reserve(otherChange->m_lots.size());
+            for (qsizetype i = 0; i < otherChange->m_lots.size(); ++i)
+                otherIndex.insert(otherChange->m_lots.at(i), i);
+
+            for (const auto &otherColumn : otherChange->m_numberColumns) {
+                if (std::find_if(m_numberColumns.cbegin(), m_numberColumns.cend(), [&](const auto &c) {
+                                 return c.first == otherColumn.first; }) == m_numberColumns.cend()) {
+                    addColumn(otherColumn.first, otherChange, otherIndex);
+                }
+            }
+            for (const auto &otherColumn : otherChange->m_variantColumns) {
+                if (std::find_if(m_variantColumns.cbegin(), m_variantColumns.cend(), [&](const auto &c) {
+                                 return c.first == otherColumn.first; }) == m_variantColumns.cend()) {
+                    addColumn(otherColumn.first, otherChange, otherIndex);
+                }
+            }
+
+            for (qsizetype i = 0; i < otherChange->m_lots.size(); ++i) {
+                Lot *lot = otherChange->m_lots.at(i);
+                if (known.contains(lot))
+                    continue;
+                m_lots.append(lot);
+
+                for (auto &[field, column] : m_numberColumns) {
+                    auto it = std::find_if(otherChange->m_numberColumns.cbegin(), otherChange->m_numberColumns.cend(),
+                                           [f = field](const auto &c) { return c.first == f; });
+                    column.push_back((it != otherChange->m_numberColumns.cend()) ? it->second.at(size_t(i))
+                                                                                 : numberFields[field].get(*lot));
+                }
+                for (auto &[field, column] : m_variantColumns) {
+                    auto it = std::find_if(otherChange->m_variantColumns.cbegin(), otherChange->m_variantColumns.cend(),
+                                           [f = field](const auto &c) { return c.first == f; });
+                    column.append((it != otherChange->m_variantColumns.cend()) ? it->second.at(i)
+                                                                               : variantFields[field - NumberFieldCount].get(*lot));
+                }
+            }
+            for (qsizetype i = 0; i < otherChange->m_fullLots.size(); ++i) {
+                Lot *lot = otherChange->m_fullLots.at(i);
+                if (known.contains(lot))
+                    continue;
+                m_fullLots.append(lot);
+                m_fullValues.push_back(otherChange->m_fullValues.at(size_t(i)));
+            }
             updateText();
+            updateMemoryUsage();
             return true;
         }
     }
@@ -285,7 +534,26 @@ bool ChangeCmd::mergeWith(const QUndoCommand *other)
 
 void ChangeCmd::redo()
 {
-    m_model->changeLotsDirect(m_changes);
+    const qsizetype deltaCount = m_lots.size();
+
+    m_model->changeLotsDirect(m_lots + m_fullLots, [this, deltaCount](qsizetype i, Lot *lot) {
+        if (i >= deltaCount) {
+            std::swap(*lot, m_fullValues[size_t(i - deltaCount)]);
+            return;
+        }
+        for (auto &[field, column] : m_numberColumns) {
+            const auto &nf = numberFields[field];
+            double v = nf.get(*lot);
+            nf.set(*lot, column[size_t(i)]);
+            column[size_t(i)] = v;
+        }
+        for (auto &[field, column] : m_variantColumns) {
+            const auto &vf = variantFields[field - NumberFieldCount];
+            QVariant v = vf.get(*lot);
+            vf.set(*lot, column.at(i));
+            column[i] = v;
+        }
+    });
 }
 
 void ChangeCmd::undo()
@@ -600,6 +868,7 @@ DocumentModel::DocumentModel()
         if (clean) {
             m_firstNonVisualIndex = 0;
             m_visuallyClean = true;
+            pruneStringPool();
         } else if (m_undo->cleanIndex() < 0) {
             m_visuallyClean = false;
         }
@@ -706,19 +975,24 @@ QCoro::Task<int> DocumentModel::addLots(BrickLink::LotList &&lotsRef, AddLotMode
     QHash<BrickLink::Lot *, qsizetype> mergedLots;
     int mergedCount = 0;
 
+    // index the existing lots once, instead of scanning all of them for every new lot: the
+    // last lot in sort order wins, just like the backwards scan did before
+    QHash<MergeKey, Lot *> mergeIndex;
+    if (addLotMode != AddLotMode::AddAsNew) {
+        mergeIndex.reserve(m_sortedLots.size());
+        for (Lot *otherLot : std::as_const(m_sortedLots)) {
+            if (auto key = mergeKey(*otherLot))
+                mergeIndex.insert(*key, otherLot);
+        }
+    }
+
     for (int i = 0; i < lots.size(); ++i) {
         Lot *lot = lots.at(i);
 
         if (addLotMode != AddLotMode::AddAsNew) {
-            Lot *mergeLot = nullptr;
+            const auto key = mergeKey(*lot);
+            Lot *mergeLot = key ? mergeIndex.value(*key) : nullptr;
 
-            for (int j = int(m_sortedLots.count()) - 1; j >= 0; --j) {
-                Lot *otherLot = m_sortedLots.at(j);
-                if (canLotsBeMerged(*lot, *otherLot)) {
-                    mergeLot = otherLot;
-                    break;
-                }
-            }
             if (!mergeLot) {  // record "lot" to be added
                 Consolidate c({ nullptr, lot });
                 quietConsolidateList.append(c);  // record "lot" to be added
@@ -854,22 +1128,27 @@ QCoro::Task<> DocumentModel::consolidateLots(BrickLink::LotList lots)
         co_return;
 
     QVector<Consolidate> consolidateList;
-    LotList sourceLots = lots;
 
-    for (int i = 0; i < sourceLots.count(); ++i) {
-        Lot *lot = sourceLots.at(i);
-        LotList mergeLots;
+    // group the lots by merge key in a single pass: each group is ordered by the first
+    // appearance of its lots and the groups are ordered by their first lot
+    QHash<MergeKey, qsizetype> groupIndex;
+    QVector<LotList> groups;
 
-        for (int j = i + 1; j < sourceLots.count(); ++j) {
-            Lot *otherLot = sourceLots.at(j);
-            if (canLotsBeMerged(*lot, *otherLot))
-                mergeLots << sourceLots.takeAt(j--);
-        }
-        if (mergeLots.isEmpty())
+    for (Lot *lot : std::as_const(lots)) {
+        const auto key = mergeKey(*lot);
+        if (!key)
             continue;
-
-        mergeLots.prepend(sourceLots.at(i));
-        consolidateList.emplace_back(mergeLots);
+        auto it = groupIndex.constFind(*key);
+        if (it == groupIndex.cend()) {
+            groupIndex.insert(*key, groups.size());
+            groups.append({ lot });
+        } else {
+            groups[*it].append(lot);
+        }
+    }
+    for (const auto &group : std::as_const(groups)) {
+        if (group.size() > 1)
+            consolidateList.emplace_back(group);
     }
 
     if (consolidateList.isEmpty())
@@ -974,6 +1253,14 @@ bool DocumentModel::canLotsBeMerged(const Lot &lot1, const Lot &lot2)
                 (lot2.status() == BrickLink::Status::Exclude)));
 }
 
+std::optional<DocumentModel::MergeKey> DocumentModel::mergeKey(const Lot &lot)
+{
+    if (lot.isIncomplete())
+        return std::nullopt;
+    return MergeKey { lot.item(), lot.color(), lot.condition(), lot.subCondition(),
+                      (lot.status() == BrickLink::Status::Exclude) };
+}
+
 bool DocumentModel::mergeLotFields(const Lot &from, Lot &to, const FieldMergeModes &fieldMergeModes)
 {
     if (!canLotsBeMerged(from, to))
@@ -1229,16 +1516,18 @@ void DocumentModel::insertLotsDirect(const LotList &lots, QVector<int> &position
             m_filteredLots.append(lot);
         }
 
+        lot->internStrings(m_stringPool);
+
         // this is really a new lot, not just a redo - start with no differences
         if (!m_differenceBase.contains(lot))
             m_differenceBase.insert(lot, *lot);
+        m_autosaveDirtyLots.insert(lot);
     }
 
     rebuildLotIndex();
     rebuildFilteredLotIndex();
 
-    for (Lot *lot : std::as_const(lots))
-        updateLotFlags(lot);
+    updateLotFlags(lots);
 
     QModelIndexList after;
     for (const QModelIndex &idx : before)
@@ -1302,17 +1591,25 @@ void DocumentModel::removeLotsDirect(const LotList &lots, QVector<int> &position
         emit isFilteredChanged(m_isFiltered = false);
 }
 
-void DocumentModel::changeLotsDirect(std::vector<std::pair<Lot *, Lot>> &changes)
+void DocumentModel::changeLotsDirect(const LotList &lots,
+                                     const std::function<void(qsizetype, Lot *)> &swapFn)
 {
-    Q_ASSERT(!changes.empty());
+    Q_ASSERT(!lots.empty());
 
-    for (auto &change : changes) {
-        Lot *lot = change.first;
-        std::swap(*lot, change.second);
+    for (qsizetype i = 0; i < lots.size(); ++i) {
+        Lot *lot = lots.at(i);
+        swapFn(i, lot);
+        lot->internStrings(m_stringPool);
+        m_autosaveDirtyLots.insert(lot);
+    }
+    if (m_stringPool.size() > (2 * m_stringPoolPrunedSize + 1024))
+        pruneStringPool();
+
+    updateLotFlags(lots);
 
+    for (const Lot *lot : lots) {
         QModelIndex idx1 = index(lot, 0);
         QModelIndex idx2 = idx1.siblingAtColumn(columnCount() - 1);
-        updateLotFlags(lot);
         emitDataChanged(idx1, idx2);
     }
 
@@ -1355,6 +1652,7 @@ void DocumentModel::changeCurrencyDirect(const QString &ccode, double crate, dou
                 lot->setTierPrice(1, prices[i * 5 + 3]);
                 lot->setTierPrice(2, prices[i * 5 + 4]);
             }
+            m_autosaveDirtyLots.insert(lot);
         }
 
         if (!createPrices) {
@@ -1430,7 +1728,12 @@ void DocumentModel::emitStatisticsChanged()
     m_delayedEmitOfStatisticsChanged->start();
 }
 
-void DocumentModel::updateLotFlags(const Lot *lot)
+template <auto Getter> static bool sameLotValue(const Lot &lot1, const Lot &lot2)
+{
+    return (lot1.*Getter)() == (lot2.*Getter)();
+}
+
+QPair<quint64, quint64> DocumentModel::calculateLotFlags(const Lot *lot, const Lot *base)
 {
     quint64 errors = 0;
     quint64 updated = 0;
@@ -1456,37 +1759,71 @@ void DocumentModel::updateLotFlags(const Lot *lot)
     if (lot->status() == BrickLink::Status::Exclude)
         errors = 0;
 
-    if (auto base = differenceBaseLot(lot)) {
-        static const quint64 ignoreMask = 0ULL
-                | (1ULL << Index)
-                | (1ULL << Status)
-                | (1ULL << Picture)
-                | (1ULL << Description)
-                | (1ULL << QuantityOrig)
-                | (1ULL << QuantityDiff)
-                | (1ULL << PriceOrig)
-                | (1ULL << PriceDiff)
-                | (1ULL << Total)
-                | (1ULL << Category)
-                | (1ULL << ItemType)
-                | (1ULL << LotId)
-                | (1ULL << Weight)
-                | (1ULL << TotalWeight)
-                | (1ULL << YearReleased)
-                | (1ULL << Marker)
-                | (1ULL << DateAdded)
-                | (1ULL << DateLastSold);
-
-        for (Field f = Index; f != FieldCount; f = Field(f + 1)) {
-            quint64 fmask = (1ULL << f);
-            if (fmask & ignoreMask)
-                continue;
-            if (dataForEditRole(lot, f) != dataForEditRole(base, f))
-                updated |= fmask;
+    if (base) {
+        // typed comparisons of the editable fields: these have to match the columns' dataFns,
+        // but avoid building two QVariants per field and lot on every change
+        static const struct {
+            Field field;
+            bool (*same)(const Lot &, const Lot &);
+        } differenceFields[] = {
+            { PartNo,    [](const Lot &l, const Lot &b) {
+                  return (l.item() == b.item()) || (l.itemId() == b.itemId()); } },
+            { Condition, sameLotValue<&Lot::condition> },
+            { Color,     sameLotValue<&Lot::color> },
+            { Quantity,  sameLotValue<&Lot::quantity> },
+            { Price,     sameLotValue<&Lot::price> },
+            { Cost,      sameLotValue<&Lot::cost> },
+            { Bulk,      sameLotValue<&Lot::bulkQuantity> },
+            { Sale,      sameLotValue<&Lot::sale> },
+            { Comments,  sameLotValue<&Lot::comments> },
+            { Remarks,   sameLotValue<&Lot::remarks> },
+            { TierQ1,    sameLotValue<&Lot::tierQuantity0> },
+            { TierP1,    sameLotValue<&Lot::tierPrice0> },
+            { TierQ2,    sameLotValue<&Lot::tierQuantity1> },
+            { TierP2,    sameLotValue<&Lot::tierPrice1> },
+            { TierQ3,    sameLotValue<&Lot::tierQuantity2> },
+            { TierP3,    sameLotValue<&Lot::tierPrice2> },
+            { Retain,    sameLotValue<&Lot::retain> },
+            { Stockroom, sameLotValue<&Lot::stockroom> },
+            { Reserved,  sameLotValue<&Lot::reserved> },
+        };
+
+        for (const auto &df : differenceFields) {
+            if (!df.same(*lot, *base))
+                updated |= (1ULL << df.field);
         }
     }
 
-    setLotFlags(lot, errors, updated);
+    return { errors, updated };
+}
+
+void DocumentModel::updateLotFlags(const LotList &lots)
+{
+    struct LotFlags
+    {
+        const Lot *lot;
+        const Lot *base;
+        QPair<quint64, quint64> flags = { };
+    };
+
+    std::vector<LotFlags> lotFlags;
+    lotFlags.reserve(size_t(lots.size()));
+    for (const Lot *lot : lots)
+        lotFlags.push_back({ lot, differenceBaseLot(lot) });
+
+    // the flags only depend on the lot, its base and the read-only catalog, so big batches
+    // (e.g. loading a store inventory) can be calculated in parallel
+    auto calculate = [](LotFlags &lf) { lf.flags = calculateLotFlags(lf.lot, lf.base); };
+    if (lotFlags.size() >= 1000)
+        QtConcurrent::blockingMap(lotFlags, calculate);
+    else
+        std::for_each(lotFlags.begin(), lotFlags.end(), calculate);
+
+    bool changed = false;
+    for (const auto &lf : lotFlags)
+        changed = setLotFlags(lf.lot, lf.flags.first, lf.flags.second) || changed;
+    if (changed)
+        emitStatisticsChanged();
 }
 
 void DocumentModel::resetDifferenceMode(const LotList &lotList)
@@ -1498,12 +1835,24 @@ void DocumentModel::resetDifferenceModeDirect(QHash<const Lot *, Lot> &differenc
 {
     std::swap(m_differenceBase, differenceBase);
 
+    for (auto &base : m_differenceBase)
+        base.internStrings(m_stringPool);
+
     for (const auto *lot : std::as_const(m_lots))
-        updateLotFlags(lot);
+        m_autosaveDirtyLots.insert(lot);
+    updateLotFlags(m_lots);
 
     emitDataChanged();
 }
 
+void DocumentModel::pruneStringPool()
+{
+    // a string that is only referenced by the pool itself is not used by any lot, difference
+    // base or undo command anymore
+    m_stringPool.removeIf([](const QString &str) { return str.isDetached(); });
+    m_stringPoolPrunedSize = m_stringPool.size();
+}
+
 const Lot *DocumentModel::differenceBaseLot(const Lot *lot) const
 {
     if (!lot)
@@ -1513,6 +1862,11 @@ const Lot *DocumentModel::differenceBaseLot(const Lot *lot) const
     return (it != m_differenceBase.end()) ? &(*it) : nullptr;
 }
 
+QSet<const Lot *> DocumentModel::takeAutosaveDirtyLots()
+{
+    return std::exchange(m_autosaveDirtyLots, { });
+}
+
 bool DocumentModel::legacyCurrencyCode() const
 {
     return m_currencycode.isEmpty();
@@ -1650,10 +2004,10 @@ QPair<quint64, quint64> DocumentModel::lotFlags(const Lot *lot) const
     return flags;
 }
 
-void DocumentModel::setLotFlags(const Lot *lot, quint64 errors, quint64 updated)
+bool DocumentModel::setLotFlags(const Lot *lot, quint64 errors, quint64 updated)
 {
     if (!lot)
-        return;
+        return false;
 
     auto oldFlags = m_lotFlags.value(lot, { });
     if (oldFlags.first != errors || oldFlags.second != updated) {
@@ -1663,8 +2017,9 @@ void DocumentModel::setLotFlags(const Lot *lot, quint64 errors, quint64 updated)
             m_lotFlags.remove(lot);
 
         emit lotFlagsChanged(lot);
-        emitStatisticsChanged();
+        return true;
     }
+    return false;
 }
 
 
@@ -2747,27 +3102,61 @@ const QString DocumentLotsMimeData::s_mimetype = u"application/x-bricklink-invlo
 
 DocumentLotsMimeData::DocumentLotsMimeData(const LotList &lots, const QString &currencyCode)
     : QMimeData()
+    , m_currencyCode(currencyCode)
+    , m_changelogId(BrickLink::core()->latestChangelogId())
 {
-    setLots(lots, currencyCode);
+    m_lots.reserve(size_t(lots.size()));
+    for (const Lot *lot : lots)
+        m_lots.emplace_back(*lot);
+
+    // the item and color pointers in the snapshot will dangle after a database update. The
+    // same is true on exit: the platform clipboard is flushed after BrickLink::core() is gone
+    connect(BrickLink::core()->database(), &BrickLink::Database::databaseAboutToBeReset,
+            this, &DocumentLotsMimeData::detachFromDatabase);
+    connect(qApp, &QCoreApplication::aboutToQuit,
+            this, &DocumentLotsMimeData::detachFromDatabase);
 }
 
-void DocumentLotsMimeData::setLots(const LotList &lots, const QString &currencyCode)
+void DocumentLotsMimeData::detachFromDatabase()
 {
-    QByteArray data;
-    QString text;
+    serializedLots();
+    itemIdText();
+    m_lots.clear();
+    m_lots.shrink_to_fit();
+}
 
-    QDataStream ds(&data, QIODevice::WriteOnly);
-    ds << QByteArray("LOTS") << qint32(2);
+QByteArray DocumentLotsMimeData::serializedLots() const
+{
+    if (m_serialized.isEmpty() && !m_lots.empty()) {
+        QDataStream ds(&m_serialized, QIODevice::WriteOnly);
+        ds << QByteArray("LOTS") << qint32(2);
 
-    ds << currencyCode << BrickLink::core()->latestChangelogId() << quint32(lots.count());
-    for (const Lot *lot : lots) {
-        lot->save(ds);
-        if (!text.isEmpty())
-            text.append(u"\n"_qs);
-        text.append(QLatin1String(lot->itemId()));
+        ds << m_currencyCode << m_changelogId << quint32(m_lots.size());
+        for (const Lot &lot : m_lots)
+            lot.save(ds);
+    }
+    return m_serialized;
+}
+
+QString DocumentLotsMimeData::itemIdText() const
+{
+    if (m_text.isEmpty() && !m_lots.empty()) {
+        for (const Lot &lot : m_lots) {
+            if (!m_text.isEmpty())
+                m_text.append(u"\n"_qs);
+            m_text.append(QLatin1String(lot.itemId()));
+        }
     }
-    setText(text);
-    setData(s_mimetype, data);
+    return m_text;
+}
+
+QVariant DocumentLotsMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    if (mimeType == s_mimetype)
+        return serializedLots();
+    else if (mimeType == u"text/plain")
+        return itemIdText();
+    return QMimeData::retrieveData(mimeType, type);
 }
 
 std::tuple<LotList, QString> DocumentLotsMimeData::lots(const QMimeData *md)
@@ -2775,6 +3164,14 @@ std::tuple<LotList, QString> DocumentLotsMimeData::lots(const QMimeData *md)
     LotList lots;
     QString currencyCode;
 
+    // in-process fast path: no serialization needed
+    if (auto *lmd = qobject_cast<const DocumentLotsMimeData *>(md); lmd && !lmd->m_lots.empty()) {
+        lots.reserve(qsizetype(lmd->m_lots.size()));
+        for (const Lot &lot : lmd->m_lots)
+            lots << new Lot(lot);
+        return { lots, lmd->m_currencyCode };
+    }
+
     if (md) {
         QByteArray data = md->data(s_mimetype);
         QDataStream ds(data);
@@ -2813,7 +3210,7 @@ QStringList DocumentLotsMimeData::formats() const
 
 bool DocumentLotsMimeData::hasFormat(const QString &mimeType) const
 {
-    return mimeType.compare(s_mimetype) || mimeType.compare(u"text/plain"_qs);
+    return (mimeType == s_mimetype) || (mimeType == u"text/plain");
 }
 
 
@@ -4,6 +4,8 @@
 #pragma once
 
 #include <functional>
+#include <optional>
+#include <vector>
 
 #include <QAbstractTableModel>
 #include <QPixmap>
@@ -179,6 +181,23 @@ public:
     static MergeModes possibleMergeModesForField(Field field);
     static FieldMergeModes createFieldMergeModes(MergeMode mergeMode = MergeMode::Ignore);
     static bool canLotsBeMerged(const Lot &lot1, const Lot &lot2);
+
+    // everything canLotsBeMerged() compares: lots with equal keys can be merged
+    struct MergeKey {
+        const BrickLink::Item *item;
+        const BrickLink::Color *color;
+        BrickLink::Condition condition;
+        BrickLink::SubCondition subCondition;
+        bool excluded;
+
+        bool operator==(const MergeKey &other) const = default;
+        friend size_t qHash(const MergeKey &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.item, key.color, int(key.condition), int(key.subCondition),
+                              key.excluded);
+        }
+    };
+    static std::optional<MergeKey> mergeKey(const Lot &lot); // std::nullopt for incomplete lots
     static bool mergeLotFields(const Lot &from, Lot &to, const FieldMergeModes &fieldMergeModes);
 
     static constexpr int maxQuantity = 9999999;
@@ -291,6 +310,9 @@ public:
 
     const Lot *differenceBaseLot(const Lot *lot) const;
 
+    // lots (or their difference base) added or changed since the last call: used by autosave
+    QSet<const Lot *> takeAutosaveDirtyLots();
+
     QByteArray saveSortFilterState() const;
     bool restoreSortFilterState(const QByteArray &ba);
 
@@ -324,7 +346,7 @@ private:
     void setLotsDirect(const LotList &lots);
     void insertLotsDirect(const LotList &lots, QVector<int> &positions, QVector<int> &sortedPositions, QVector<int> &filteredPositions);
     void removeLotsDirect(const LotList &lots, QVector<int> &positions, QVector<int> &sortedPositions, QVector<int> &filteredPositions);
-    void changeLotsDirect(std::vector<std::pair<Lot *, Lot> > &changes);
+    void changeLotsDirect(const LotList &lots, const std::function<void(qsizetype, Lot *)> &swapFn);
     void changeCurrencyDirect(const QString &ccode, double crate, double *&prices);
     void resetDifferenceModeDirect(QHash<const Lot *, Lot>
                                    &differenceBase);
@@ -334,8 +356,10 @@ private:
 
     void emitDataChanged(const QModelIndex &tl = { }, const QModelIndex &br = { });
     void emitStatisticsChanged();
-    void updateLotFlags(const Lot *lot);
-    void setLotFlags(const Lot *lot, quint64 errors, quint64 updated);
+    static QPair<quint64, quint64> calculateLotFlags(const Lot *lot, const Lot *base);
+    void updateLotFlags(const LotList &lots);
+    bool setLotFlags(const Lot *lot, quint64 errors, quint64 updated);
+    void pruneStringPool();
 
     void updateModified();
 
@@ -376,6 +400,9 @@ private:
     mutable QHash<const Lot *, int> m_filteredLotIndex;
 
     QHash<const Lot *, Lot> m_differenceBase;
+    QSet<const Lot *> m_autosaveDirtyLots;
+    QSet<QString>    m_stringPool; // identical comments, remarks, ... share one copy
+    qsizetype        m_stringPoolPrunedSize = 0;
     QVector<int>     m_fakeIndexes; // for the consolidate dialogs
     QHash<const Lot *, QPair<quint64, quint64>> m_lotFlags;
 
@@ -403,6 +430,11 @@ private:
     static std::function<ConsolidateFunction> s_consolidateFunction;
 };
 
+// Copy & paste within BrickStore just copies the lots out of this immutable snapshot, which is a
+// plain copy of the selected lots (cheap, as their rarely used fields are shared). The
+// serialized form (and the item-id text) is only created when it is actually requested, e.g. by
+// another process, or right before a database update or the shutdown invalidates the snapshot.
+
 class DocumentLotsMimeData : public QMimeData
 {
     Q_OBJECT
@@ -414,8 +446,19 @@ public:
 
     static std::tuple<BrickLink::LotList, QString> lots(const QMimeData *md);
 
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
 private:
-    void setLots(const LotList &lots, const QString &currencyCode);
+    void detachFromDatabase();
+    QByteArray serializedLots() const;
+    QString itemIdText() const;
+
+    std::vector<Lot> m_lots;
+    QString m_currencyCode;
+    uint m_changelogId;
+    mutable QByteArray m_serialized;
+    mutable QString m_text;
 
     static const QString s_mimetype;
 };
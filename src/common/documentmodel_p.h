@@ -39,21 +39,41 @@ class ChangeCmd : public QUndoCommand
 public:
     ChangeCmd(DocumentModel *model, const std::vector<std::pair<Lot *, Lot>> &changes,
               DocumentModel::Field hint = DocumentModel::FieldCount);
+    ~ChangeCmd() override;
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
 
     void redo() override;
     void undo() override;
 
+    static qint64 memoryUsage() { return s_memoryUsage; }
+
 private:
     void updateText();
+    void addColumn(int field, const ChangeCmd *other = nullptr,
+                   const QHash<const Lot *, qsizetype> &otherIndex = { });
+    void updateMemoryUsage();
 
     DocumentModel *m_model;
     uint m_loopCount;
     DocumentModel::Field m_hint;
-    std::vector<std::pair<Lot *, Lot>> m_changes;
+
+    // Most edits only touch a few fields of a lot, so only these fields are recorded: one
+    // column per field with a value for every lot in m_lots. redo() and undo() swap these
+    // values with the ones in the lots.
+    LotList m_lots;
+    std::vector<std::pair<int, std::vector<double>>> m_numberColumns;
+    std::vector<std::pair<int, QVector<QVariant>>> m_variantColumns;
+
+    // changes to the item, color or incomplete state are rare: these are recorded as full copies
+    LotList m_fullLots;
+    std::vector<Lot> m_fullValues;
+
+    qint64 m_memoryUsage = 0;
 
     static QTimer *s_eventLoopCounter;
+    static qint64 s_memoryUsage;
+    static int s_memoryStatId;
 };
 
 class CurrencyCmd : public QUndoCommand
@@ -35,6 +35,7 @@ public:
     QToolButton *m_appearsIn;
     QToolButton *m_consistsOf;
     QToolButton *m_canBuild;
+    QToolButton *m_canBuildPartially;
     QToolButton *m_relations;
     QMenu *m_contextMenu;
     QAction *m_partOutAction;
@@ -95,6 +96,8 @@ InventoryWidget::InventoryWidget(bool showCanBuild, QWidget *parent)
     d->m_appearsIn  = createButton(Mode::AppearsIn,     QT_TR_NOOP("Appears in"),  "bootstrap-box-arrow-in-right");
     d->m_consistsOf = createButton(Mode::ConsistsOf,    QT_TR_NOOP("Consists of"), "bootstrap-box-arrow-right");
     d->m_canBuild   = createButton(Mode::CanBuild,      QT_TR_NOOP("Can build"),   "bootstrap-bricks");
+    d->m_canBuildPartially = createButton(Mode::CanBuildPartially, QT_TR_NOOP("Can almost build"),
+                                          "format-number-percent");
     d->m_relations  = createButton(Mode::Relationships, QT_TR_NOOP("Related"),     "bootstrap-share-fill");
 
     auto *grid = new QGridLayout(this);
@@ -103,12 +106,15 @@ InventoryWidget::InventoryWidget(bool showCanBuild, QWidget *parent)
     grid->setRowStretch(1, 10);
     grid->addWidget(d->m_appearsIn, 0, 0);
     grid->addWidget(d->m_consistsOf, 0, 1);
-    if (d->m_showCanBuild)
+    if (d->m_showCanBuild) {
         grid->addWidget(d->m_canBuild, 0, 2);
-    else
+        grid->addWidget(d->m_canBuildPartially, 0, 3);
+    } else {
         d->m_canBuild->hide();
-    grid->addWidget(d->m_relations, 0, d->m_showCanBuild ? 3 : 2);
-    grid->addWidget(d->m_view, 1, 0, 1, d->m_showCanBuild ? 4 : 3);
+        d->m_canBuildPartially->hide();
+    }
+    grid->addWidget(d->m_relations, 0, d->m_showCanBuild ? 4 : 2);
+    grid->addWidget(d->m_view, 1, 0, 1, d->m_showCanBuild ? 5 : 3);
 
     d->m_partOutAction = new QAction(this);
     d->m_partOutAction->setObjectName(u"appearsin_partoutitems"_qs);
@@ -191,7 +197,8 @@ void InventoryWidget::languageChange()
             b->setToolTip(b->text());
     };
 
-    for (auto *b : { d->m_appearsIn, d->m_consistsOf, d->m_canBuild, d->m_relations })
+    for (auto *b : { d->m_appearsIn, d->m_consistsOf, d->m_canBuild, d->m_canBuildPartially,
+                    d->m_relations })
         translateButton(b);
     d->m_partOutAction->setText(tr("Part out Item..."));
     d->m_catalogAction->setText(tr("Show BrickLink Catalog Info..."));
@@ -236,6 +243,10 @@ void InventoryWidget::setMode(Mode newMode)
             columnVisible[BrickLink::InventoryModel::QuantityColumn] = false;
             columnVisible[BrickLink::InventoryModel::ColorColumn] = false;
             break;
+        case Mode::CanBuildPartially:
+            d->m_canBuildPartially->setChecked(true);
+            columnVisible[BrickLink::InventoryModel::ColorColumn] = false;
+            break;
         case Mode::ConsistsOf:
             d->m_consistsOf->setChecked(true);
             break;
@@ -292,7 +303,8 @@ bool InventoryWidget::restoreState(const QByteArray &ba)
         return false;
 
     static QVector<int> validModes { int(Mode::AppearsIn), int(Mode::ConsistsOf),
-                                   int(Mode::CanBuild), int(Mode::Relationships) };
+                                   int(Mode::CanBuild), int(Mode::Relationships),
+                                   int(Mode::CanBuildPartially) };
     d->m_viewDelegate->setZoomFactor(zoom);
     setMode(validModes.contains(mode) ? static_cast<Mode>(mode) : Mode::AppearsIn);
 
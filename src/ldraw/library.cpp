@@ -23,6 +23,7 @@
 #endif
 
 #include "utility/exception.h"
+#include "utility/stopwatch.h"
 #include "utility/transfer.h"
 #include "minizip/minizip.h"
 #include "ldraw/library.h"
@@ -125,14 +126,15 @@ Library::Library(const QString &updateUrl, QObject *parent)
                     co_await setPath(m_path, true); // at least try to reload the old library
                     throw Exception(tr("saving failed") + u": " + error);
                 }
+                // write the new ETag first: setPath() uses it to validate the cached ZIP directory
+                if (etagf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    etagf.write(etag.toUtf8());
+                    etagf.close();
+                }
                 if (!co_await setPath(file->fileName(), true))
                     throw Exception(tr("reloading failed - please restart the application."));
 
                 m_etag = etag;
-                if (etagf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-                    etagf.write(m_etag.toUtf8());
-                    etagf.close();
-                }
 
                 emitUpdateStartedIfNecessary();
                 emit updateFinished(true, { });
@@ -287,14 +289,30 @@ QCoro::Task<bool> Library::setPath(const QString &path, bool forceReload)
     m_zip.reset();
     m_searchpath.clear();
     m_partIdMapping.clear();
+    m_resolveCache.clear();
+    m_folderRoot.clear();
+    m_folderFiles.clear();
+    m_folderIndex.clear();
+    m_folderIndexed = false;
+
+    m_etag.clear();
 
     if (valid && m_isZip) {
         QFileInfo(path).dir().mkpath(u"."_qs);
 
+        QFile f(m_path + u".etag");
+        if (f.open(QIODevice::ReadOnly))
+            m_etag = QString::fromUtf8(f.readAll());
+
         caseSensitive = false;
         auto zip = std::make_unique<MiniZip>(path);
 
-        if (co_await QtConcurrent::run([&zip]() { return zip->open(); }))
+        // the ZIP directory is cached next to the library and is only valid for this ETag
+        const QString tocCacheFileName = m_path + u".toc";
+        const QByteArray tocCacheTag = m_etag.toUtf8();
+
+        if (co_await QtConcurrent::run([&zip, tocCacheFileName, tocCacheTag]() {
+                return zip->open(tocCacheFileName, tocCacheTag); }))
             m_zip.reset(zip.release());
         else
             valid = false;
@@ -338,6 +356,9 @@ QCoro::Task<bool> Library::setPath(const QString &path, bool forceReload)
         static const std::array subdirs = { "LEGO", "Unofficial/p/48", "Unofficial/p", "p/48", "p",
                                            "Unofficial/parts", "parts", "models" };
 
+        if (!m_zip)
+            m_folderRoot = QDir(m_path).canonicalPath();
+
         for (auto subdir : subdirs) {
             if (m_zip) {
                 m_searchpath << QString(u"!ZIP!ldraw/" + QLatin1String(subdir));
@@ -352,13 +373,6 @@ QCoro::Task<bool> Library::setPath(const QString &path, bool forceReload)
             }
         }
 
-        m_etag.clear();
-        if (m_zip) {
-            QFile f(m_path + u".etag");
-            if (f.open(QIODevice::ReadOnly))
-                m_etag = QString::fromUtf8(f.readAll());
-        }
-
         m_lastUpdated = m_zip ? QFileInfo(path).lastModified() : QDateTime { };
     }
 
@@ -464,6 +478,60 @@ void Library::emitUpdateStartedIfNecessary()
 }
 
 Part *Library::findPart(const QString &_filename, const QString &_parentdir)
+{
+    // resolving a file name involves a lot of stat() calls for folder based libraries, so we
+    // remember the result - positive or negative - for every (parentdir, filename) pair
+    const auto key = qMakePair(_parentdir, _filename);
+    auto it = m_resolveCache.constFind(key);
+    if (it == m_resolveCache.cend())
+        it = m_resolveCache.insert(key, resolvePath(_filename, _parentdir));
+
+    if (it->fileName.isEmpty())
+        return nullptr;
+
+    const QString filename = it->fileName;
+    const QString parentdir = it->parentDir;
+    const bool inZip = it->inZip;
+
+    Part *p = m_cache[filename];
+    if (!p) {
+        QByteArray data;
+
+        if (inZip) {
+            try {
+                data = m_zip->readFile(filename);
+            } catch (const Exception &e) {
+                qCWarning(LogLDraw) << "Failed to read from LDraw ZIP:" << e.errorString();
+            }
+        } else {
+            QFile f(filename);
+
+            if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                qCWarning(LogLDraw) << "Failed to open file" << filename << ":" << f.errorString();
+            } else {
+                data = f.readAll();
+                if (f.error() != QFile::NoError)
+                    qCWarning(LogLDraw) << "Failed to read file" << filename << ":" << f.errorString();
+                f.close();
+            }
+        }
+        if (!data.isEmpty()) {
+            p = Part::parse(data, parentdir);
+            if (p) {
+                if (!m_cache.insert(filename, p, p->cost())) {
+                    qCWarning(LogLDraw) << "Unable to cache file" << filename;
+                    p = nullptr;
+                }
+
+                //qCInfo(LogLDraw) << "Cache at" << m_cache.totalCost() << "/" <<  m_cache.maxCost() << "with" << m_cache.size() << "parts";
+            }
+        }
+    }
+    return p;
+}
+
+
+Library::ResolvedPath Library::resolvePath(const QString &_filename, const QString &_parentdir)
 {
     QString filename = _filename;
     filename.replace(u'\\', u'/');
@@ -503,12 +571,8 @@ Part *Library::findPart(const QString &_filename, const QString &_parentdir)
                     break;
                 }
             } else {
-                QString testname = sp + u'/' + filename;
-#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS) && !defined(Q_OS_IOS)
-                if (!QFile::exists(testname))
-                    testname = testname.toLower();
-#endif
-                if (QFile::exists(testname)) {
+                QString testname = existingFileName(sp + u'/' + filename);
+                if (!testname.isEmpty()) {
                     filename = testname;
                     parentdir = QFileInfo(testname).path();
                     found = true;
@@ -517,58 +581,76 @@ Part *Library::findPart(const QString &_filename, const QString &_parentdir)
             }
         }
     } else {
-#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS) && !defined(Q_OS_IOS)
-        if (!QFile::exists(filename))
-            filename = filename.toLower();
-#endif
-        if (QFile::exists(filename)) {
+        filename = existingFileName(filename);
+        if (!filename.isEmpty()) {
             parentdir = QFileInfo(filename).path();
             found = true;
         }
     }
 
     if (!found)
-        return nullptr;
+        return { };
     if (!inZip)
         filename = QFileInfo(filename).canonicalFilePath();
 
-    Part *p = m_cache[filename];
-    if (!p) {
-        QByteArray data;
-
-        if (inZip) {
-            try {
-                data = m_zip->readFile(filename);
-            } catch (const Exception &e) {
-                qCWarning(LogLDraw) << "Failed to read from LDraw ZIP:" << e.errorString();
-            }
-        } else {
-            QFile f(filename);
-
-            if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                qCWarning(LogLDraw) << "Failed to open file" << filename << ":" << f.errorString();
-            } else {
-                data = f.readAll();
-                if (f.error() != QFile::NoError)
-                    qCWarning(LogLDraw) << "Failed to read file" << filename << ":" << f.errorString();
-                f.close();
-            }
-        }
-        if (!data.isEmpty()) {
-            p = Part::parse(data, parentdir);
-            if (p) {
-                if (!m_cache.insert(filename, p, p->cost())) {
-                    qCWarning(LogLDraw) << "Unable to cache file" << filename;
-                    p = nullptr;
-                }
+    return { filename, parentdir, inZip };
+}
 
-                //qCInfo(LogLDraw) << "Cache at" << m_cache.totalCost() << "/" <<  m_cache.maxCost() << "with" << m_cache.size() << "parts";
-            }
+QString Library::existingFileName(const QString &fileName)
+{
+    // files within a folder based library are looked up in the directory index
+    if (!m_isZip && !m_folderRoot.isEmpty()) {
+        const QString cleanFileName = QDir::cleanPath(fileName);
+
+        if ((cleanFileName.size() > m_folderRoot.size())
+                && cleanFileName.startsWith(m_folderRoot)
+                && (cleanFileName.at(m_folderRoot.size()) == u'/')) {
+            if (!m_folderIndexed)
+                buildFolderIndex();
+
+            // same as the stat() based lookup below: the exact name first, then its lower-case
+            // version on case-sensitive systems and any case variant on all the others
+            const QString relativePath = cleanFileName.mid(m_folderRoot.size() + 1);
+            if (m_folderFiles.contains(relativePath))
+                return cleanFileName;
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS) && !defined(Q_OS_IOS)
+            const QString lowerPath = relativePath.toLower();
+            if (m_folderFiles.contains(lowerPath))
+                return m_folderRoot + u'/' + lowerPath;
+#else
+            auto it = m_folderIndex.constFind(relativePath.toLower());
+            if (it != m_folderIndex.cend())
+                return m_folderRoot + u'/' + *it;
+#endif
+            return { };
         }
     }
-    return p;
+
+    QString testname = fileName;
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS) && !defined(Q_OS_IOS)
+    if (!QFile::exists(testname))
+        testname = testname.toLower();
+#endif
+    return QFile::exists(testname) ? testname : QString { };
 }
 
+void Library::buildFolderIndex()
+{
+    stopwatch sw("Indexing the LDraw folder");
+
+    m_folderIndexed = true;
+    m_folderFiles.clear();
+    m_folderIndex.clear();
+
+    QDirIterator dit(m_folderRoot, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (dit.hasNext()) {
+        const QString relativePath = dit.next().mid(m_folderRoot.size() + 1);
+        m_folderFiles.insert(relativePath);
+#if !defined(Q_OS_UNIX) || defined(Q_OS_MACOS) || defined(Q_OS_IOS)
+        m_folderIndex.insert(relativePath.toLower(), relativePath);
+#endif
+    }
+}
 
 bool Library::checkLDrawDir(const QString &ldir)
 {
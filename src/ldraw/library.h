@@ -5,6 +5,7 @@
 
 #include <QObject>
 #include <QHash>
+#include <QSet>
 #include <QDateTime>
 #include <QString>
 #include <QByteArray>
@@ -86,8 +87,18 @@ private:
     friend Library *library();
     friend Library *create(const QString &);
 
+    struct ResolvedPath
+    {
+        QString fileName;  // empty, if the file could not be found
+        QString parentDir;
+        bool inZip = false;
+    };
+
     void partLoaderThread();
     Part *findPart(const QString &_filename, const QString &_parentdir);
+    ResolvedPath resolvePath(const QString &_filename, const QString &_parentdir);
+    QString existingFileName(const QString &fileName);
+    void buildFolderIndex();
     QByteArray readLDrawFile(const QString &filename);
     void setUpdateStatus(UpdateStatus updateStatus);
     void emitUpdateStartedIfNecessary();
@@ -112,6 +123,13 @@ private:
     QHash<QString, QString> m_partIdMapping;
     Q3Cache<QString, Part> m_cache;  // path -> part
 
+    // only accessed from the part loader thread, reset in setPath()
+    QHash<QPair<QString, QString>, ResolvedPath> m_resolveCache; // (parentdir, filename) -> path
+    QString m_folderRoot;
+    QSet<QString> m_folderFiles; // paths relative to m_folderRoot
+    QHash<QString, QString> m_folderIndex; // lower-case path -> path, on case-insensitive systems
+    bool m_folderIndexed = false;
+
     QVector<PartLoaderJob *> m_partLoaderJobs;
     QMutex m_partLoaderMutex;
     QWaitCondition m_partLoaderCondition;
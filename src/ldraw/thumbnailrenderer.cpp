@@ -0,0 +1,249 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "bricklink/color.h"
+#include "bricklink/core.h"
+#include "ldraw/part.h"
+#include "ldraw/thumbnailrenderer.h"
+
+
+namespace LDraw {
+
+ThumbnailRenderer::ThumbnailRenderer(const QSize &size, const QQuaternion &rotation,
+                                     int supersampling)
+    : m_size(size)
+    , m_rotation(rotation)
+    , m_supersampling(std::clamp(supersampling, 1, 4))
+{ }
+
+QQuaternion ThumbnailRenderer::defaultRotation()
+{
+    // the same as the default in RenderSettings
+    return QQuaternion::fromEulerAngles(-24, -138, 160);
+}
+
+void ThumbnailRenderer::collectGeometry(const Part *part, const BrickLink::Color *modelColor,
+                                        const BrickLink::Color *baseColor, const QMatrix4x4 &matrix,
+                                        QVector<Triangle> &triangles, QVector<Line> &lines)
+{
+    if (!part)
+        return;
+
+    auto mapColor = [&baseColor, &modelColor](int colorId) -> const BrickLink::Color * {
+        auto c = (colorId == 16) ? (baseColor ? baseColor : modelColor)
+                                 : BrickLink::core()->colorFromLDrawId(colorId);
+        if (!c && colorId >= 256)
+            c = BrickLink::core()->colorFromLDrawId((colorId - 256) & 0x0f);
+        if (!c)
+            c = BrickLink::core()->color(9 /*light gray*/);
+        return c;
+    };
+
+    auto mapQColor = [&mapColor](int colorId) -> QColor {
+        if (auto *c = mapColor(colorId))
+            return c->ldrawColor().isValid() ? c->ldrawColor() : c->color();
+        return Qt::lightGray;
+    };
+
+    auto mapEdgeQColor = [&baseColor, &modelColor](int colorId) -> QColor {
+        if (colorId == 24) {
+            if (baseColor)
+                return baseColor->ldrawEdgeColor();
+            else if (modelColor)
+                return modelColor->ldrawEdgeColor();
+        } else if (auto *c = BrickLink::core()->colorFromLDrawId(colorId)) {
+            return c->ldrawColor();
+        }
+        return Qt::black;
+    };
+
+    // there's no backface culling in this renderer, so we can simply ignore all BFC commands
+
+    const auto &elements = part->elements();
+    for (const Element *e : elements) {
+        switch (e->type()) {
+        case Element::Type::Triangle: {
+            const auto te = static_cast<const TriangleElement *>(e);
+            const auto p = te->points();
+            triangles.append({ { matrix.map(p[0]), matrix.map(p[1]), matrix.map(p[2]) },
+                               mapQColor(te->color()) });
+            break;
+        }
+        case Element::Type::Quad: {
+            const auto qe = static_cast<const QuadElement *>(e);
+            const auto p = qe->points();
+            const auto p0m = matrix.map(p[0]);
+            const auto p2m = matrix.map(p[2]);
+            const auto color = mapQColor(qe->color());
+            triangles.append({ { p0m, matrix.map(p[1]), p2m }, color });
+            triangles.append({ { p2m, matrix.map(p[3]), p0m }, color });
+            break;
+        }
+        case Element::Type::Line: {
+            const auto le = static_cast<const LineElement *>(e);
+            const auto p = le->points();
+            lines.append({ { matrix.map(p[0]), matrix.map(p[1]) }, mapEdgeQColor(le->color()) });
+            break;
+        }
+        case Element::Type::Part: {
+            const auto pe = static_cast<const PartElement *>(e);
+            collectGeometry(pe->part(), modelColor, mapColor(pe->color()), matrix * pe->matrix(),
+                            triangles, lines);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+QImage ThumbnailRenderer::render(const Part *part, const BrickLink::Color *color) const
+{
+    if (!part || m_size.isEmpty())
+        return { };
+
+    QVector<Triangle> triangles;
+    QVector<Line> lines;
+
+    QMatrix4x4 rotation;
+    rotation.rotate(m_rotation);
+    collectGeometry(part, color, color, rotation, triangles, lines);
+
+    if (triangles.isEmpty())
+        return { };
+
+    // fit the bounding box into the image
+    static constexpr auto fmax = std::numeric_limits<float>::max();
+    QVector3D vmin(fmax, fmax, fmax);
+    QVector3D vmax(-fmax, -fmax, -fmax);
+
+    for (const auto &t : std::as_const(triangles)) {
+        for (const auto &p : t.p) {
+            vmin = QVector3D(std::min(vmin.x(), p.x()), std::min(vmin.y(), p.y()), std::min(vmin.z(), p.z()));
+            vmax = QVector3D(std::max(vmax.x(), p.x()), std::max(vmax.y(), p.y()), std::max(vmax.z(), p.z()));
+        }
+    }
+
+    const int w = m_size.width() * m_supersampling;
+    const int h = m_size.height() * m_supersampling;
+    const QVector3D center = (vmin + vmax) / 2;
+    const float extentX = std::max(vmax.x() - vmin.x(), 1.f);
+    const float extentY = std::max(vmax.y() - vmin.y(), 1.f);
+    const float scale = 0.95f * std::min(float(w) / extentX, float(h) / extentY);
+
+    // orthographic projection into image coordinates: Qt Quick 3D is y-up, the camera looks
+    // down the negative z axis, so larger z values are closer to the viewer
+    auto project = [=](const QVector3D &p) {
+        return QVector3D((p.x() - center.x()) * scale + float(w) / 2,
+                         (center.y() - p.y()) * scale + float(h) / 2,
+                         p.z());
+    };
+
+    QImage img(w, h, QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::transparent);
+    std::vector<float> depth(size_t(w) * size_t(h), -fmax);
+
+    const QVector3D lightDir = QVector3D(0.3f, 0.5f, 1.f).normalized();
+
+    auto rasterize = [&](const Triangle &t, bool transparentPass) {
+        const bool isTransparent = (t.color.alpha() < 255);
+        if (isTransparent != transparentPass)
+            return;
+
+        QVector3D n = QVector3D::normal(t.p[0], t.p[1], t.p[2]);
+        float intensity = 0.35f + 0.65f * std::abs(QVector3D::dotProduct(n, lightDir));
+        QColor shaded = QColor::fromRgbF(std::min(1.f, t.color.redF() * intensity),
+                                         std::min(1.f, t.color.greenF() * intensity),
+                                         std::min(1.f, t.color.blueF() * intensity),
+                                         t.color.alphaF());
+        const QRgb rgb = qPremultiply(shaded.rgba());
+        const int alpha = qAlpha(rgb);
+
+        const QVector3D a = project(t.p[0]);
+        const QVector3D b = project(t.p[1]);
+        const QVector3D c = project(t.p[2]);
+
+        const float area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+        if (qFuzzyIsNull(area))
+            return;
+
+        const int x0 = std::max(0, int(std::floor(std::min({ a.x(), b.x(), c.x() }))));
+        const int x1 = std::min(w - 1, int(std::ceil(std::max({ a.x(), b.x(), c.x() }))));
+        const int y0 = std::max(0, int(std::floor(std::min({ a.y(), b.y(), c.y() }))));
+        const int y1 = std::min(h - 1, int(std::ceil(std::max({ a.y(), b.y(), c.y() }))));
+
+        for (int y = y0; y <= y1; ++y) {
+            auto *scanLine = reinterpret_cast<QRgb *>(img.scanLine(y));
+            const float py = float(y) + 0.5f;
+
+            for (int x = x0; x <= x1; ++x) {
+                const float px = float(x) + 0.5f;
+                const float w0 = ((b.x() - px) * (c.y() - py) - (b.y() - py) * (c.x() - px)) / area;
+                const float w1 = ((c.x() - px) * (a.y() - py) - (c.y() - py) * (a.x() - px)) / area;
+                const float w2 = 1.f - w0 - w1;
+                if ((w0 < 0) || (w1 < 0) || (w2 < 0))
+                    continue;
+
+                const float z = w0 * a.z() + w1 * b.z() + w2 * c.z();
+                float &d = depth[size_t(y) * size_t(w) + size_t(x)];
+                if (z < d)
+                    continue;
+
+                if (isTransparent) {
+                    // blend without writing the depth
+                    const QRgb dst = scanLine[x];
+                    const int ia = 255 - alpha;
+                    scanLine[x] = qRgba(qRed(rgb) + qRed(dst) * ia / 255,
+                                        qGreen(rgb) + qGreen(dst) * ia / 255,
+                                        qBlue(rgb) + qBlue(dst) * ia / 255,
+                                        alpha + qAlpha(dst) * ia / 255);
+                } else {
+                    d = z;
+                    scanLine[x] = rgb;
+                }
+            }
+        }
+    };
+
+    for (const auto &t : std::as_const(triangles))
+        rasterize(t, false);
+
+    // edges are drawn on top of opaque surfaces with a small depth bias towards the viewer
+    const float depthBias = 0.5f;
+
+    for (const auto &l : std::as_const(lines)) {
+        const QVector3D a = project(l.p[0]);
+        const QVector3D b = project(l.p[1]);
+        const QRgb rgb = qPremultiply(l.color.rgba());
+        const int steps = int(std::ceil(std::max(std::abs(b.x() - a.x()), std::abs(b.y() - a.y())))) + 1;
+
+        for (int i = 0; i <= steps; ++i) {
+            const float f = float(i) / float(steps);
+            const QVector3D p = a + (b - a) * f;
+            const int x = int(p.x());
+            const int y = int(p.y());
+            if ((x < 0) || (y < 0) || (x >= w) || (y >= h))
+                continue;
+
+            float &d = depth[size_t(y) * size_t(w) + size_t(x)];
+            if ((p.z() + depthBias) >= d) {
+                d = p.z();
+                reinterpret_cast<QRgb *>(img.scanLine(y))[x] = rgb;
+            }
+        }
+    }
+
+    for (const auto &t : std::as_const(triangles))
+        rasterize(t, true);
+
+    if (m_supersampling > 1)
+        img = img.scaled(m_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return img.convertToFormat(QImage::Format_ARGB32);
+}
+
+} // namespace LDraw
@@ -0,0 +1,57 @@
+// Copyright (C) 2004-2023 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include <QtCore/QSize>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QQuaternion>
+#include <QtGui/QVector3D>
+
+#include "bricklink/global.h"
+
+
+namespace LDraw {
+
+class Part;
+
+// A CPU-only renderer for part thumbnails: it doesn't need a GPU, a QPA or a QML engine, so it
+// can be used in headless backends. render() is re-entrant: a single renderer can be shared
+// between worker threads, as long as the Part stays ref'ed while rendering.
+
+class ThumbnailRenderer
+{
+public:
+    ThumbnailRenderer(const QSize &size, const QQuaternion &rotation = defaultRotation(),
+                      int supersampling = 2);
+
+    QSize size() const  { return m_size; }
+
+    QImage render(const Part *part, const BrickLink::Color *color) const;
+
+    static QQuaternion defaultRotation();
+
+private:
+    struct Triangle
+    {
+        QVector3D p[3];
+        QColor color;
+    };
+    struct Line
+    {
+        QVector3D p[2];
+        QColor color;
+    };
+
+    static void collectGeometry(const Part *part, const BrickLink::Color *modelColor,
+                                const BrickLink::Color *baseColor, const QMatrix4x4 &matrix,
+                                QVector<Triangle> &triangles, QVector<Line> &lines);
+
+    QSize m_size;
+    QQuaternion m_rotation;
+    int m_supersampling;
+};
+
+} // namespace LDraw
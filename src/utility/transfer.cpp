@@ -30,14 +30,20 @@ TransferJob *TransferJob::get(const QUrl &url, QIODevice *file, uint retries)
     return create(HttpGet, url, { }, { }, file, false, retries);
 }
 
-TransferJob *TransferJob::getIfNewer(const QUrl &url, const QDateTime &ifnewer, QIODevice *file)
+TransferJob *TransferJob::getIfNewer(const QUrl &url, const QDateTime &ifnewer, QIODevice *file,
+                                     uint retries)
 {
-    return create(HttpGet, url, ifnewer, { }, file, false);
+    Q_ASSERT(retries < 31);
+
+    return create(HttpGet, url, ifnewer, { }, file, false, retries);
 }
 
-TransferJob *TransferJob::getIfDifferent(const QUrl &url, const QString &etag, QIODevice *file)
+TransferJob *TransferJob::getIfDifferent(const QUrl &url, const QString &etag, QIODevice *file,
+                                         uint retries)
 {
-    return create(HttpGet, url, { }, etag, file, false);
+    Q_ASSERT(retries < 31);
+
+    return create(HttpGet, url, { }, etag, file, false, retries);
 }
 
 TransferJob *TransferJob::post(const QUrl &url, QIODevice *file, bool noRedirects)
@@ -245,30 +251,121 @@ void Transfer::setInitFunction(const std::function<void ()> &func)
     s_threadInitFunction = func;
 }
 
+void Transfer::setMaxConnectionsPerHost(int maxConnections, const QString &host)
+{
+    QMetaObject::invokeMethod(m_retriever, [this, maxConnections, host]() {
+        m_retriever->setMaxConnectionsPerHost(maxConnections, host);
+    }, Qt::QueuedConnection);
+}
+
+void Transfer::setHttp2Enabled(bool enabled, const QString &host)
+{
+    QMetaObject::invokeMethod(m_retriever, [this, enabled, host]() {
+        m_retriever->setHttp2Enabled(enabled, host);
+    }, Qt::QueuedConnection);
+}
+
 
 #include "moc_transfer.cpp"
 
+// QNAM opens at most 6 HTTP/1.1 connections per host: queueing more requests than that inside
+// QNAM would only make them impossible to reprioritize or coalesce
+static constexpr int DefaultHttp1Connections = 6;
+// HTTP/2 multiplexes all requests over a single connection, so we can have a lot more in flight
+static constexpr int DefaultHttp2Streams = 64;
+// low priority jobs that have been waiting for longer than this get every 4th connection slot,
+// so background refreshes keep going while the user scrolls through picture-heavy views
+static constexpr qint64 MaxLowPriorityWait = 10000;
+static constexpr uint AgedJobSlot = 4;
+
+
 TransferRetriever::TransferRetriever(Transfer *transfer)
     : QObject()
     , m_transfer(transfer)
-    , m_maxConnections(6) // mirror the internal QNAM setting
-{ }
+{
+    m_clock.start();
+}
 
 TransferRetriever::~TransferRetriever()
 {
     abortAllJobs();
 }
 
+void TransferRetriever::setMaxConnectionsPerHost(int maxConnections, const QString &host)
+{
+    if (host.isEmpty())
+        m_defaultHostPolicy.maxConnections = maxConnections;
+    else
+        m_hostPolicies[host].maxConnections = maxConnections;
+    schedule();
+}
+
+void TransferRetriever::setHttp2Enabled(bool enabled, const QString &host)
+{
+    if (host.isEmpty())
+        m_defaultHostPolicy.http2 = enabled ? 1 : 0;
+    else
+        m_hostPolicies[host].http2 = enabled ? 1 : 0;
+    schedule();
+}
+
+TransferRetriever::HostPolicy TransferRetriever::hostPolicy(const QString &host) const
+{
+    HostPolicy hp = m_hostPolicies.value(host);
+    if (hp.maxConnections < 0)
+        hp.maxConnections = m_defaultHostPolicy.maxConnections;
+    if (hp.http2 < 0)
+        hp.http2 = std::max(0, m_defaultHostPolicy.http2); // off by default: QTBUG-105043
+    return hp;
+}
+
+int TransferRetriever::maxConnectionsForHost(const QString &host) const
+{
+    const auto hp = hostPolicy(host);
+    if (hp.maxConnections > 0)
+        return hp.maxConnections;
+    return hp.http2 ? DefaultHttp2Streams : DefaultHttp1Connections;
+}
+
+QByteArray TransferRetriever::coalesceKey(const TransferJob *job)
+{
+    // only plain GETs can be shared: the result has to be identical for all requesters.
+    // Jobs that stream into a device cannot lead, as their data is not kept around.
+    if ((job->m_http_method != TransferJob::HttpGet) || job->m_no_redirects || job->m_file)
+        return { };
+
+    QByteArray key = job->m_url.toEncoded();
+    if (job->m_only_if_newer.isValid())
+        key = key + "\nIMS:" + QByteArray::number(job->m_only_if_newer.toMSecsSinceEpoch());
+    if (!job->m_only_if_different.isEmpty())
+        key = key + "\nINM:" + job->m_only_if_different.toUtf8();
+    return key;
+}
+
 void TransferRetriever::addJob(TransferJob *job, bool highPriority)
 {
     if (job->isAborted()) {
         emit finished(job);
         emit m_transfer->overallProgress(++m_progressDone, ++m_progressTotal);
+        return;
+    }
+
+    const QByteArray key = coalesceKey(job);
+    if (TransferJob *leader = key.isEmpty() ? nullptr : m_coalesceLeaders.value(key)) {
+        m_coalescedJobs[leader].append(job);
+        job->m_coalescedWith = leader;
+        m_transfer->m_coalescedJobCount.fetchAndAddRelaxed(1);
+        qCInfo(LogTransfer) << "== COALESCED" << job->m_url;
+
+        if (highPriority && leader->isInactive() && !leader->m_high_priority)
+            reprioritizeJob(leader, true);
+        emit m_transfer->overallProgress(m_progressDone, ++m_progressTotal);
     } else {
-        if (highPriority)
-            m_jobs.prepend(job);
-        else
-            m_jobs.append(job);
+        if (!key.isEmpty())
+            m_coalesceLeaders.insert(key, job);
+
+        job->m_high_priority = highPriority;
+        enqueue(job);
 
         emit m_transfer->overallProgress(m_progressDone, ++m_progressTotal);
         schedule();
@@ -277,20 +374,141 @@ void TransferRetriever::addJob(TransferJob *job, bool highPriority)
 
 void TransferRetriever::reprioritizeJob(TransferJob *job, bool highPriority)
 {
-    if (job->isInactive()) {
-        auto idx = m_jobs.indexOf(job);
-        if (idx != -1) {
-            job->m_high_priority = highPriority;
-            m_jobs.move(idx, highPriority ? 0 : m_jobs.size());
+    if (job->isInactive() && job->m_queued && (job->m_high_priority != highPriority)) {
+        dequeue(job);
+        job->m_high_priority = highPriority;
+        enqueue(job);
+    }
+}
+
+void TransferRetriever::JobList::prepend(TransferJob *job)
+{
+    job->m_queuePrev = nullptr;
+    job->m_queueNext = first;
+    if (first)
+        first->m_queuePrev = job;
+    else
+        last = job;
+    first = job;
+}
+
+void TransferRetriever::JobList::append(TransferJob *job)
+{
+    job->m_queuePrev = last;
+    job->m_queueNext = nullptr;
+    if (last)
+        last->m_queueNext = job;
+    else
+        first = job;
+    last = job;
+}
+
+void TransferRetriever::JobList::remove(TransferJob *job)
+{
+    if (job->m_queuePrev)
+        job->m_queuePrev->m_queueNext = job->m_queueNext;
+    else
+        first = job->m_queueNext;
+    if (job->m_queueNext)
+        job->m_queueNext->m_queuePrev = job->m_queuePrev;
+    else
+        last = job->m_queuePrev;
+    job->m_queuePrev = job->m_queueNext = nullptr;
+}
+
+void TransferRetriever::enqueue(TransferJob *job)
+{
+    Q_ASSERT(!job->m_queued);
+
+    auto &queue = m_queues[job->m_url.host()];
+    // high priority jobs are LIFO (the last requested picture is the one the user is looking at),
+    // low priority ones are FIFO
+    if (job->m_high_priority)
+        queue.high.prepend(job);
+    else
+        queue.low.append(job);
+    job->m_queuedAt = m_clock.elapsed();
+    job->m_queued = true;
+    ++m_queuedCount;
+}
+
+void TransferRetriever::dequeue(TransferJob *job)
+{
+    Q_ASSERT(job->m_queued);
+
+    auto it = m_queues.find(job->m_url.host());
+    Q_ASSERT(it != m_queues.end());
+    (job->m_high_priority ? it->high : it->low).remove(job);
+    if (it->high.isEmpty() && it->low.isEmpty())
+        m_queues.erase(it);
+    job->m_queued = false;
+    --m_queuedCount;
+}
+
+TransferJob *TransferRetriever::takeNextJob(HostQueue &queue)
+{
+    TransferJob *job = queue.high.first;
+
+    if (!queue.low.isEmpty()) {
+        if (!job) {
+            job = queue.low.first;
+        } else if ((m_clock.elapsed() - queue.low.first->m_queuedAt) > MaxLowPriorityWait) {
+            if (++queue.highServedInARow >= AgedJobSlot)
+                job = queue.low.first;
         }
     }
+    if (job == queue.low.first)
+        queue.highServedInARow = 0;
+
+    (job->m_high_priority ? queue.high : queue.low).remove(job);
+    job->m_queued = false;
+    --m_queuedCount;
+    return job;
 }
 
 void TransferRetriever::abortJob(TransferJob *j)
 {
+    // a follower can just be dropped from its leader
+    if (TransferJob *leader = j->m_coalescedWith) {
+        auto it = m_coalescedJobs.find(leader);
+        Q_ASSERT(it != m_coalescedJobs.end());
+        it->removeOne(j);
+        if (it->isEmpty())
+            m_coalescedJobs.erase(it);
+        j->m_coalescedWith = nullptr;
+        j->setStatus(TransferJob::Aborted);
+        emit finished(j);
+
+        m_progressDone++;
+        emit overallProgress(m_progressDone, m_progressTotal);
+        if (m_progressDone == m_progressTotal)
+            m_progressDone = m_progressTotal = 0;
+        return;
+    }
+
+    // an aborted leader hands its followers over to the first one of them
+    const QByteArray key = coalesceKey(j);
+    if (!key.isEmpty() && (m_coalesceLeaders.value(key) == j)) {
+        m_coalesceLeaders.remove(key);
+        auto followers = m_coalescedJobs.take(j);
+        if (!followers.isEmpty()) {
+            TransferJob *newLeader = followers.takeFirst();
+            newLeader->m_coalescedWith = nullptr;
+            m_coalesceLeaders.insert(key, newLeader);
+            if (!followers.isEmpty()) {
+                for (auto *f : std::as_const(followers))
+                    f->m_coalescedWith = newLeader;
+                m_coalescedJobs.insert(newLeader, followers);
+            }
+            enqueue(newLeader);
+            QMetaObject::invokeMethod(this, &TransferRetriever::schedule, Qt::QueuedConnection);
+        }
+    }
+
     j->abortInternal();
 
-    if (m_jobs.removeOne(j)) {
+    if (j->m_queued) {
+        dequeue(j);
         emit finished(j);
 
         m_progressDone++;
@@ -302,17 +520,35 @@ void TransferRetriever::abortJob(TransferJob *j)
 
 void TransferRetriever::abortAllJobs()
 {
-    for (auto &j : std::as_const(m_jobs)) {
-        j->abortInternal();
-        emit finished(j);
+    for (const auto &followers : std::as_const(m_coalescedJobs)) {
+        for (auto *j : followers) {
+            j->m_coalescedWith = nullptr;
+            j->setStatus(TransferJob::Aborted);
+            emit finished(j);
+            m_progressDone++;
+        }
+    }
+    m_coalescedJobs.clear();
+    m_coalesceLeaders.clear();
+
+    for (auto &queue : m_queues) {
+        for (auto *list : { &queue.high, &queue.low }) {
+            while (auto *j = list->first) {
+                list->remove(j);
+                j->m_queued = false;
+                j->abortInternal();
+                emit finished(j);
+            }
+        }
     }
 
-    m_progressDone += m_jobs.size();
+    m_progressDone += m_queuedCount;
     emit overallProgress(m_progressDone, m_progressTotal);
     if (m_progressDone == m_progressTotal)
         m_progressDone = m_progressTotal = 0;
 
-    m_jobs.clear();
+    m_queues.clear();
+    m_queuedCount = 0;
 
     for (auto &j : std::as_const(m_currentJobs))
         j->abortInternal();
@@ -327,77 +563,133 @@ void TransferRetriever::schedule()
                 this, &TransferRetriever::downloadFinished);
     }
 
-    while ((m_currentJobs.size() < m_maxConnections) && !m_jobs.isEmpty()) {
-        auto j = m_jobs.takeFirst();
-
-        bool isget = (j->m_http_method == TransferJob::HttpGet);
-        QUrl url = j->url();
-        j->m_effective_url = url;
+    // each host has its own connection pool: a busy host must not block the jobs for the others
+    for (auto it = m_queues.begin(); it != m_queues.end(); ) {
+        const QString host = it.key();
+        const int maxConnections = maxConnectionsForHost(host);
+        int &activeJobs = m_activeJobsPerHost[host];
 
-        QNetworkRequest req(url);
-        req.setAttribute(QNetworkRequest::Http2AllowedAttribute, false); // QTBUG-105043
-        req.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
-        req.setHeader(QNetworkRequest::UserAgentHeader, m_transfer->userAgent());
-        if (j->m_no_redirects) {
-            req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                             QNetworkRequest::ManualRedirectPolicy);
+        while ((activeJobs < maxConnections) && (!it->high.isEmpty() || !it->low.isEmpty())) {
+            ++activeJobs;
+            startJob(takeNextJob(*it));
         }
 
-        auto ssl = req.sslConfiguration();
-        ssl.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
-        QByteArray sslSession = m_sslSessionForHost.value(url.host());
-        if (!sslSession.isEmpty())
-            ssl.setSessionTicket(sslSession);
-        req.setSslConfiguration(ssl);
-
-        j->setStatus(TransferJob::Active);
-        if (isget) {
-            if (j->m_only_if_newer.isValid())
-                req.setHeader(QNetworkRequest::IfModifiedSinceHeader, j->m_only_if_newer);
-            if (!j->m_only_if_different.isEmpty())
-                req.setHeader(QNetworkRequest::IfNoneMatchHeader, j->m_only_if_different);
-            j->m_reply = m_nam->get(req);
-        } else {
-            QByteArray postdata;
+        if (it->high.isEmpty() && it->low.isEmpty())
+            it = m_queues.erase(it);
+        else
+            ++it;
+    }
+}
 
-            if (!j->m_postContentType.isEmpty()) {
-                req.setHeader(QNetworkRequest::ContentTypeHeader, j->m_postContentType);
-                postdata = j->m_postContent;
-            } else {
-                req.setHeader(QNetworkRequest::ContentTypeHeader, u"application/x-www-form-urlencoded"_qs);
-                postdata = url.query(QUrl::FullyEncoded).toLatin1();
-                url.setQuery(QUrlQuery());
-                req.setUrl(url);
-            }
-            j->m_reply = m_nam->post(req, postdata);
+void TransferRetriever::startJob(TransferJob *j)
+{
+    const QString host = j->url().host();
+
+    bool isget = (j->m_http_method == TransferJob::HttpGet);
+    QUrl url = j->url();
+    j->m_effective_url = url;
+
+    const bool http2 = hostPolicy(host).http2;
+
+    // QNAM negotiates and decodes compressed responses (gzip, deflate and, depending on the Qt
+    // build, br and zstd) by itself, as long as we do not set our own Accept-Encoding header
+    QNetworkRequest req(url);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    // big store inventories compress extremely well: don't let QNAM mistake them for zip bombs
+    req.setDecompressedSafetyCheckThreshold(256 * 1024 * 1024);
+#endif
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2); // QTBUG-105043
+    req.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, !http2);
+    req.setHeader(QNetworkRequest::UserAgentHeader, m_transfer->userAgent());
+    if (j->m_no_redirects) {
+        req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                         QNetworkRequest::ManualRedirectPolicy);
+    }
+
+    auto ssl = req.sslConfiguration();
+    ssl.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    QByteArray sslSession = m_sslSessionForHost.value(url.host());
+    if (!sslSession.isEmpty())
+        ssl.setSessionTicket(sslSession);
+    req.setSslConfiguration(ssl);
+
+    j->setStatus(TransferJob::Active);
+    if (isget) {
+        if (j->m_only_if_newer.isValid())
+            req.setHeader(QNetworkRequest::IfModifiedSinceHeader, j->m_only_if_newer);
+        if (!j->m_only_if_different.isEmpty())
+            req.setHeader(QNetworkRequest::IfNoneMatchHeader, j->m_only_if_different);
+        j->m_reply = m_nam->get(req);
+    } else {
+        QByteArray postdata;
+
+        if (!j->m_postContentType.isEmpty()) {
+            req.setHeader(QNetworkRequest::ContentTypeHeader, j->m_postContentType);
+            postdata = j->m_postContent;
+        } else {
+            req.setHeader(QNetworkRequest::ContentTypeHeader, u"application/x-www-form-urlencoded"_qs);
+            postdata = url.query(QUrl::FullyEncoded).toLatin1();
+            url.setQuery(QUrlQuery());
+            req.setUrl(url);
         }
+        j->m_reply = m_nam->post(req, postdata);
+    }
+
+    qCInfo(LogTransfer) << (isget ? ">> GET" : ">> POST") << req.url();
+    if (LogTransfer().isDebugEnabled()) {
+        const auto headers = j->m_reply->request().rawHeaderList();
+        for (const auto &header : headers)
+            qCDebug(LogTransfer()) << header << ":" << j->m_reply->request().rawHeader(header);
+    }
+
+    watchReply(j);
+
+    connect(j->m_reply, &QNetworkReply::downloadProgress, this, [this, j](qint64 recv, qint64 total) {
+        emit progress(j, int(recv), int(total));
+    });
 
-        qCInfo(LogTransfer) << (isget ? ">> GET" : ">> POST") << req.url();
+    connect(j->m_reply, &QNetworkReply::metaDataChanged, this, [j]() {
+        qCInfo(LogTransfer) << "<< REPLY" << j->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toUInt()
+                            << j->m_effective_url;
         if (LogTransfer().isDebugEnabled()) {
-            const auto headers = j->m_reply->request().rawHeaderList();
+            const auto headers = j->m_reply->rawHeaderList();
             for (const auto &header : headers)
-                qCDebug(LogTransfer()) << header << ":" << j->m_reply->request().rawHeader(header);
+                qCDebug(LogTransfer()) << header << ":" << j->m_reply->rawHeader(header);
         }
+    });
 
-        j->m_reply->setProperty("bsJob", QVariant::fromValue(j));
+    m_currentJobs.append(j);
+    emit started(j);
+}
 
-        connect(j->m_reply, &QNetworkReply::downloadProgress, this, [this, j](qint64 recv, qint64 total) {
-            emit progress(j, int(recv), int(total));
-        });
+void TransferRetriever::watchReply(TransferJob *j)
+{
+    j->m_reply->setProperty("bsJob", QVariant::fromValue(j));
 
-        connect(j->m_reply, &QNetworkReply::metaDataChanged, this, [j]() {
-            qCInfo(LogTransfer) << "<< REPLY" << j->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toUInt()
-                                << j->m_effective_url;
-            if (LogTransfer().isDebugEnabled()) {
-                const auto headers = j->m_reply->rawHeaderList();
-                for (const auto &header : headers)
-                    qCDebug(LogTransfer()) << header << ":" << j->m_reply->rawHeader(header);
-            }
-        });
+    connect(j->m_reply, &QNetworkReply::readyRead, this, [this, j]() {
+        receiveData(j);
+    });
+}
 
-        m_currentJobs.append(j);
-        emit started(j);
+void TransferRetriever::receiveData(TransferJob *j)
+{
+    // the body is handed over while it arrives, instead of buffering it twice (in QNAM and
+    // in the job) until the download is finished: file jobs stream straight into their device,
+    // which may very well be a decoding filter. Error pages and redirect bodies are dropped.
+    if (!j->m_reply
+            || (j->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200)) {
+        return;
     }
+
+    const QByteArray chunk = j->m_reply->readAll();
+    if (chunk.isEmpty())
+        return;
+    m_transfer->m_bytesReceived.fetchAndAddRelaxed(chunk.size());
+
+    if (j->m_data)
+        j->m_data->append(chunk);
+    else if (j->m_file)
+        j->m_file->write(chunk);
 }
 
 void TransferRetriever::downloadFinished(QNetworkReply *reply)
@@ -408,6 +700,8 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
     j->m_respcode = j->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toUInt();
     j->m_effective_url = j->m_reply->url();
 
+    QByteArray payload;
+
     if (error != QNetworkReply::NoError) {
         m_sslSessionForHost.remove(j->m_url.host());
 
@@ -415,7 +709,7 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
             --j->m_retries_left;
             j->m_reply->deleteLater();
             j->m_reply = m_nam->get(j->m_reply->request());
-            j->m_reply->setProperty("bsJob", QVariant::fromValue(j));
+            watchReply(j);
             qCWarning(LogTransfer) << "Got a 404 on" << j->m_url << "... retrying (still" << j->m_retries_left << "retries left)";
             return;
         } else if ((j->m_respcode == 302) && (error == QNetworkReply::HostNotFoundError)) {
@@ -427,11 +721,13 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
                 url.setHost(j->m_url.host());
                 url.setScheme(j->m_url.scheme());
                 j->m_reply = m_nam->get(QNetworkRequest(url));
-                j->m_reply->setProperty("bsJob", QVariant::fromValue(j));
+                watchReply(j);
                 return;
             }
         }
         j->m_error_string = j->m_reply->errorString();
+        if (j->m_data)
+            j->m_data->clear();
         j->setStatus(TransferJob::Failed);
     } else {
         m_sslSessionForHost.insert(j->m_url.host(), reply->sslConfiguration().sessionTicket());
@@ -460,10 +756,9 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
             auto lastmod = j->m_reply->header(QNetworkRequest::LastModifiedHeader);
             if (lastmod.isValid())
                 j->m_last_modified = lastmod.toDateTime();
+            receiveData(j);
             if (j->m_data)
-                *j->m_data = j->m_reply->readAll();
-            else if (j->m_file)
-                j->m_file->write(j->m_reply->readAll());
+                payload = *j->m_data;
             j->setStatus(TransferJob::Completed);
             break;
         }
@@ -475,6 +770,13 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
     j->m_reply->deleteLater();
     j->m_reply = nullptr;
 
+    if (auto it = m_activeJobsPerHost.find(j->m_url.host()); it != m_activeJobsPerHost.end()) {
+        if (--it.value() <= 0)
+            m_activeJobsPerHost.erase(it);
+    }
+
+    finishCoalescedJobs(j, payload);
+
     emit overallProgress(++m_progressDone, m_progressTotal);
     if (m_progressDone == m_progressTotal)
         m_progressDone = m_progressTotal = 0;
@@ -485,3 +787,31 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
 
     QMetaObject::invokeMethod(this, &TransferRetriever::schedule, Qt::QueuedConnection);
 }
+
+void TransferRetriever::finishCoalescedJobs(TransferJob *job, const QByteArray &payload)
+{
+    const QByteArray key = coalesceKey(job);
+    if (key.isEmpty() || (m_coalesceLeaders.value(key) != job))
+        return;
+    m_coalesceLeaders.remove(key);
+
+    const auto followers = m_coalescedJobs.take(job);
+    for (auto *f : followers) {
+        f->m_coalescedWith = nullptr;
+        f->m_respcode = job->m_respcode;
+        f->m_effective_url = job->m_effective_url;
+        f->m_redirect_url = job->m_redirect_url;
+        f->m_error_string = job->m_error_string;
+        f->m_last_etag = job->m_last_etag;
+        f->m_last_modified = job->m_last_modified;
+        f->m_was_not_modified = job->m_was_not_modified;
+        if (f->m_data)
+            *f->m_data = payload;
+        else if (f->m_file)
+            f->m_file->write(payload);
+        f->setStatus(job->m_status);
+
+        emit overallProgress(++m_progressDone, m_progressTotal);
+        emit finished(f);
+    }
+}
@@ -6,6 +6,9 @@
 #include <QDateTime>
 #include <QUrl>
 #include <QThread>
+#include <QHash>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 
 Q_DECLARE_LOGGING_CATEGORY(LogTransfer)
@@ -22,8 +25,10 @@ public:
     ~TransferJob();
 
     static TransferJob *get(const QUrl &url, QIODevice *file = nullptr, uint retries = 0);
-    static TransferJob *getIfNewer(const QUrl &url, const QDateTime &dt, QIODevice *file = nullptr);
-    static TransferJob *getIfDifferent(const QUrl &url, const QString &etag, QIODevice *file = nullptr);
+    static TransferJob *getIfNewer(const QUrl &url, const QDateTime &dt, QIODevice *file = nullptr,
+                                  uint retries = 0);
+    static TransferJob *getIfDifferent(const QUrl &url, const QString &etag, QIODevice *file = nullptr,
+                                      uint retries = 0);
     static TransferJob *post(const QUrl &url, QIODevice *file = nullptr, bool noRedirects = false);
     static TransferJob *postContent(const QUrl &url, const QString &contentType, const QByteArray &content,
                                     QIODevice *file = nullptr, bool noRedirects = false);
@@ -98,6 +103,12 @@ private:
 
     QByteArray   m_userTag;
     QVariant     m_userData;
+
+    // intrusive links for the TransferRetriever's queues
+    TransferJob *m_queuePrev = nullptr;
+    TransferJob *m_queueNext = nullptr;
+    qint64       m_queuedAt = 0;
+    TransferJob *m_coalescedWith = nullptr;
 //    void *       m_user_ptr = nullptr;
 //    int          m_user_tag = 0;
 
@@ -109,6 +120,7 @@ private:
     bool         m_was_not_modified : 1 = false;
     bool         m_no_redirects     : 1;
     bool         m_high_priority    : 1 = false;
+    bool         m_queued           : 1 = false;
 
     friend class Transfer;
     friend class TransferRetriever;
@@ -130,6 +142,9 @@ public:
     void abortAllJobs();
     void schedule();
 
+    void setMaxConnectionsPerHost(int maxConnections, const QString &host);
+    void setHttp2Enabled(bool enabled, const QString &host);
+
 signals:
     void overallProgress(int done, int total);
     void started(TransferJob *job);
@@ -137,16 +152,62 @@ signals:
     void finished(TransferJob *job);
 
 private:
+    // a doubly linked list threaded through the jobs: insert and remove are O(1)
+    struct JobList
+    {
+        TransferJob *first = nullptr;
+        TransferJob *last = nullptr;
+
+        bool isEmpty() const { return !first; }
+        void prepend(TransferJob *job);
+        void append(TransferJob *job);
+        void remove(TransferJob *job);
+    };
+
+    // pending jobs, per host: high and low priority
+    struct HostQueue
+    {
+        JobList high;
+        JobList low;
+        uint highServedInARow = 0;
+    };
+
+    void startJob(TransferJob *job);
+    void enqueue(TransferJob *job);
+    void dequeue(TransferJob *job);
+    TransferJob *takeNextJob(HostQueue &queue);
+
+    struct HostPolicy
+    {
+        int maxConnections = -1; // -1: use the default for the protocol
+        int http2 = -1;          // -1: use the default
+    };
+
+    void watchReply(TransferJob *job);
+    void receiveData(TransferJob *job);
     void downloadFinished(QNetworkReply *reply);
+    HostPolicy hostPolicy(const QString &host) const;
+    int maxConnectionsForHost(const QString &host) const;
+    static QByteArray coalesceKey(const TransferJob *job);
+    void finishCoalescedJobs(TransferJob *job, const QByteArray &payload);
 
     Transfer *m_transfer;
     QNetworkAccessManager *m_nam = nullptr;
-    QVector<TransferJob *> m_jobs;
+    QHash<QString, HostQueue> m_queues;
+    qsizetype              m_queuedCount = 0;
+    QElapsedTimer          m_clock;
     QVector<TransferJob *> m_currentJobs;
-    int                    m_maxConnections;
     int                    m_progressDone = 0;
     int                    m_progressTotal = 0;
     QHash<QString, QByteArray> m_sslSessionForHost;
+
+    HostPolicy                 m_defaultHostPolicy;
+    QHash<QString, HostPolicy> m_hostPolicies;
+    QHash<QString, int>        m_activeJobsPerHost;
+
+    // identical GET requests are only sent once: the followers get a copy of the leader's result
+    QHash<QByteArray, TransferJob *>           m_coalesceLeaders;
+    QHash<TransferJob *, QVector<TransferJob *>> m_coalescedJobs;
 };
 
 
@@ -170,6 +231,13 @@ public:
 
     static void setInitFunction(const std::function<void ()> &func);
 
+    // an empty host sets the default for all hosts
+    void setMaxConnectionsPerHost(int maxConnections, const QString &host = { });
+    void setHttp2Enabled(bool enabled, const QString &host = { });
+
+    qint64 bytesReceived() const     { return m_bytesReceived.loadRelaxed(); }
+    int coalescedJobCount() const    { return m_coalescedJobCount.loadRelaxed(); }
+
 signals:
     void overallProgress(int done, int total);
     void started(TransferJob *);
@@ -187,7 +255,11 @@ private:
     QThread *m_retrieverThread;
     TransferRetriever *m_retriever;
     QString m_user_agent;
+    QAtomicInteger<qint64> m_bytesReceived = 0;
+    QAtomicInteger<int> m_coalescedJobCount = 0;
 
     static QString s_default_user_agent;
     static std::function<void()> s_threadInitFunction;
+
+    friend class TransferRetriever;
 };
@@ -1,9 +1,11 @@
 // Copyright (C) 2004-2023 Robert Griebl
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <string_view>
 
 #include <QFile>
 #include <QDebug>
+#include <QXmlStreamReader>
 
 #include "exception.h"
 #include "xmlhelpers.h"
@@ -63,49 +65,80 @@ XmlHelpers::ParseXML::~ParseXML()
     delete m_file;
 }
 
-void XmlHelpers::ParseXML::parse(const std::function<void (const QDomElement &)> &callback,
-                                 const std::function<void (const QDomElement &)> &rootCallback)
+void XmlHelpers::ParseXML::parse(const std::function<void (const Element &)> &callback)
 {
-    QDomDocument doc;
-    QString emsg;
-    int eline = 0;
-    int ecolumn = 0;
-    if (!doc.setContent(m_file, false, &emsg, &eline, &ecolumn)) {
+    // stream the document instead of building a DOM: every record is collected into the same
+    // Element, which just holds the texts of its child elements
+    QXmlStreamReader xml(m_file);
+    Element element;
+    element.m_tagNames = &m_tagNames;
+
+    auto throwXmlError = [this, &xml]() {
         throw ParseException(m_file, "%1 at line %2, column %3")
-                .arg(emsg).arg(eline).arg(ecolumn);
-    }
+                .arg(xml.errorString()).arg(xml.lineNumber()).arg(xml.columnNumber());
+    };
 
-    auto root = doc.documentElement().toElement();
-    if (root.nodeName() != m_rootNodeName) {
+    if (!xml.readNextStartElement()) {
+        if (xml.hasError())
+            throwXmlError();
+        throw ParseException(m_file, "no root node found");
+    }
+    if (xml.name() != m_rootNodeName) {
         throw ParseException(m_file, "expected root node %1, but got %2")
-                .arg(m_rootNodeName).arg(root.nodeName());
+                .arg(m_rootNodeName).arg(xml.name().toString());
     }
 
     try {
-        if (rootCallback)
-            rootCallback(root.toElement());
+        while (xml.readNextStartElement()) {
+            if (xml.name() != m_elementNodeName) {
+                xml.skipCurrentElement();
+                continue;
+            }
+
+            element.m_fields.clear();
+            while (xml.readNextStartElement()) {
+                const auto tagName = xml.name();
+                auto tagIndex = m_tagNames.indexOf(tagName);
+                if (tagIndex < 0) {
+                    tagIndex = m_tagNames.size();
+                    m_tagNames.append(tagName.toString());
+                }
+                element.m_fields.append({ tagIndex, xml.readElementText(QXmlStreamReader::IncludeChildElements) });
+            }
+            if (xml.hasError())
+                break;
 
-        for (QDomNode node = root.firstChild(); !node.isNull(); node = node.nextSibling()) {
-            if (node.nodeName() == m_elementNodeName)
-                callback(node.toElement());
+            callback(element);
         }
     } catch (const Exception &e) {
         throw ParseException(m_file, e.what());
     }
+
+    if (xml.hasError())
+        throwXmlError();
 }
 
-QString XmlHelpers::ParseXML::elementText(const QDomElement &parent, const char *tagName)
+QString XmlHelpers::ParseXML::elementText(const Element &parent, const char *tagName)
 {
-    auto dnl = parent.elementsByTagName(QString::fromLatin1(tagName));
-    if (dnl.size() != 1) {
+    const QLatin1String tag(tagName);
+    const QString *text = nullptr;
+    int count = 0;
+
+    for (const auto &[tagIndex, fieldText] : parent.m_fields) {
+        if (parent.m_tagNames->at(tagIndex) == tag) {
+            text = &fieldText;
+            ++count;
+        }
+    }
+    if (count != 1) {
         throw ParseException("Expected a single %1 tag, but found %2")
-                .arg(QLatin1String(tagName)).arg(dnl.size());
+                .arg(tag).arg(count);
     }
-    // the contents are double XML escaped. QDom unescaped once already, now have to do one more
-    return decodeEntities(dnl.at(0).toElement().text().trimmed());
+    // the contents are double XML escaped. The reader unescaped once already, now have to do one more
+    return decodeEntities(text->trimmed());
 }
 
-QString XmlHelpers::ParseXML::elementText(const QDomElement &parent, const char *tagName,
+QString XmlHelpers::ParseXML::elementText(const Element &parent, const char *tagName,
                                           const char *defaultText)
 {
     try {
@@ -114,3 +147,142 @@ QString XmlHelpers::ParseXML::elementText(const QDomElement &parent, const char
         return QString::fromLatin1(defaultText);
     }
 }
+
+XmlHelpers::Utf8Writer::Utf8Writer(QIODevice *out)
+    : m_out(out)
+{
+    m_buffer.reserve(BufferSize + 4096);
+}
+
+void XmlHelpers::Utf8Writer::escape(QByteArray &to, QByteArrayView utf8, bool attribute)
+{
+    for (const char c : utf8) {
+        switch (c) {
+        case '<': to.append("&lt;"); break;
+        case '>': to.append("&gt;"); break;
+        case '&': to.append("&amp;"); break;
+        case '"': if (attribute) to.append("&quot;"); else to.append(c); break;
+        case '\t': if (attribute) to.append("&#9;"); else to.append(c); break;
+        case '\n': if (attribute) to.append("&#10;"); else to.append(c); break;
+        case '\r': to.append("&#13;"); break;
+        default:
+            // control characters are not allowed in XML 1.0
+            if ((c >= 0) && (c < 0x20))
+                break;
+            to.append(c);
+            break;
+        }
+    }
+}
+
+bool XmlHelpers::Utf8Writer::finish()
+{
+    flush();
+    return !m_error;
+}
+
+void XmlHelpers::Utf8Writer::flush()
+{
+    if (!m_error && !m_buffer.isEmpty())
+        m_error = (m_out->write(m_buffer) != m_buffer.size());
+    m_buffer.resize(0);
+}
+
+std::optional<XmlHelpers::RecordBatches> XmlHelpers::splitRecords(const QByteArray &xml,
+                                                                const char *containerTag,
+                                                                const char *recordTag,
+                                                                qsizetype batchSize)
+{
+    const std::string_view doc(xml.constData(), size_t(xml.size()));
+    const std::string_view container(containerTag);
+    const std::string_view record(recordTag);
+    static constexpr std::string_view whitespace = " \t\r\n";
+
+    // the batches are parsed without the XML declaration, so they have to be UTF-8
+    size_t pos = 0;
+    if (doc.starts_with("\xEF\xBB\xBF"))
+        pos = 3;
+    if (doc.starts_with("\xFE\xFF") || doc.starts_with("\xFF\xFE"))
+        return std::nullopt;
+    if (doc.substr(pos).starts_with("<?xml")) {
+        const auto declEnd = doc.find("?>", pos);
+        if (declEnd == std::string_view::npos)
+            return std::nullopt;
+        const QByteArray decl = xml.mid(qsizetype(pos), qsizetype(declEnd - pos)).toLower();
+        if (decl.contains("encoding") && !decl.contains("utf-8") && !decl.contains("utf8"))
+            return std::nullopt;
+    }
+
+    // find the container: internal DTD subsets and comments in front of it are not supported
+    const std::string openContainer = "<" + std::string(container);
+    size_t containerPos = pos;
+    while (true) {
+        containerPos = doc.find(openContainer, containerPos);
+        if (containerPos == std::string_view::npos)
+            return std::nullopt;
+        const auto next = containerPos + openContainer.size();
+        if ((next < doc.size()) && ((doc[next] == '>') || (whitespace.find(doc[next]) != std::string_view::npos)))
+            break;
+        containerPos = next;
+    }
+    const auto prolog = doc.substr(0, containerPos);
+    if ((prolog.find("<!--") != std::string_view::npos) || (prolog.find('[') != std::string_view::npos))
+        return std::nullopt;
+
+    const auto contentBegin = doc.find('>', containerPos);
+    if ((contentBegin == std::string_view::npos) || (doc[contentBegin - 1] == '/'))
+        return std::nullopt;
+    const auto contentEnd = doc.find("</" + std::string(container) + ">", contentBegin);
+    if (contentEnd == std::string_view::npos)
+        return std::nullopt;
+
+    const std::string openRecord = "<" + std::string(record) + ">";
+    const std::string closeRecord = "</" + std::string(record) + ">";
+
+    RecordBatches rb;
+    rb.skeleton = xml.left(qsizetype(contentBegin + 1)) + xml.mid(qsizetype(contentEnd));
+
+    size_t batchBegin = std::string_view::npos;
+    size_t batchEnd = 0;
+    qsizetype batchCount = 0;
+
+    auto addBatch = [&]() {
+        if (!batchCount)
+            return;
+        QByteArray batch;
+        batch.reserve(qsizetype(batchEnd - batchBegin) + 20);
+        batch.append("<batch>");
+        batch.append(xml.constData() + batchBegin, qsizetype(batchEnd - batchBegin));
+        batch.append("</batch>");
+        rb.batches.append(batch);
+        batchBegin = std::string_view::npos;
+        batchCount = 0;
+    };
+
+    pos = contentBegin + 1;
+    while (true) {
+        pos = doc.find_first_not_of(whitespace, pos);
+        if ((pos == std::string_view::npos) || (pos >= contentEnd))
+            break;
+        if (doc.substr(pos, openRecord.size()) != openRecord)
+            return std::nullopt;
+        auto recordEnd = doc.find(closeRecord, pos + openRecord.size());
+        if ((recordEnd == std::string_view::npos) || (recordEnd >= contentEnd))
+            return std::nullopt;
+        recordEnd += closeRecord.size();
+
+        // a CDATA section could hide the closing tag
+        if (doc.substr(pos, recordEnd - pos).find("<!") != std::string_view::npos)
+            return std::nullopt;
+
+        if (batchBegin == std::string_view::npos)
+            batchBegin = pos;
+        batchEnd = recordEnd;
+        ++rb.recordCount;
+        if (++batchCount == batchSize)
+            addBatch();
+        pos = recordEnd;
+    }
+    addBatch();
+    return rb;
+}
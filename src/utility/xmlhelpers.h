@@ -4,11 +4,15 @@
 #pragma once
 
 #include <functional>
+#include <optional>
+#include <utility>
 
+#include <QByteArray>
+#include <QByteArrayView>
 #include <QString>
-#include <QDomDocument>
-#include <QDomElement>
-#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QVector>
 
 QT_FORWARD_DECLARE_CLASS(QIODevice)
 
@@ -18,14 +22,23 @@ namespace XmlHelpers {
 class ParseXML
 {
 public:
+    // a single record: the text of all the child elements of an element node
+    class Element
+    {
+    private:
+        const QStringList *m_tagNames = nullptr;
+        QVarLengthArray<std::pair<qsizetype, QString>, 32> m_fields; // tag-name index, text
+
+        friend class ParseXML;
+    };
+
     ParseXML(const QString &path, const char *rootNodeName, const char *elementNodeName);
     ParseXML(QIODevice *file, const char *rootNodeName, const char *elementNodeName);
     ~ParseXML();
 
-    void parse(const std::function<void (const QDomElement &)> &callback,
-               const std::function<void (const QDomElement &)> &rootCallback = { });
-    static QString elementText(const QDomElement &parent, const char *tagName);
-    static QString elementText(const QDomElement &parent, const char *tagName, const char *defaultText);
+    void parse(const std::function<void (const Element &)> &callback);
+    static QString elementText(const Element &parent, const char *tagName);
+    static QString elementText(const Element &parent, const char *tagName, const char *defaultText);
 
 private:
     static QIODevice *openFile(const QString &fileName);
@@ -33,9 +46,64 @@ private:
     QString m_rootNodeName;
     QString m_elementNodeName;
     QIODevice *m_file;
-    QDomElement m_root;
+    QStringList m_tagNames;
 
     Q_DISABLE_COPY(ParseXML)
 };
 
+// A pre-scan for parsing large documents in parallel: the records (<recordTag> elements) inside
+// the first <containerTag> element are cut out of the document and split into batches. Every
+// batch is wrapped in a dummy root element, so it can be fed to a QXmlStreamReader on its own.
+// The scan is purely textual: if the document is not UTF-8, or if the container holds anything
+// but plain records (comments, CDATA sections, other elements), std::nullopt is returned and the
+// document has to be parsed sequentially.
+
+// Writes pre-encoded UTF-8 through a 1MB buffer into a QIODevice: much faster than going through
+// QXmlStreamWriter, which converts everything from and to UTF-16 and writes in tiny pieces.
+
+class Utf8Writer
+{
+public:
+    explicit Utf8Writer(QIODevice *out);
+
+    void raw(QByteArrayView s)
+    {
+        m_buffer.append(s);
+        if (m_buffer.size() >= BufferSize)
+            flush();
+    }
+    void indent(int depth)
+    {
+        m_buffer.append(depth, ' ');
+    }
+    void escaped(QByteArrayView utf8, bool attribute)
+    {
+        escape(m_buffer, utf8, attribute);
+    }
+    static void escape(QByteArray &to, QByteArrayView utf8, bool attribute);
+
+    bool finish();
+
+private:
+    void flush();
+
+    static constexpr qsizetype BufferSize = 1024 * 1024;
+
+    QIODevice *m_out;
+    QByteArray m_buffer;
+    bool m_error = false;
+
+    Q_DISABLE_COPY(Utf8Writer)
+};
+
+struct RecordBatches
+{
+    QByteArray skeleton;        // the document with the container's content cut out
+    QVector<QByteArray> batches;
+    qsizetype recordCount = 0;
+};
+
+std::optional<RecordBatches> splitRecords(const QByteArray &xml, const char *containerTag,
+                                          const char *recordTag, qsizetype batchSize);
+
 }